@@ -28,6 +28,7 @@ limitations under the License.
 #include <QDebug>
 #include <QFileInfo>
 #include <QKeyEvent>
+#include <QThread>
 
 #include <itkMedianImageFilter.h>
 #include <itkConnectedThresholdImageFilter.h>
@@ -39,12 +40,13 @@ limitations under the License.
 #include <itkBinaryBallStructuringElement.h>
 #include <itkMinimumMaximumImageCalculator.h>
 #include <itkNeighborhoodIterator.h>
-#include <itkStatisticsImageFilter.h>
 
 //QtImageViewer includes
 #include "QtGlSliceView.h"
+#include "SliceVolume.h"
 #include "QtImageViewer.h"
 #include "BoxWidget.h"
+#include "RenderBenchmark.h"
 
 int execImageViewer(int argc, char* argv[])
 {
@@ -80,6 +82,11 @@ void myKeyCallback(QKeyEvent *event, void *d)
 
     typedef itk::Image< double, 3 >        ImageType;
     ImageType::Pointer img = sv->inputImage();
+    // A streamed or loading image is not in memory to be filtered
+    if( img.IsNull() )
+      {
+      return;
+      }
 
     typedef itk::MedianImageFilter< ImageType, ImageType >
                                            FilterType;
@@ -120,6 +127,10 @@ void myMouseCallback(double x, double y, double z, double v, void *d)
                                          MinMaxFilterType;
 
   QtGlSliceView * sv = (QtGlSliceView *)(d);
+  if( sv->inputImage().IsNull() )
+    {
+    return;
+    }
 
   if( sv->clickMode() == CM_CUSTOM )
     {
@@ -385,6 +396,7 @@ int parseAndExecImageViewer(int argc, char* argv[])
   QString filePathToLoad;
   filePathToLoad = QString::fromStdString(inputImage);
 
+  viewer.setStreamingMemory(streamingMemory > 0 ? streamingMemory : 0);
   viewer.loadInputImage(filePathToLoad);
 
   if(!overlayImage.empty())
@@ -396,6 +408,10 @@ int parseAndExecImageViewer(int argc, char* argv[])
     {
     viewer.sliceView()->setSliceNum(sliceOffset);
     }
+  if(autoWindow)
+    {
+    viewer.sliceView()->autoWindow();
+    }
   if(minIntensityArg.isSet())
     {
     viewer.sliceView()->setIWMin(minIntensity);
@@ -411,6 +427,10 @@ int parseAndExecImageViewer(int argc, char* argv[])
   viewer.sliceView()->flipY(!yFlipped);
   viewer.sliceView()->flipX(xFlipped);
   viewer.sliceView()->setOverlayOpacity(overlayOpacity);
+  for(size_t i = 0; i < hiddenLabels.size(); ++i)
+    {
+    viewer.sliceView()->setLabelVisible(hiddenLabels[i], false);
+    }
   viewer.sliceView()->setViewCrosshairs(!crosshairs);
   viewer.sliceView()->setDisplayState(details);
   viewer.sliceView()->setViewValuePhysicalUnits(physicalUnits);
@@ -427,6 +447,23 @@ int parseAndExecImageViewer(int argc, char* argv[])
   viewer.sliceView()->setKeyEventArgCallBack( myKeyCallback );
   viewer.sliceView()->setKeyEventArg( (void*)(viewer.sliceView()) );
   viewer.sliceView()->setFixedSliceMoveValue( fixedSliceDelta );
+  viewer.sliceView()->setNumberOfRenderThreads(
+    renderThreads > 0 ? renderThreads : 0 );
+  viewer.sliceView()->setSliceCacheSize(
+    sliceCacheSize > 0 ? sliceCacheSize : 0 );
+  viewer.sliceView()->setNumberOfPrefetchSlices(
+    prefetchSlices > 0 ? prefetchSlices : 0 );
+  viewer.sliceView()->setBrickSize( brickSize > 0 ? brickSize : 0 );
+  viewer.sliceView()->setSlabThickness( slabThickness );
+  viewer.sliceView()->setMaxPyramidLevel( pyramidLevels );
+  if( viewer.sliceView()->brickedVolumeMemorySize() > 0 )
+    {
+    const double flatSize = viewer.sliceView()->inputVolume()->bufferSize();
+    std::cout << "Bricked volume: "
+      << viewer.sliceView()->brickedVolumeMemorySize() / 1048576.0
+      << " MB, " << flatSize / 1048576.0 << " MB for the image"
+      << std::endl;
+    }
 
   viewer.sliceView()->setIsONSDRuler(ONSDRuler);
 
@@ -570,17 +607,36 @@ int parseAndExecImageViewer(int argc, char* argv[])
     }
   }
 
-  ImageType::Pointer img = viewer.sliceView()->inputImage();
-
-  typedef itk::StatisticsImageFilter<ImageType>  StatisticsFilterType;
-  StatisticsFilterType::Pointer statsFilter = StatisticsFilterType::New();
-  statsFilter->SetInput( img );
-  statsFilter->Update();
-  IMAGE_MIN = statsFilter->GetMinimum();
-  IMAGE_MAX = statsFilter->GetMaximum();
+  // The statistics were computed when the image was set
+  IMAGE_MIN = viewer.sliceView()->imageStatistics().minimum();
+  IMAGE_MAX = viewer.sliceView()->imageStatistics().maximum();
 
   viewer.sliceView()->update();
 
+  if( benchmark )
+    {
+    // The image is benchmarked once it is loaded
+    while( viewer.sliceView()->isLoading() )
+      {
+      QThread::msleep( 10 );
+      }
+    // In the pixel type of the image, as the view renders it
+    std::unique_ptr< RenderBenchmarkBase > renderBenchmark;
+    if( viewer.sliceView()->isLoaded() )
+      {
+      renderBenchmark = RenderBenchmarkBase::create(
+        viewer.sliceView()->inputVolume() );
+      }
+    if( !renderBenchmark )
+      {
+      std::cerr << "Streamed or partly loaded images cannot be benchmarked."
+        << std::endl;
+      return EXIT_FAILURE;
+      }
+    renderBenchmark->run( std::cout );
+    return EXIT_SUCCESS;
+    }
+
   viewer.show();
   int execReturn;
   try
@@ -0,0 +1,120 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "BrickedVolume.h"
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+
+
+template <class TPixel>
+BrickedVolume<TPixel>::
+BrickedVolume()
+{
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = 0;
+    }
+  mBrickSize = 0;
+}
+
+
+template <class TPixel>
+void
+BrickedVolume<TPixel>::
+build( const PixelType * buffer, const unsigned long dimSize[3],
+  unsigned int brickSize )
+{
+  mBrickSize = brickSize;
+  int shift = 0;
+  while( ( 1u << shift ) < brickSize )
+    {
+    ++shift;
+    }
+  const long mask = ( long )brickSize - 1;
+
+  // A brick index step skips a whole row, plane or volume of bricks,
+  //   while a voxel index step within a brick skips 1, B or B^2 voxels
+  const long brickVoxels = ( long )brickSize * brickSize * brickSize;
+  long brickStride = brickVoxels;
+  long voxelStride = 1;
+  for( int axis=0; axis<3; ++axis )
+    {
+    mDimSize[axis] = dimSize[axis];
+    const long numberOfBricks = ( ( long )dimSize[axis] + mask ) >> shift;
+    mAxisOffsets[axis].resize( dimSize[axis] );
+    for( long i=0; i<( long )dimSize[axis]; ++i )
+      {
+      mAxisOffsets[axis][i] = ( i >> shift ) * brickStride
+        + ( i & mask ) * voxelStride;
+      }
+    brickStride *= numberOfBricks;
+    voxelStride *= brickSize;
+    }
+  mBricks.assign( brickStride, PixelType() );
+
+  // Copy the image one brick-wide run of x at a time
+  const long * offsetX = &( mAxisOffsets[0][0] );
+  const long * offsetY = &( mAxisOffsets[1][0] );
+  const long * offsetZ = &( mAxisOffsets[2][0] );
+  const long dimX = ( long )dimSize[0];
+  const PixelType * p = buffer;
+  for( long z=0; z<( long )dimSize[2]; ++z )
+    {
+    for( long y=0; y<( long )dimSize[1]; ++y, p+=dimX )
+      {
+      PixelType * row = &( mBricks[0] ) + offsetY[y] + offsetZ[z];
+      for( long x=0; x<dimX; x+=brickSize )
+        {
+        const long n = std::min( ( long )brickSize, dimX - x );
+        memcpy( row + offsetX[x], p + x, n * sizeof( PixelType ) );
+        }
+      }
+    }
+}
+
+
+template <class TPixel>
+size_t
+BrickedVolume<TPixel>::
+memorySize() const
+{
+  return mBricks.size() * sizeof( PixelType ) + ( mAxisOffsets[0].size()
+    + mAxisOffsets[1].size() + mAxisOffsets[2].size() ) * sizeof( long );
+}
+
+
+template <class TPixel>
+size_t
+BrickedVolume<TPixel>::
+flatMemorySize() const
+{
+  return mDimSize[0] * mDimSize[1] * mDimSize[2] * sizeof( PixelType );
+}
+
+
+template class BrickedVolume<unsigned char>;
+template class BrickedVolume<short>;
+template class BrickedVolume<unsigned short>;
+template class BrickedVolume<float>;
+template class BrickedVolume<double>;
@@ -0,0 +1,90 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __BrickedVolume_h
+#define __BrickedVolume_h
+
+// STD includes
+#include <cstddef>
+#include <vector>
+
+/**
+* BrickedVolume : copy of a 3D image stored as cubic bricks.
+*
+* The image is split into bricks of brickSize^3 voxels, brickSize being a
+* power of two. The bricks are stored x-fastest, and so are the voxels
+* within a brick, so the neighbors of a voxel along any axis are usually
+* in the same brick, whatever the slice orientation. The image is padded
+* to a whole number of bricks along each axis.
+*
+* The buffer offset of a voxel is the sum of one offset per axis:
+*   axisOffsets( 0 )[x] + axisOffsets( 1 )[y] + axisOffsets( 2 )[z]
+* so the reslicer looks up three tables instead of multiplying strides.
+**/
+template <class TPixel>
+class BrickedVolume
+{
+public:
+  typedef TPixel PixelType;
+
+  BrickedVolume();
+
+  /*! Copy the x-fastest buffer of size dimSize into bricks of
+  *   brickSize^3 voxels. brickSize must be a power of two. */
+  void build( const PixelType * buffer, const unsigned long dimSize[3],
+    unsigned int brickSize );
+
+  unsigned int brickSize() const
+    {
+    return mBrickSize;
+    }
+
+  const PixelType * buffer() const
+    {
+    return mBricks.empty() ? NULL : &( mBricks[0] );
+    }
+
+  /*! Buffer offset of each index along the image axis */
+  const long * axisOffsets( int axis ) const
+    {
+    return &( mAxisOffsets[axis][0] );
+    }
+
+  /*! Buffer offset of voxel ( x, y, z ) */
+  long voxelOffset( long x, long y, long z ) const
+    {
+    return mAxisOffsets[0][x] + mAxisOffsets[1][y] + mAxisOffsets[2][z];
+    }
+
+  /*! Bytes used by the bricks, padding included, and the offset tables */
+  size_t memorySize() const;
+
+  /*! Bytes used by the same image in a flat buffer */
+  size_t flatMemorySize() const;
+
+protected:
+  unsigned long               mDimSize[3];
+  unsigned int                mBrickSize;
+  std::vector< PixelType >    mBricks;
+  std::vector< long >         mAxisOffsets[3];
+};
+
+#endif
@@ -0,0 +1,353 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "ChunkedGzip.h"
+
+// ITK includes
+#include "itk_zlib.h"
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+
+namespace
+{
+
+/* gzip member header up to the extra field length, and the trailer */
+const size_t FixedHeaderSize = 10;
+const size_t TrailerSize = 8;
+
+/* offset of the subfield data: fixed header, XLEN, SI1, SI2 and LEN */
+const size_t SubfieldDataOffset = FixedHeaderSize + 6;
+
+void
+putUInt16( char * p, uint32_t v )
+{
+  p[0] = ( char )( v & 0xff );
+  p[1] = ( char )( ( v >> 8 ) & 0xff );
+}
+
+void
+putUInt32( char * p, uint32_t v )
+{
+  putUInt16( p, v & 0xffff );
+  putUInt16( p + 2, v >> 16 );
+}
+
+uint32_t
+getUInt16( const char * p )
+{
+  const unsigned char * u = reinterpret_cast< const unsigned char * >( p );
+  return u[0] | ( uint32_t )u[1] << 8;
+}
+
+uint32_t
+getUInt32( const char * p )
+{
+  return getUInt16( p ) | getUInt16( p + 2 ) << 16;
+}
+
+/* run function on each of numberOfChunks chunks, on threader if it is
+   not NULL */
+template <class TFunction>
+void
+forEachChunk( size_t numberOfChunks, itk::MultiThreaderBase * threader,
+  TFunction function )
+{
+  if( threader != NULL && numberOfChunks > 1 )
+    {
+    threader->ParallelizeArray( 0, numberOfChunks, function, nullptr );
+    return;
+    }
+  for( size_t chunk=0; chunk<numberOfChunks; ++chunk )
+    {
+    function( chunk );
+    }
+}
+
+}
+
+
+bool
+ChunkedGzip::
+isChunked( const char * stream, size_t size )
+{
+  if( size < SubfieldDataOffset )
+    {
+    return false;
+    }
+  const unsigned char * u = reinterpret_cast< const unsigned char * >(
+    stream );
+  // Deflate method, and the extra field as the only optional field
+  if( u[0] != 0x1f || u[1] != 0x8b || u[2] != 8 || u[3] != 4 )
+    {
+    return false;
+    }
+  const uint32_t extraSize = getUInt16( stream + FixedHeaderSize );
+  const uint32_t subfieldSize = getUInt16( stream + FixedHeaderSize + 4 );
+  return stream[FixedHeaderSize + 2] == 'I'
+    && stream[FixedHeaderSize + 3] == 'V'
+    && subfieldSize + 4 == extraSize && subfieldSize >= 8
+    && subfieldSize % 4 == 0;
+}
+
+
+bool
+ChunkedGzip::
+compress( const void * data, size_t size, std::vector< char > & stream,
+  itk::MultiThreaderBase * threader )
+{
+  size_t chunkSize = MinimumChunkSize;
+  while( ( size + chunkSize - 1 ) / chunkSize > MaximumNumberOfChunks )
+    {
+    chunkSize *= 2;
+    }
+  const size_t numberOfChunks = std::max( ( size + chunkSize - 1 )
+    / chunkSize, ( size_t )1 );
+  const Bytef * bytes = static_cast< const Bytef * >( data );
+
+  std::vector< std::vector< char > > chunks( numberOfChunks );
+  std::vector< uLong > checksums( numberOfChunks );
+  std::atomic< bool > compressed( true );
+  forEachChunk( numberOfChunks, threader,
+    [&]( itk::SizeValueType chunk )
+    {
+    const size_t begin = chunk * chunkSize;
+    const size_t length = std::min( chunkSize, size - begin );
+    checksums[chunk] = crc32( crc32( 0L, Z_NULL, 0 ), bytes + begin,
+      ( uInt )length );
+
+    z_stream deflater;
+    memset( &deflater, 0, sizeof( deflater ) );
+    if( deflateInit2( &deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+      -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+      {
+      compressed = false;
+      return;
+      }
+    // The bound is for a finished stream, the sync flush adds at most
+    //   a few bytes more
+    std::vector< char > & out = chunks[chunk];
+    out.resize( deflateBound( &deflater, ( uLong )length ) + 16 );
+    deflater.next_in = const_cast< Bytef * >( bytes + begin );
+    deflater.avail_in = ( uInt )length;
+    deflater.next_out = reinterpret_cast< Bytef * >( out.data() );
+    deflater.avail_out = ( uInt )out.size();
+    const bool last = ( chunk + 1 == numberOfChunks );
+    const int status = deflate( &deflater, last ? Z_FINISH : Z_SYNC_FLUSH );
+    if( status != ( last ? Z_STREAM_END : Z_OK )
+      || deflater.avail_in != 0 )
+      {
+      compressed = false;
+      }
+    out.resize( out.size() - deflater.avail_out );
+    deflateEnd( &deflater );
+    } );
+  if( !compressed )
+    {
+    return false;
+    }
+
+  const size_t subfieldSize = 4 * ( numberOfChunks + 1 );
+  size_t streamSize = SubfieldDataOffset + subfieldSize + TrailerSize;
+  for( size_t chunk=0; chunk<numberOfChunks; ++chunk )
+    {
+    streamSize += chunks[chunk].size();
+    }
+  stream.resize( streamSize );
+  char * p = stream.data();
+
+  // Header: deflate, extra field, no time, unknown system
+  const unsigned char header[FixedHeaderSize] =
+    { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff };
+  memcpy( p, header, FixedHeaderSize );
+  putUInt16( p + FixedHeaderSize, ( uint32_t )subfieldSize + 4 );
+  p[FixedHeaderSize + 2] = 'I';
+  p[FixedHeaderSize + 3] = 'V';
+  putUInt16( p + FixedHeaderSize + 4, ( uint32_t )subfieldSize );
+  p += SubfieldDataOffset;
+  putUInt32( p, ( uint32_t )chunkSize );
+  p += 4;
+  for( size_t chunk=0; chunk<numberOfChunks; ++chunk )
+    {
+    putUInt32( p, ( uint32_t )chunks[chunk].size() );
+    p += 4;
+    }
+
+  uLong checksum = checksums[0];
+  for( size_t chunk=0; chunk<numberOfChunks; ++chunk )
+    {
+    memcpy( p, chunks[chunk].data(), chunks[chunk].size() );
+    p += chunks[chunk].size();
+    if( chunk > 0 )
+      {
+      checksum = crc32_combine( checksum, checksums[chunk],
+        ( z_off_t )std::min( chunkSize, size - chunk * chunkSize ) );
+      }
+    }
+  putUInt32( p, ( uint32_t )checksum );
+  putUInt32( p + 4, ( uint32_t )size );
+  return true;
+}
+
+
+bool
+ChunkedGzip::
+inflate( const char * stream, size_t streamSize, void * data, size_t size,
+  itk::MultiThreaderBase * threader )
+{
+  ChunkedGzip chunkedGzip;
+  return chunkedGzip.setStream( stream, streamSize, size )
+    && chunkedGzip.inflateChunks( 0, chunkedGzip.numberOfChunks() - 1,
+      data, threader )
+    && chunkedGzip.checksumMatches();
+}
+
+
+ChunkedGzip::
+ChunkedGzip()
+{
+  mStream = NULL;
+  mSize = 0;
+  mChunkSize = 0;
+}
+
+
+bool
+ChunkedGzip::
+setStream( const char * stream, size_t streamSize, size_t size )
+{
+  mStream = NULL;
+  mChunkOffsets.clear();
+  mChecksums.clear();
+  if( !isChunked( stream, streamSize ) )
+    {
+    return false;
+    }
+  const size_t subfieldSize = getUInt16( stream + FixedHeaderSize + 4 );
+  const size_t numberOfChunks = subfieldSize / 4 - 1;
+  const size_t bodyOffset = SubfieldDataOffset + subfieldSize;
+  if( bodyOffset > streamSize )
+    {
+    return false;
+    }
+  const size_t chunkSize = getUInt32( stream + SubfieldDataOffset );
+  if( chunkSize == 0 || numberOfChunks != std::max( ( size + chunkSize - 1 )
+    / chunkSize, ( size_t )1 ) )
+    {
+    return false;
+    }
+
+  // Where each chunk starts in the stream
+  std::vector< size_t > offsets( numberOfChunks + 1 );
+  offsets[0] = bodyOffset;
+  for( size_t chunk=0; chunk<numberOfChunks; ++chunk )
+    {
+    offsets[chunk + 1] = offsets[chunk]
+      + getUInt32( stream + SubfieldDataOffset + 4 * ( chunk + 1 ) );
+    }
+  const size_t trailer = offsets[numberOfChunks];
+  if( trailer + TrailerSize > streamSize
+    || getUInt32( stream + trailer + 4 ) != ( uint32_t )size )
+    {
+    return false;
+    }
+  mStream = stream;
+  mSize = size;
+  mChunkSize = chunkSize;
+  mChunkOffsets.swap( offsets );
+  mChecksums.assign( numberOfChunks, 0 );
+  return true;
+}
+
+
+bool
+ChunkedGzip::
+inflateChunks( size_t firstChunk, size_t lastChunk, void * data,
+  itk::MultiThreaderBase * threader )
+{
+  if( mStream == NULL || lastChunk >= this->numberOfChunks()
+    || firstChunk > lastChunk )
+    {
+    return false;
+    }
+  const size_t numberOfChunks = this->numberOfChunks();
+  Bytef * bytes = static_cast< Bytef * >( data );
+  std::atomic< bool > inflated( true );
+  forEachChunk( lastChunk - firstChunk + 1, threader,
+    [&]( itk::SizeValueType i )
+    {
+    const size_t chunk = firstChunk + i;
+    const size_t begin = chunk * mChunkSize;
+    const size_t length = std::min( mChunkSize, mSize - begin );
+    z_stream inflater;
+    memset( &inflater, 0, sizeof( inflater ) );
+    if( inflateInit2( &inflater, -MAX_WBITS ) != Z_OK )
+      {
+      inflated = false;
+      return;
+      }
+    inflater.next_in = reinterpret_cast< Bytef * >(
+      const_cast< char * >( mStream + mChunkOffsets[chunk] ) );
+    inflater.avail_in = ( uInt )( mChunkOffsets[chunk + 1]
+      - mChunkOffsets[chunk] );
+    inflater.next_out = bytes + begin;
+    inflater.avail_out = ( uInt )length;
+    const int status = ::inflate( &inflater, Z_SYNC_FLUSH );
+    inflateEnd( &inflater );
+    // The chunks but the last stop on the sync flush, before the end of
+    //   the deflate stream
+    const bool last = ( chunk + 1 == numberOfChunks );
+    if( inflater.avail_out != 0 || ( last ? status != Z_STREAM_END
+      : status != Z_OK && status != Z_BUF_ERROR ) )
+      {
+      inflated = false;
+      return;
+      }
+    mChecksums[chunk] = crc32( crc32( 0L, Z_NULL, 0 ), bytes + begin,
+      ( uInt )length );
+    } );
+  return inflated;
+}
+
+
+bool
+ChunkedGzip::
+checksumMatches() const
+{
+  const size_t numberOfChunks = this->numberOfChunks();
+  if( numberOfChunks == 0 )
+    {
+    return false;
+    }
+  uLong checksum = mChecksums[0];
+  for( size_t chunk=1; chunk<numberOfChunks; ++chunk )
+    {
+    checksum = crc32_combine( checksum, mChecksums[chunk],
+      ( z_off_t )std::min( mChunkSize, mSize - chunk * mChunkSize ) );
+    }
+  return ( uint32_t )checksum
+    == getUInt32( mStream + mChunkOffsets[numberOfChunks] );
+}
@@ -0,0 +1,107 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __ChunkedGzip_h
+#define __ChunkedGzip_h
+
+// ITK includes
+#include "itkMultiThreaderBase.h"
+
+// STD includes
+#include <cstddef>
+#include <vector>
+
+/**
+* ChunkedGzip : a gzip stream whose data is deflated in independent
+* chunks, so it is compressed and inflated in parallel.
+*
+* Each chunk is deflated on its own, without the data before it, and all
+* but the last end on a sync flush, so their streams join into the one
+* deflate stream of a single gzip member, which any gzip or zlib reader
+* inflates as usual. The gzip header carries an extra field, with the
+* subfield id "IV", holding the chunk size and the compressed size of
+* each chunk, from which inflate() finds where every chunk starts.
+*
+* The static inflate() inflates a whole stream; a ChunkedGzip set to a
+* stream inflates ranges of chunks, e.g., those of one slice first.
+*
+* Subfield data, little endian: the uncompressed size of the chunks but
+* the last, then the compressed size of each chunk, as 32 bit integers.
+**/
+class ChunkedGzip
+{
+public:
+  enum { MinimumChunkSize = 1 << 22, MaximumNumberOfChunks = 16000 };
+
+  /*! True if the size bytes of stream start with the header of a
+  *   chunked gzip stream. The first 16 bytes are enough. */
+  static bool isChunked( const char * stream, size_t size );
+
+  /*! Compress the size bytes of data into stream, on threader if it is
+  *   not NULL. False if zlib failed. */
+  static bool compress( const void * data, size_t size,
+    std::vector< char > & stream, itk::MultiThreaderBase * threader );
+
+  /*! Inflate the chunked gzip stream of streamSize bytes into the size
+  *   bytes of data, on threader if it is not NULL. False if stream is
+  *   not chunked, does not hold size bytes, or is corrupt. */
+  static bool inflate( const char * stream, size_t streamSize,
+    void * data, size_t size, itk::MultiThreaderBase * threader );
+
+  ChunkedGzip();
+
+  /*! Read the chunk sizes of the chunked gzip stream of streamSize
+  *   bytes, which must stay valid while chunks are inflated. False if
+  *   stream is not chunked or does not hold size bytes. */
+  bool setStream( const char * stream, size_t streamSize, size_t size );
+
+  size_t numberOfChunks() const
+    {
+    return mChunkOffsets.empty() ? 0 : mChunkOffsets.size() - 1;
+    }
+
+  /*! Uncompressed size of the chunks but the last */
+  size_t chunkSize() const
+    {
+    return mChunkSize;
+    }
+
+  /*! Inflate chunks firstChunk to lastChunk into their place in the size
+  *   bytes of data, on threader if it is not NULL. False if one of them
+  *   is corrupt. */
+  bool inflateChunks( size_t firstChunk, size_t lastChunk, void * data,
+    itk::MultiThreaderBase * threader );
+
+  /*! True if the checksum of the chunks inflated, which must be all of
+  *   them, matches the one of the stream */
+  bool checksumMatches() const;
+
+protected:
+  const char *                 mStream;
+  size_t                       mSize;
+  size_t                       mChunkSize;
+  /* where each chunk starts in the stream, and where the last ends */
+  std::vector< size_t >        mChunkOffsets;
+  /* CRC-32 of each chunk inflated */
+  std::vector< unsigned long > mChecksums;
+};
+
+#endif
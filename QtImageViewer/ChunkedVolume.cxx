@@ -0,0 +1,258 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "ChunkedVolume.h"
+
+// ITK includes
+#include "itkImageIORegion.h"
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+
+
+template <class TPixel>
+ChunkedVolume<TPixel>::
+ChunkedVolume( itk::ImageIOBase * imageIO )
+{
+  mImageIO = imageIO;
+  mImageIO->SetUseStreamedReading( true );
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = mImageIO->GetDimensions( i );
+    mNumberOfChunks[i] = ( ( long )mDimSize[i] + ChunkSize - 1 ) / ChunkSize;
+    }
+  mMemoryBudget = 0;
+  mMemoryUsed = 0;
+}
+
+
+template <class TPixel>
+void
+ChunkedVolume<TPixel>::
+setMemoryBudget( size_t bytes )
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  mMemoryBudget = bytes;
+  this->shrink( mMemoryBudget );
+}
+
+
+template <class TPixel>
+size_t
+ChunkedVolume<TPixel>::
+memoryBudget() const
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  return mMemoryBudget;
+}
+
+
+template <class TPixel>
+size_t
+ChunkedVolume<TPixel>::
+memoryUsed() const
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  return mMemoryUsed;
+}
+
+
+template <class TPixel>
+long
+ChunkedVolume<TPixel>::
+chunkSize( int axis, long chunkIndex ) const
+{
+  return std::min( ( long )ChunkSize,
+    ( long )mDimSize[axis] - chunkIndex * ChunkSize );
+}
+
+
+template <class TPixel>
+typename ChunkedVolume<TPixel>::ChunkPointer
+ChunkedVolume<TPixel>::
+chunk( const long chunkIndex[3] )
+{
+  const long key = ( chunkIndex[2] * mNumberOfChunks[1] + chunkIndex[1] )
+    * mNumberOfChunks[0] + chunkIndex[0];
+  auto find = [this, key]()
+    {
+    std::lock_guard< std::mutex > lock( mMutex );
+    typename EntryMapType::iterator it = mIndex.find( key );
+    if( it == mIndex.end() )
+      {
+      return ChunkPointer();
+      }
+    mEntries.splice( mEntries.begin(), mEntries, it->second );
+    return mEntries.front().data;
+    };
+  ChunkPointer data = find();
+  if( data )
+    {
+    return data;
+    }
+
+  // Another thread may have read the chunk while this one waited
+  std::lock_guard< std::mutex > readLock( mReadMutex );
+  data = find();
+  if( data )
+    {
+    return data;
+    }
+  itk::ImageIORegion region( 3 );
+  size_t numberOfVoxels = 1;
+  for( int i=0; i<3; ++i )
+    {
+    const long size = this->chunkSize( i, chunkIndex[i] );
+    region.SetIndex( i, chunkIndex[i] * ChunkSize );
+    region.SetSize( i, size );
+    numberOfVoxels *= size;
+    }
+  std::shared_ptr< std::vector< PixelType > > chunkData(
+    new std::vector< PixelType >( numberOfVoxels ) );
+  try
+    {
+    mImageIO->SetIORegion( region );
+    mImageIO->Read( chunkData->data() );
+    }
+  catch( itk::ExceptionObject & )
+    {
+    std::fill( chunkData->begin(), chunkData->end(), PixelType( 0 ) );
+    return chunkData;
+    }
+  data = chunkData;
+
+  std::lock_guard< std::mutex > lock( mMutex );
+  const size_t size = chunkData->size() * sizeof( PixelType );
+  this->shrink( mMemoryBudget > size ? mMemoryBudget - size : 0 );
+  if( size <= mMemoryBudget )
+    {
+    Entry entry;
+    entry.key = key;
+    entry.data = data;
+    mEntries.push_front( entry );
+    mIndex[key] = mEntries.begin();
+    mMemoryUsed += size;
+    }
+  return data;
+}
+
+
+template <class TPixel>
+void
+ChunkedVolume<TPixel>::
+readRegion( const long start[3], const unsigned long size[3],
+  PixelType * out )
+{
+  const long end[3] = { start[0] + ( long )size[0],
+    start[1] + ( long )size[1], start[2] + ( long )size[2] };
+  if( size[0] == 0 || size[1] == 0 || size[2] == 0 )
+    {
+    return;
+    }
+  long chunkIndex[3];
+  for( chunkIndex[2] = start[2] / ChunkSize;
+    chunkIndex[2] <= ( end[2] - 1 ) / ChunkSize; ++chunkIndex[2] )
+    {
+    for( chunkIndex[1] = start[1] / ChunkSize;
+      chunkIndex[1] <= ( end[1] - 1 ) / ChunkSize; ++chunkIndex[1] )
+      {
+      for( chunkIndex[0] = start[0] / ChunkSize;
+        chunkIndex[0] <= ( end[0] - 1 ) / ChunkSize; ++chunkIndex[0] )
+        {
+        const ChunkPointer data = this->chunk( chunkIndex );
+        // The part of the box in the chunk, and the size of the chunk
+        long first[3];
+        long chunkStart[3];
+        long chunkEnd[3];
+        long extent[3];
+        for( int i=0; i<3; ++i )
+          {
+          first[i] = chunkIndex[i] * ChunkSize;
+          extent[i] = this->chunkSize( i, chunkIndex[i] );
+          chunkStart[i] = std::max( start[i], first[i] );
+          chunkEnd[i] = std::min( end[i], first[i] + extent[i] );
+          }
+        const size_t rowBytes =
+          ( chunkEnd[0] - chunkStart[0] ) * sizeof( PixelType );
+        for( long z = chunkStart[2]; z < chunkEnd[2]; ++z )
+          {
+          for( long y = chunkStart[1]; y < chunkEnd[1]; ++y )
+            {
+            const PixelType * in = data->data()
+              + ( ( z - first[2] ) * extent[1] + y - first[1] )
+              * extent[0] + chunkStart[0] - first[0];
+            PixelType * o = out + ( ( z - start[2] ) * ( long )size[1]
+              + y - start[1] ) * ( long )size[0] + chunkStart[0] - start[0];
+            memcpy( o, in, rowBytes );
+            }
+          }
+        }
+      }
+    }
+}
+
+
+template <class TPixel>
+TPixel
+ChunkedVolume<TPixel>::
+value( const long index[3] )
+{
+  const unsigned long size[3] = { 1, 1, 1 };
+  PixelType v;
+  this->readRegion( index, size, &v );
+  return v;
+}
+
+
+template <class TPixel>
+void
+ChunkedVolume<TPixel>::
+clear()
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  mEntries.clear();
+  mIndex.clear();
+  mMemoryUsed = 0;
+}
+
+
+template <class TPixel>
+void
+ChunkedVolume<TPixel>::
+shrink( size_t budget )
+{
+  while( mMemoryUsed > budget && !mEntries.empty() )
+    {
+    const Entry & entry = mEntries.back();
+    mMemoryUsed -= entry.data->size() * sizeof( PixelType );
+    mIndex.erase( entry.key );
+    mEntries.pop_back();
+    }
+}
+
+
+template class ChunkedVolume<unsigned char>;
+template class ChunkedVolume<short>;
+template class ChunkedVolume<unsigned short>;
+template class ChunkedVolume<float>;
+template class ChunkedVolume<double>;
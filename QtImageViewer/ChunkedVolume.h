@@ -0,0 +1,123 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __ChunkedVolume_h
+#define __ChunkedVolume_h
+
+// ITK includes
+#include "itkImageIOBase.h"
+
+// STD includes
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+* ChunkedVolume : a 3D image read from its file on demand, in bricks of
+* ChunkSize voxels a side, through the streamed region reads of an
+* itk::ImageIOBase. The least recently used chunks are dropped when the
+* chunks read grow beyond the memory budget.
+*
+* Every orientation reads the same share of the file: a slice reads the
+* ChunkSize slices around it, which the next slices reuse, and a
+* sagittal slice no longer reads every row of the file.
+*
+* The volume is shared by the render threads and the SlicePrefetcher
+* worker. The file is read by one thread at a time, but the cached chunks
+* are found without waiting for a read.
+**/
+template <class TPixel>
+class ChunkedVolume
+{
+public:
+  typedef TPixel PixelType;
+
+  enum { ChunkSize = 32 };
+
+  /*! imageIO must have read the information of a 3D image of PixelType,
+  *   and be able to stream reads */
+  ChunkedVolume( itk::ImageIOBase * imageIO );
+
+  const unsigned long * dimSize() const
+    {
+    return mDimSize;
+    }
+
+  /*! Maximum number of bytes of chunks kept */
+  void setMemoryBudget( size_t bytes );
+  size_t memoryBudget() const;
+  size_t memoryUsed() const;
+
+  /*! Copy the voxels of the box of size size at start to out, x
+  *   fastest, reading the chunks that are not cached */
+  void readRegion( const long start[3], const unsigned long size[3],
+    PixelType * out );
+
+  /*! Value of the voxel at index */
+  PixelType value( const long index[3] );
+
+  /*! Drop the cached chunks */
+  void clear();
+
+protected:
+  typedef std::shared_ptr< const std::vector< PixelType > > ChunkPointer;
+
+  struct Entry
+    {
+    long         key;
+    ChunkPointer data;
+    };
+
+  typedef std::list< Entry > EntryListType;
+  typedef std::unordered_map< long,
+    typename EntryListType::iterator > EntryMapType;
+
+  /*! Chunk of index chunkIndex, in chunks, from the cache or else from
+  *   the file. A chunk whose read fails is zero rather than stopping the
+  *   render threads, and is not cached, so it is read again next time. */
+  ChunkPointer chunk( const long chunkIndex[3] );
+
+  /*! Number of voxels along axis of the chunks of index chunkIndex */
+  long chunkSize( int axis, long chunkIndex ) const;
+
+  /*! Drop the least recently used chunks until the cache fits.
+  *   The caller holds mMutex. */
+  void shrink( size_t budget );
+
+  itk::ImageIOBase::Pointer mImageIO;
+  unsigned long             mDimSize[3];
+  long                      mNumberOfChunks[3];
+
+  size_t                    mMemoryBudget;
+  size_t                    mMemoryUsed;
+
+  /* most recently used first */
+  EntryListType             mEntries;
+  EntryMapType              mIndex;
+
+  mutable std::mutex        mMutex;
+  /* held while mImageIO reads */
+  std::mutex                mReadMutex;
+};
+
+#endif
@@ -0,0 +1,237 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "CompressedImageWriter.h"
+#include "ChunkedGzip.h"
+
+// STD includes
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+
+namespace
+{
+
+/* names of the pixel types in the MetaImage and NRRD headers */
+template <class TPixel>
+struct PixelTypeName;
+
+template <>
+struct PixelTypeName< unsigned char >
+{
+  static const char * metaImage()
+    {
+    return "MET_UCHAR";
+    }
+
+  static const char * nrrd()
+    {
+    return "unsigned char";
+    }
+};
+
+template <>
+struct PixelTypeName< short >
+{
+  static const char * metaImage()
+    {
+    return "MET_SHORT";
+    }
+
+  static const char * nrrd()
+    {
+    return "short";
+    }
+};
+
+template <>
+struct PixelTypeName< unsigned short >
+{
+  static const char * metaImage()
+    {
+    return "MET_USHORT";
+    }
+
+  static const char * nrrd()
+    {
+    return "unsigned short";
+    }
+};
+
+template <>
+struct PixelTypeName< float >
+{
+  static const char * metaImage()
+    {
+    return "MET_FLOAT";
+    }
+
+  static const char * nrrd()
+    {
+    return "float";
+    }
+};
+
+template <>
+struct PixelTypeName< double >
+{
+  static const char * metaImage()
+    {
+    return "MET_DOUBLE";
+    }
+
+  static const char * nrrd()
+    {
+    return "double";
+    }
+};
+
+bool
+hostIsBigEndian()
+{
+  const unsigned short one = 1;
+  return *reinterpret_cast< const unsigned char * >( &one ) == 0;
+}
+
+std::string
+suffix( const std::string & fileName )
+{
+  const size_t dot = fileName.find_last_of( '.' );
+  if( dot == std::string::npos )
+    {
+    return std::string();
+    }
+  std::string res = fileName.substr( dot + 1 );
+  std::transform( res.begin(), res.end(), res.begin(), ::tolower );
+  return res;
+}
+
+}
+
+
+bool
+CompressedImageWriter::
+canWrite( const std::string & fileName )
+{
+  const std::string type = suffix( fileName );
+  return type == "mha" || type == "nrrd";
+}
+
+
+template <class TPixel>
+bool
+CompressedImageWriter::
+write( const std::string & fileName, const itk::Image< TPixel, 3 > * image,
+  itk::MultiThreaderBase * threader )
+{
+  typedef itk::Image< TPixel, 3 > ImageType;
+
+  if( !canWrite( fileName ) )
+    {
+    return false;
+    }
+  const typename ImageType::SizeType size =
+    image->GetLargestPossibleRegion().GetSize();
+  const typename ImageType::SpacingType spacing = image->GetSpacing();
+  const typename ImageType::PointType origin = image->GetOrigin();
+  const typename ImageType::DirectionType direction =
+    image->GetDirection();
+
+  std::vector< char > stream;
+  if( !ChunkedGzip::compress( image->GetBufferPointer(),
+    size[0] * size[1] * size[2] * sizeof( TPixel ), stream, threader ) )
+    {
+    return false;
+    }
+
+  std::ofstream file( fileName.c_str(), std::ios::out | std::ios::binary
+    | std::ios::trunc );
+  if( !file )
+    {
+    return false;
+    }
+  file << std::setprecision( 17 );
+  if( suffix( fileName ) == "mha" )
+    {
+    // The transform matrix lists the direction of each axis in turn
+    file << "ObjectType = Image\n"
+      << "NDims = 3\n"
+      << "BinaryData = True\n"
+      << "BinaryDataByteOrderMSB = "
+      << ( hostIsBigEndian() ? "True" : "False" ) << "\n"
+      << "CompressedData = True\n"
+      << "CompressedDataSize = " << stream.size() << "\n"
+      << "TransformMatrix =";
+    for( unsigned int i=0; i<3; ++i )
+      {
+      for( unsigned int j=0; j<3; ++j )
+        {
+        file << " " << direction[j][i];
+        }
+      }
+    file << "\nOffset = "
+      << origin[0] << " " << origin[1] << " " << origin[2] << "\n"
+      << "ElementSpacing = "
+      << spacing[0] << " " << spacing[1] << " " << spacing[2] << "\n"
+      << "DimSize = " << size[0] << " " << size[1] << " " << size[2] << "\n"
+      << "ElementType = " << PixelTypeName< TPixel >::metaImage() << "\n"
+      << "ElementDataFile = LOCAL\n";
+    }
+  else
+    {
+    // The space directions are the axes scaled by the spacing
+    file << "NRRD0004\n"
+      << "type: " << PixelTypeName< TPixel >::nrrd() << "\n"
+      << "dimension: 3\n"
+      << "space: left-posterior-superior\n"
+      << "sizes: " << size[0] << " " << size[1] << " " << size[2] << "\n"
+      << "space directions:";
+    for( unsigned int i=0; i<3; ++i )
+      {
+      file << " (" << direction[0][i] * spacing[i] << ","
+        << direction[1][i] * spacing[i] << ","
+        << direction[2][i] * spacing[i] << ")";
+      }
+    file << "\nkinds: domain domain domain\n"
+      << "endian: " << ( hostIsBigEndian() ? "big" : "little" ) << "\n"
+      << "encoding: gzip\n"
+      << "space origin: ("
+      << origin[0] << "," << origin[1] << "," << origin[2] << ")\n\n";
+    }
+  file.write( stream.data(), stream.size() );
+  return file.good();
+}
+
+
+template bool CompressedImageWriter::write( const std::string &,
+  const itk::Image< unsigned char, 3 > *, itk::MultiThreaderBase * );
+template bool CompressedImageWriter::write( const std::string &,
+  const itk::Image< short, 3 > *, itk::MultiThreaderBase * );
+template bool CompressedImageWriter::write( const std::string &,
+  const itk::Image< unsigned short, 3 > *, itk::MultiThreaderBase * );
+template bool CompressedImageWriter::write( const std::string &,
+  const itk::Image< float, 3 > *, itk::MultiThreaderBase * );
+template bool CompressedImageWriter::write( const std::string &,
+  const itk::Image< double, 3 > *, itk::MultiThreaderBase * );
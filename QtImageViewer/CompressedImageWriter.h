@@ -0,0 +1,55 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __CompressedImageWriter_h
+#define __CompressedImageWriter_h
+
+// ITK includes
+#include "itkImage.h"
+#include "itkMultiThreaderBase.h"
+
+// STD includes
+#include <string>
+
+/**
+* CompressedImageWriter : writes a 3D image as a MetaImage (.mha) or NRRD
+* (.nrrd) file whose pixels are compressed as a ChunkedGzip stream, on
+* all the threads, so MappedImageReader inflates them in parallel too.
+*
+* The stream is a single gzip member, which the MetaImage and NRRD
+* readers of ITK and other tools inflate as any compressed file. The
+* pixels are written in the byte order of the host.
+**/
+class CompressedImageWriter
+{
+public:
+  /*! True if fileName is a MetaImage or NRRD file with its header */
+  static bool canWrite( const std::string & fileName );
+
+  /*! Write image to fileName, compressing it on threader if it is not
+  *   NULL. False if the file cannot be written. */
+  template <class TPixel>
+  static bool write( const std::string & fileName,
+    const itk::Image< TPixel, 3 > * image,
+    itk::MultiThreaderBase * threader );
+};
+
+#endif
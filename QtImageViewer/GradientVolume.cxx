@@ -0,0 +1,280 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "GradientVolume.h"
+#include "WindowLevelKernel.h"
+
+// STD includes
+#include <algorithm>
+
+#if defined( __x86_64__ ) || defined( _M_X64 ) \
+  || ( defined( __i386__ ) && defined( __SSE2__ ) )
+#define GRADIENT_X86
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#define GRADIENT_TARGET_AVX2
+#else
+#define GRADIENT_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#endif
+#endif
+
+namespace
+{
+
+/* Gradient magnitudes of count voxels of row v, from the backward
+   differences to v[j-1] and to rows yv and zv, the rows before along y
+   and z. The operations are those of GradientVolume::magnitude(). */
+typedef void ( *GradientRowFunction )( const double * v, const double * yv,
+  const double * zv, int count, double * out );
+
+void
+gradientRowScalar( const double * v, const double * yv, const double * zv,
+  int count, double * out )
+{
+  for( int j=0; j<count; ++j )
+    {
+    const double dx = v[j] - v[j-1];
+    const double dy = v[j] - yv[j];
+    const double dz = v[j] - zv[j];
+    out[j] = std::sqrt( dx * dx + dy * dy + dz * dz );
+    }
+}
+
+
+#if defined( GRADIENT_X86 )
+
+void
+gradientRowSSE2( const double * v, const double * yv, const double * zv,
+  int count, double * out )
+{
+  int j = 0;
+  for( ; j+2<=count; j+=2 )
+    {
+    const __m128d c = _mm_loadu_pd( v + j );
+    const __m128d dx = _mm_sub_pd( c, _mm_loadu_pd( v + j - 1 ) );
+    const __m128d dy = _mm_sub_pd( c, _mm_loadu_pd( yv + j ) );
+    const __m128d dz = _mm_sub_pd( c, _mm_loadu_pd( zv + j ) );
+    const __m128d sum = _mm_add_pd( _mm_add_pd( _mm_mul_pd( dx, dx ),
+      _mm_mul_pd( dy, dy ) ), _mm_mul_pd( dz, dz ) );
+    _mm_storeu_pd( out + j, _mm_sqrt_pd( sum ) );
+    }
+  gradientRowScalar( v + j, yv + j, zv + j, count - j, out + j );
+}
+
+
+GRADIENT_TARGET_AVX2
+void
+gradientRowAVX2( const double * v, const double * yv, const double * zv,
+  int count, double * out )
+{
+  int j = 0;
+  for( ; j+4<=count; j+=4 )
+    {
+    const __m256d c = _mm256_loadu_pd( v + j );
+    const __m256d dx = _mm256_sub_pd( c, _mm256_loadu_pd( v + j - 1 ) );
+    const __m256d dy = _mm256_sub_pd( c, _mm256_loadu_pd( yv + j ) );
+    const __m256d dz = _mm256_sub_pd( c, _mm256_loadu_pd( zv + j ) );
+    const __m256d sum = _mm256_add_pd( _mm256_add_pd(
+      _mm256_mul_pd( dx, dx ), _mm256_mul_pd( dy, dy ) ),
+      _mm256_mul_pd( dz, dz ) );
+    _mm256_storeu_pd( out + j, _mm256_sqrt_pd( sum ) );
+    }
+  gradientRowScalar( v + j, yv + j, zv + j, count - j, out + j );
+}
+
+#endif
+
+
+GradientRowFunction
+gradientRowFunction( WindowLevelISAType isa )
+{
+#if defined( GRADIENT_X86 )
+  switch( isa )
+    {
+    case WL_AVX2:
+      return &gradientRowAVX2;
+    case WL_SSE2:
+      return &gradientRowSSE2;
+    default:
+      break;
+    }
+#endif
+  return &gradientRowScalar;
+}
+
+}
+
+
+template <class TPixel>
+GradientVolume<TPixel>::
+GradientVolume()
+  : mCancel( false ), mReady( false )
+{
+  mBuffer = NULL;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = 0;
+    }
+  mScale = Traits::scale();
+}
+
+
+template <class TPixel>
+GradientVolume<TPixel>::
+~GradientVolume()
+{
+  this->clear();
+}
+
+
+template <class TPixel>
+void
+GradientVolume<TPixel>::
+setInput( const PixelType * buffer, const unsigned long dimSize[3] )
+{
+  this->clear();
+  mBuffer = buffer;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = dimSize[i];
+    }
+}
+
+
+template <class TPixel>
+void
+GradientVolume<TPixel>::
+setRange( double minimum, double maximum )
+{
+  if( !std::numeric_limits< MagnitudeType >::is_integer
+    || maximum <= minimum )
+    {
+    return;
+    }
+  const double scale = 65535 / ( std::sqrt( 3.0 ) * ( maximum - minimum ) );
+  if( scale != mScale )
+    {
+    this->clear();
+    mScale = scale;
+    }
+}
+
+
+template <class TPixel>
+void
+GradientVolume<TPixel>::
+clear()
+{
+  if( mThread.joinable() )
+    {
+    mCancel = true;
+    mThread.join();
+    }
+  mCancel = false;
+  mReady.store( false, std::memory_order_release );
+  std::vector< MagnitudeType >().swap( mMagnitude );
+}
+
+
+template <class TPixel>
+void
+GradientVolume<TPixel>::
+requestUpdate()
+{
+  if( mBuffer == NULL || this->isReady() || mThread.joinable() )
+    {
+    return;
+    }
+  mMagnitude.resize( mDimSize[0] * mDimSize[1] * mDimSize[2] );
+  mThread = std::thread( &GradientVolume::run, this );
+}
+
+
+template <class TPixel>
+void
+GradientVolume<TPixel>::
+run()
+{
+  const long sizeX = ( long )mDimSize[0];
+  const long sizeY = ( long )mDimSize[1];
+  const long sizeZ = ( long )mDimSize[2];
+  const long strideZ = sizeX * sizeY;
+  const GradientRowFunction gradientRow =
+    gradientRowFunction( WindowLevelKernel::hostISA() );
+
+  // The kernels read the rows as doubles: the row, the one before it
+  //   along y, kept from the last row, and the one before along z
+  std::vector< double > row( sizeX );
+  std::vector< double > rowY( sizeX );
+  std::vector< double > rowZ( sizeX );
+  std::vector< double > magnitude( sizeX );
+  for( long z=0; z<sizeZ; ++z )
+    {
+    if( mCancel )
+      {
+      return;
+      }
+    for( long y=0; y<sizeY; ++y )
+      {
+      const long offset = z * strideZ + y * sizeX;
+      const PixelType * p = mBuffer + offset;
+      MagnitudeType * out = &( mMagnitude[offset] );
+      row.swap( rowY );
+      std::copy( p, p + sizeX, row.begin() );
+      if( y == 0 || z == 0 )
+        {
+        // A component is zero on the first index of its axis
+        for( long x=0; x<sizeX; ++x )
+          {
+          const double v = row[x];
+          const double dx = ( x > 0 ) ? v - row[x-1] : 0;
+          const double dy = ( y > 0 ) ? v - rowY[x] : 0;
+          const double dz = ( z > 0 ) ? v - ( double )p[x-strideZ] : 0;
+          out[x] = store( std::sqrt( dx * dx + dy * dy + dz * dz ),
+            mScale );
+          }
+        continue;
+        }
+      std::copy( p - strideZ, p - strideZ + sizeX, rowZ.begin() );
+      const double dy = row[0] - rowY[0];
+      const double dz = row[0] - rowZ[0];
+      out[0] = store( std::sqrt( 0.0 + dy * dy + dz * dz ), mScale );
+      if( sizeX > 1 )
+        {
+        gradientRow( &row[1], &rowY[1], &rowZ[1], ( int )sizeX - 1,
+          &magnitude[1] );
+        }
+      for( long x=1; x<sizeX; ++x )
+        {
+        out[x] = store( magnitude[x], mScale );
+        }
+      }
+    }
+  mReady.store( true, std::memory_order_release );
+}
+
+
+template class GradientVolume<unsigned char>;
+template class GradientVolume<short>;
+template class GradientVolume<unsigned short>;
+template class GradientVolume<float>;
+template class GradientVolume<double>;
@@ -0,0 +1,185 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __GradientVolume_h
+#define __GradientVolume_h
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <thread>
+#include <vector>
+
+/**
+* GradientMagnitudeTraits : how the gradient magnitudes of an image of
+* TPixel are stored. The magnitudes of the integer types, at most sqrt( 3 )
+* times the range of the image, are 16 bit fixed point numbers in steps of
+* 1/scale, where GradientVolume::setRange() makes scale fit that range in
+* 16 bits. scale() is the one used until then: 1/128 for unsigned char,
+* 2 for short and unsigned short. Those of float and double images are
+* floats.
+**/
+template <class TPixel>
+struct GradientMagnitudeTraits
+{
+  typedef float MagnitudeType;
+
+  static double scale()
+    {
+    return 1;
+    }
+};
+
+template <>
+struct GradientMagnitudeTraits< unsigned char >
+{
+  typedef unsigned short MagnitudeType;
+
+  static double scale()
+    {
+    return 128;
+    }
+};
+
+template <>
+struct GradientMagnitudeTraits< short >
+{
+  typedef unsigned short MagnitudeType;
+
+  static double scale()
+    {
+    return 0.5;
+    }
+};
+
+template <>
+struct GradientMagnitudeTraits< unsigned short >
+{
+  typedef unsigned short MagnitudeType;
+
+  static double scale()
+    {
+    return 0.5;
+    }
+};
+
+/**
+* GradientVolume : gradient magnitude of a 3D image, computed in a
+* background thread the first time it is requested.
+*
+* The gradient is taken by backward differences along each image axis,
+* as the IMG_DX, IMG_DY and IMG_DZ modes do, with a zero component on
+* the first index of an axis. The magnitudes are stored as
+* GradientMagnitudeTraits and scale() give, in the layout of the image,
+* so the volume takes at most the memory of the image, and twice that of
+* an unsigned char one. The rows are computed by SIMD kernels, selected as the
+* WindowLevelKernel ones, which give the same magnitudes as the scalar
+* code. Until the volume is ready, SliceReslicer computes the magnitudes
+* of each row with magnitude(), which rounds them the same way, so
+* switching to the volume does not change the display.
+**/
+template <class TPixel>
+class GradientVolume
+{
+public:
+  typedef TPixel                                      PixelType;
+  typedef GradientMagnitudeTraits< PixelType >        Traits;
+  typedef typename Traits::MagnitudeType              MagnitudeType;
+
+  GradientVolume();
+  ~GradientVolume();
+
+  /*! Specify the x-fastest pixel buffer and its size. Drops the volume. */
+  void setInput( const PixelType * buffer, const unsigned long dimSize[3] );
+
+  /*! Store the magnitudes of the integer types in steps fitting the
+  *   largest magnitude of pixels from minimum to maximum in 16 bits,
+  *   65535 / ( sqrt( 3 ) * ( maximum - minimum ) ). Drops the volume if
+  *   that changes the steps. */
+  void setRange( double minimum, double maximum );
+
+  /*! Number of steps of a stored magnitude per unit of magnitude */
+  double scale() const
+    {
+    return mScale;
+    }
+
+  /*! Stop the computation and drop the volume, e.g., after the pixels
+  *   changed in place */
+  void clear();
+
+  /*! Start computing the volume in the background, unless it is ready or
+  *   being computed */
+  void requestUpdate();
+
+  /*! True once the whole volume is computed */
+  bool isReady() const
+    {
+    return mReady.load( std::memory_order_acquire );
+    }
+
+  /*! Stored magnitudes, in the layout of the input, which value() reads.
+  *   Only valid if isReady(). */
+  const MagnitudeType * magnitudes() const
+    {
+    return &( mMagnitude[0] );
+    }
+
+  /*! Stored form of a gradient magnitude, in steps of 1/scale */
+  static MagnitudeType store( double magnitude, double scale )
+    {
+    return std::numeric_limits< MagnitudeType >::is_integer
+      ? ( MagnitudeType )std::min( magnitude * scale + 0.5, 65535.0 )
+      : ( MagnitudeType )magnitude;
+    }
+
+  /*! Magnitude a stored magnitude stands for */
+  static double value( MagnitudeType magnitude, double scale )
+    {
+    return std::numeric_limits< MagnitudeType >::is_integer
+      ? ( double )magnitude / scale : ( double )magnitude;
+    }
+
+  /*! Magnitude of the backward differences dx, dy and dz, as stored */
+  static double magnitude( double dx, double dy, double dz, double scale )
+    {
+    return value( store( std::sqrt( dx * dx + dy * dy + dz * dz ), scale ),
+      scale );
+    }
+
+protected:
+  /*! Fill mMagnitude, slice by slice, until done or cancelled */
+  void run();
+
+  const PixelType *             mBuffer;
+  unsigned long                 mDimSize[3];
+  double                        mScale;
+  std::vector< MagnitudeType >  mMagnitude;
+
+  std::thread                   mThread;
+  std::atomic< bool >           mCancel;
+  std::atomic< bool >           mReady;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "ImagePyramid.h"
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+
+template <class TPixel>
+ImagePyramid<TPixel>::
+ImagePyramid()
+{
+  mBuffer = NULL;
+  for( int level=0; level<=MaxLevel; ++level )
+    {
+    for( int i=0; i<3; ++i )
+      {
+      mDimSize[level][i] = 0;
+      mExtent[level][i] = 0;
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+ImagePyramid<TPixel>::
+setInput( const PixelType * buffer, const unsigned long dimSize[3] )
+{
+  mBuffer = buffer;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[0][i] = dimSize[i];
+    }
+  for( int level=1; level<=MaxLevel; ++level )
+    {
+    for( int i=0; i<3; ++i )
+      {
+      mDimSize[level][i] = ( mDimSize[level-1][i] + 1 ) / 2;
+      }
+    }
+  for( int level=0; level<=MaxLevel; ++level )
+    {
+    for( int i=0; i<3; ++i )
+      {
+      mExtent[level][i] = std::ldexp( ( double )dimSize[i], -level );
+      }
+    }
+  this->clear();
+}
+
+
+template <class TPixel>
+void
+ImagePyramid<TPixel>::
+clear()
+{
+  for( int level=1; level<=MaxLevel; ++level )
+    {
+    std::vector< PixelType >().swap( mLevels[level] );
+    }
+}
+
+
+template <class TPixel>
+int
+ImagePyramid<TPixel>::
+maxLevel() const
+{
+  int level = 0;
+  while( level < MaxLevel && ( mDimSize[level+1][0] > 1
+    || mDimSize[level+1][1] > 1 || mDimSize[level+1][2] > 1 ) )
+    {
+    ++level;
+    }
+  return level;
+}
+
+
+template <class TPixel>
+void
+ImagePyramid<TPixel>::
+update( int level, itk::MultiThreaderBase * threader )
+{
+  if( mBuffer == NULL )
+    {
+    return;
+    }
+  level = std::min( level, this->maxLevel() );
+  for( int l=1; l<=level; ++l )
+    {
+    if( this->isBuilt( l ) )
+      {
+      continue;
+      }
+    const unsigned long * size = mDimSize[l];
+    mLevels[l].resize( size[0] * size[1] * size[2] );
+
+    // Each row of the level is independent
+    const long sizeY = ( long )size[1];
+    const long numberOfRows = sizeY * ( long )size[2];
+    auto reduceRow = [this, l, sizeY]( itk::SizeValueType row )
+      {
+      this->reduceRow( l, ( long )row % sizeY, ( long )row / sizeY );
+      };
+    if( threader != NULL && numberOfRows > 1 )
+      {
+      threader->ParallelizeArray( 0, numberOfRows, reduceRow, nullptr );
+      }
+    else
+      {
+      for( long row=0; row<numberOfRows; ++row )
+        {
+        reduceRow( row );
+        }
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+ImagePyramid<TPixel>::
+reduceRow( int level, long y, long z )
+{
+  const unsigned long * inSize = mDimSize[level-1];
+  const long sizeX = ( long )mDimSize[level][0];
+  const long strideY = ( long )inSize[0];
+  const long strideZ = strideY * ( long )inSize[1];
+  const double * inExtent = mExtent[level-1];
+  // The part of voxel i the input covers along an axis: 1 but at the
+  //   end, 0 past it. The voxel index is clamped to read in the buffer.
+  auto weight = []( double extent, long i )
+    {
+    return std::max( 0.0, std::min( 1.0, extent - i ) );
+    };
+  const long y0 = 2 * y;
+  const long y1 = std::min( y0 + 1, ( long )inSize[1] - 1 );
+  const long z0 = 2 * z;
+  const long z1 = std::min( z0 + 1, ( long )inSize[2] - 1 );
+  const double wy0 = weight( inExtent[1], y0 );
+  const double wy1 = weight( inExtent[1], y0 + 1 );
+  const double wz0 = weight( inExtent[2], z0 );
+  const double wz1 = weight( inExtent[2], z0 + 1 );
+  const double rowWeights[4] = { wy0 * wz0, wy1 * wz0, wy0 * wz1,
+    wy1 * wz1 };
+  const double blockWeight = ( wy0 + wy1 ) * ( wz0 + wz1 );
+  const PixelType * in = this->buffer( level-1 );
+  const PixelType * rows[4] = { in + y0 * strideY + z0 * strideZ,
+    in + y1 * strideY + z0 * strideZ, in + y0 * strideY + z1 * strideZ,
+    in + y1 * strideY + z1 * strideZ };
+  PixelType * out = &( mLevels[level][( z * ( long )mDimSize[level][1]
+    + y ) * sizeX] );
+  const long lastX = ( long )inSize[0] - 1;
+  for( long x=0; x<sizeX; ++x )
+    {
+    const long x0 = 2 * x;
+    const long x1 = std::min( x0 + 1, lastX );
+    const double wx0 = weight( inExtent[0], x0 );
+    const double wx1 = weight( inExtent[0], x0 + 1 );
+    double sum = 0;
+    for( int r=0; r<4; ++r )
+      {
+      sum += rowWeights[r] * ( wx0 * ( double )rows[r][x0]
+        + wx1 * ( double )rows[r][x1] );
+      }
+    // The means of integer pixels are rounded instead of truncated
+    const double mean = sum / ( blockWeight * ( wx0 + wx1 ) );
+    out[x] = std::is_integral< PixelType >::value
+      ? ( PixelType )std::floor( mean + 0.5 ) : ( PixelType )mean;
+    }
+}
+
+
+template class ImagePyramid<unsigned char>;
+template class ImagePyramid<short>;
+template class ImagePyramid<unsigned short>;
+template class ImagePyramid<float>;
+template class ImagePyramid<double>;
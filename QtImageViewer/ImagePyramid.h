@@ -0,0 +1,104 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __ImagePyramid_h
+#define __ImagePyramid_h
+
+// ITK includes
+#include "itkMultiThreaderBase.h"
+
+// STD includes
+#include <vector>
+
+/**
+* ImagePyramid : reduced resolution copies of a 3D image, for views that
+* show many voxels per screen pixel.
+*
+* Level 0 is the input and each level halves the previous one along all
+* three axes, rounding up, by averaging blocks of 2x2x2 voxels. Voxel i
+* of level l thus covers voxels i*2^l to ( i+1 )*2^l-1 of the input, but
+* the last voxel of an axis only covers the input voxels left: the image
+* spans extent( level ), the size of the input over 2^l, of the
+* dimSize( level ) voxels of the level. The voxels of a block are
+* weighted by the part of the input they cover, so the last voxels are
+* the means of the input voxels they cover.
+*
+* Levels are built the first time they are requested, in parallel, from
+* the level below, and kept until the input changes. Together they take
+* at most a seventh of the memory of the input.
+**/
+template <class TPixel>
+class ImagePyramid
+{
+public:
+  typedef TPixel PixelType;
+
+  enum { MaxLevel = 8 };
+
+  ImagePyramid();
+
+  /*! Specify the x-fastest pixel buffer and its size. Drops the levels. */
+  void setInput( const PixelType * buffer, const unsigned long dimSize[3] );
+
+  /*! Drop the levels, e.g., after the pixels changed in place */
+  void clear();
+
+  /*! Highest level, at most MaxLevel, with more than one voxel along
+  *   some axis */
+  int maxLevel() const;
+
+  /*! Build the levels up to level if they are not */
+  void update( int level, itk::MultiThreaderBase * threader );
+
+  bool isBuilt( int level ) const
+    {
+    return level == 0 || !mLevels[level].empty();
+    }
+
+  /*! Pixels of level, x fastest. Requires isBuilt( level ). */
+  const PixelType * buffer( int level ) const
+    {
+    return ( level == 0 ) ? mBuffer : &( mLevels[level][0] );
+    }
+
+  /*! Size of level along each axis */
+  const unsigned long * dimSize( int level ) const
+    {
+    return mDimSize[level];
+    }
+
+  /*! Size of the input along each axis, in voxels of level */
+  const double * extent( int level ) const
+    {
+    return mExtent[level];
+    }
+
+protected:
+  /*! Average the blocks of level-1 into row y, z of level */
+  void reduceRow( int level, long y, long z );
+
+  const PixelType *         mBuffer;
+  unsigned long             mDimSize[MaxLevel+1][3];
+  double                    mExtent[MaxLevel+1][3];
+  std::vector< PixelType >  mLevels[MaxLevel+1];
+};
+
+#endif
@@ -0,0 +1,360 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "ImageStatistics.h"
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+
+namespace
+{
+
+/* bin of a float or double pixel: the upper 16 bits of its float
+   representation, flipped so the bins are ordered as the values */
+template <class TPixel>
+struct HistogramBin
+{
+  enum { Exact = false };
+
+  static unsigned int bin( TPixel v )
+    {
+    const float f = static_cast< float >( v );
+    uint32_t bits;
+    memcpy( &bits, &f, sizeof( bits ) );
+    bits = ( bits & 0x80000000u ) ? ~bits : ( bits | 0x80000000u );
+    return bits >> 16;
+    }
+
+  static double offset()
+    {
+    return 0;
+    }
+};
+
+template <>
+struct HistogramBin< unsigned char >
+{
+  enum { Exact = true };
+
+  static unsigned int bin( unsigned char v )
+    {
+    return v;
+    }
+
+  static double offset()
+    {
+    return 0;
+    }
+};
+
+template <>
+struct HistogramBin< short >
+{
+  enum { Exact = true };
+
+  static unsigned int bin( short v )
+    {
+    return ( unsigned int )( v + 32768 );
+    }
+
+  static double offset()
+    {
+    return -32768;
+    }
+};
+
+template <>
+struct HistogramBin< unsigned short >
+{
+  enum { Exact = true };
+
+  static unsigned int bin( unsigned short v )
+    {
+    return v;
+    }
+
+  static double offset()
+    {
+    return 0;
+    }
+};
+
+/* value of the flipped float representation bits */
+double
+floatValue( uint32_t bits )
+{
+  bits = ( bits & 0x80000000u ) ? ( bits & 0x7fffffffu ) : ~bits;
+  float f;
+  memcpy( &f, &bits, sizeof( f ) );
+  return f;
+}
+
+/* a thread adds at least this many pixels */
+const size_t MinPixelsPerBlock = 1 << 20;
+
+}
+
+
+ImageStatistics::
+ImageStatistics()
+{
+  mExactBins = true;
+  mBinOffset = 0;
+  this->clear();
+}
+
+
+void
+ImageStatistics::
+clear()
+{
+  mNumberOfPixels = 0;
+  mMinimum = std::numeric_limits< double >::max();
+  mMaximum = std::numeric_limits< double >::lowest();
+  mMean = 0;
+  mSumSquares = 0;
+  mInteger = true;
+  mHistogram.clear();
+  mCumulativeHistogram.clear();
+}
+
+
+template <class TPixel>
+void
+ImageStatistics::
+add( const TPixel * buffer, size_t numberOfPixels,
+  itk::MultiThreaderBase * threader )
+{
+  typedef HistogramBin< TPixel > BinType;
+  mExactBins = BinType::Exact;
+  mBinOffset = BinType::offset();
+  if( numberOfPixels == 0 )
+    {
+    return;
+    }
+
+  // Each block of pixels gets its own moments and histogram, which are
+  //   then combined
+  size_t numberOfBlocks = 1;
+  if( threader != NULL )
+    {
+    numberOfBlocks = std::min( ( size_t )threader->GetNumberOfWorkUnits(),
+      ( numberOfPixels + MinPixelsPerBlock - 1 ) / MinPixelsPerBlock );
+    numberOfBlocks = std::max( numberOfBlocks, ( size_t )1 );
+    }
+  std::vector< ImageStatistics > blocks( numberOfBlocks );
+  auto addBlock = [&]( itk::SizeValueType block )
+    {
+    const size_t begin = numberOfPixels * block / numberOfBlocks;
+    const size_t end = numberOfPixels * ( block + 1 ) / numberOfBlocks;
+    ImageStatistics & statistics = blocks[block];
+    statistics.mHistogram.assign( NumberOfBins, 0 );
+    size_t * histogram = statistics.mHistogram.data();
+    // The sums are of the differences to the first pixel, which keeps
+    //   them small enough not to cancel out in the variance
+    const double shift = ( buffer[begin] == buffer[begin] )
+      ? ( double )buffer[begin] : 0;
+    double minimum = std::numeric_limits< double >::max();
+    double maximum = std::numeric_limits< double >::lowest();
+    double sum = 0;
+    double sumSquares = 0;
+    size_t count = 0;
+    bool integer = true;
+    for( size_t i=begin; i<end; ++i )
+      {
+      const TPixel p = buffer[i];
+      if( p != p )
+        {
+        integer = false;
+        continue;
+        }
+      const double v = p;
+      ++histogram[BinType::bin( p )];
+      if( !BinType::Exact && v != std::floor( v ) )
+        {
+        integer = false;
+        }
+      minimum = std::min( minimum, v );
+      maximum = std::max( maximum, v );
+      const double d = v - shift;
+      sum += d;
+      sumSquares += d * d;
+      ++count;
+      }
+    statistics.mNumberOfPixels = count;
+    statistics.mInteger = integer;
+    statistics.mMinimum = minimum;
+    statistics.mMaximum = maximum;
+    if( count > 0 )
+      {
+      statistics.mMean = shift + sum / count;
+      statistics.mSumSquares = std::max( sumSquares - sum * sum / count,
+        0.0 );
+      }
+    };
+  if( numberOfBlocks > 1 )
+    {
+    threader->ParallelizeArray( 0, numberOfBlocks, addBlock, nullptr );
+    }
+  else
+    {
+    addBlock( 0 );
+    }
+
+  for( size_t block=0; block<numberOfBlocks; ++block )
+    {
+    this->combine( blocks[block] );
+    }
+  this->updateCumulativeHistogram();
+}
+
+
+void
+ImageStatistics::
+merge( const ImageStatistics & other )
+{
+  mExactBins = other.mExactBins;
+  mBinOffset = other.mBinOffset;
+  this->combine( other );
+  this->updateCumulativeHistogram();
+}
+
+
+void
+ImageStatistics::
+combine( const ImageStatistics & other )
+{
+  mInteger = mInteger && other.mInteger;
+  if( other.mNumberOfPixels == 0 )
+    {
+    return;
+    }
+  // Chan et al. update of the mean and the sum of squares
+  const double n = ( double )mNumberOfPixels;
+  const double otherN = ( double )other.mNumberOfPixels;
+  const double delta = other.mMean - mMean;
+  const double total = n + otherN;
+  mMean += delta * otherN / total;
+  mSumSquares += other.mSumSquares + delta * delta * n * otherN / total;
+  mNumberOfPixels += other.mNumberOfPixels;
+  mMinimum = std::min( mMinimum, other.mMinimum );
+  mMaximum = std::max( mMaximum, other.mMaximum );
+  if( mHistogram.empty() )
+    {
+    mHistogram = other.mHistogram;
+    return;
+    }
+  for( unsigned int bin=0; bin<NumberOfBins; ++bin )
+    {
+    mHistogram[bin] += other.mHistogram[bin];
+    }
+}
+
+
+void
+ImageStatistics::
+updateCumulativeHistogram()
+{
+  mCumulativeHistogram.resize( mHistogram.size() );
+  size_t count = 0;
+  for( size_t bin=0; bin<mHistogram.size(); ++bin )
+    {
+    count += mHistogram[bin];
+    mCumulativeHistogram[bin] = count;
+    }
+}
+
+
+void
+ImageStatistics::
+binRange( unsigned int bin, double & minimum, double & maximum ) const
+{
+  if( mExactBins )
+    {
+    minimum = bin + mBinOffset;
+    maximum = minimum;
+    return;
+    }
+  minimum = floatValue( bin << 16 );
+  maximum = floatValue( ( bin << 16 ) | 0xffffu );
+}
+
+
+double
+ImageStatistics::
+percentile( double fraction ) const
+{
+  if( mNumberOfPixels == 0 )
+    {
+    return 0;
+    }
+  if( fraction <= 0 )
+    {
+    return mMinimum;
+    }
+  if( fraction >= 1 )
+    {
+    return mMaximum;
+    }
+  const double rank = fraction * ( mNumberOfPixels - 1 );
+  const unsigned int bin = ( unsigned int )( std::upper_bound(
+    mCumulativeHistogram.begin(), mCumulativeHistogram.end(),
+    ( size_t )rank ) - mCumulativeHistogram.begin() );
+  if( bin >= mHistogram.size() )
+    {
+    return mMaximum;
+    }
+
+  // The pixels of the bin are taken as evenly spread over its range,
+  //   clipped to the range of the image
+  double minimum;
+  double maximum;
+  this->binRange( bin, minimum, maximum );
+  minimum = std::max( minimum, mMinimum );
+  maximum = std::min( maximum, mMaximum );
+  if( !( minimum < maximum ) )
+    {
+    return std::min( std::max( minimum, mMinimum ), mMaximum );
+    }
+  const double before = ( double )( mCumulativeHistogram[bin]
+    - mHistogram[bin] );
+  const double t = std::min( std::max( ( rank - before + 0.5 )
+    / mHistogram[bin], 0.0 ), 1.0 );
+  return minimum + t * ( maximum - minimum );
+}
+
+
+template void ImageStatistics::add( const unsigned char *, size_t,
+  itk::MultiThreaderBase * );
+template void ImageStatistics::add( const short *, size_t,
+  itk::MultiThreaderBase * );
+template void ImageStatistics::add( const unsigned short *, size_t,
+  itk::MultiThreaderBase * );
+template void ImageStatistics::add( const float *, size_t,
+  itk::MultiThreaderBase * );
+template void ImageStatistics::add( const double *, size_t,
+  itk::MultiThreaderBase * );
@@ -0,0 +1,131 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __ImageStatistics_h
+#define __ImageStatistics_h
+
+// ITK includes
+#include "itkMultiThreaderBase.h"
+
+// STD includes
+#include <cstddef>
+#include <vector>
+
+/**
+* ImageStatistics : the range, mean, variance and histogram of the pixels
+* of an image, computed together in one parallel pass over the buffer.
+*
+* The histogram has NumberOfBins bins. Unsigned char, short and unsigned
+* short pixels have one bin per value, so their percentiles are exact.
+* The bin of a float or double pixel is given by the upper 16 bits of its
+* float representation (sign, exponent and 7 bits of mantissa), so a bin
+* spans less than 1% of its values whatever the range, and percentiles
+* are interpolated within their bin. NaN pixels are not counted.
+**/
+class ImageStatistics
+{
+public:
+  enum { NumberOfBins = 65536 };
+
+  ImageStatistics();
+
+  /*! Forget the pixels added */
+  void clear();
+
+  /*! Add numberOfPixels pixels of buffer, in parallel on threader if it
+  *   is not NULL. All the pixels added must be of the same type. */
+  template <class TPixel>
+  void add( const TPixel * buffer, size_t numberOfPixels,
+    itk::MultiThreaderBase * threader );
+
+  /*! Add the pixels of other, which are of the same type */
+  void merge( const ImageStatistics & other );
+
+  size_t numberOfPixels() const
+    {
+    return mNumberOfPixels;
+    }
+
+  /*! Smallest and largest pixel values, 0 if there are no pixels */
+  double minimum() const
+    {
+    return mNumberOfPixels > 0 ? mMinimum : 0;
+    }
+
+  double maximum() const
+    {
+    return mNumberOfPixels > 0 ? mMaximum : 0;
+    }
+
+  double mean() const
+    {
+    return mMean;
+    }
+
+  /*! True if every pixel added is an integer value, and none is NaN */
+  bool isInteger() const
+    {
+    return mInteger;
+    }
+
+  /*! Population variance of the pixel values */
+  double variance() const
+    {
+    return mNumberOfPixels > 0 ? mSumSquares / mNumberOfPixels : 0;
+    }
+
+  /*! Value below which fraction, from 0 to 1, of the pixels are, read
+  *   from the histogram */
+  double percentile( double fraction ) const;
+
+  /*! Number of pixels in each bin, empty if there are no pixels */
+  const std::vector< size_t > & histogram() const
+    {
+    return mHistogram;
+    }
+
+  /*! Smallest and largest values of bin */
+  void binRange( unsigned int bin, double & minimum,
+    double & maximum ) const;
+
+protected:
+  size_t                 mNumberOfPixels;
+  double                 mMinimum;
+  double                 mMaximum;
+  double                 mMean;
+  /* sum of the squared differences to the mean */
+  double                 mSumSquares;
+  bool                   mInteger;
+  /* true if each bin is one value, bin + mBinOffset */
+  bool                   mExactBins;
+  double                 mBinOffset;
+  std::vector< size_t >  mHistogram;
+  /* pixels in the bins up to each bin, for percentile() */
+  std::vector< size_t >  mCumulativeHistogram;
+
+  /*! Add the moments and histogram of other, without updating
+  *   mCumulativeHistogram */
+  void combine( const ImageStatistics & other );
+
+  void updateCumulativeHistogram();
+};
+
+#endif
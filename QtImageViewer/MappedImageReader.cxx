@@ -0,0 +1,569 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "MappedImageReader.h"
+#include "ChunkedGzip.h"
+
+// Qt includes
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+// ITK includes
+#include "itkImageIOFactory.h"
+#include "itkMultiThreaderBase.h"
+#include "itk_zlib.h"
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+
+namespace
+{
+
+bool
+hostIsBigEndian()
+{
+  const unsigned short one = 1;
+  return *reinterpret_cast< const unsigned char * >( &one ) == 0;
+}
+
+/* size of the NIfTI-1 header */
+const int NiftiHeaderSize = 348;
+
+/* field of type T at offset in header, swapped if swap is true */
+template <class T>
+T
+headerField( const unsigned char * header, size_t offset, bool swap )
+{
+  unsigned char bytes[sizeof( T )];
+  memcpy( bytes, header + offset, sizeof( T ) );
+  if( swap )
+    {
+    std::reverse( bytes, bytes + sizeof( T ) );
+    }
+  T value;
+  memcpy( &value, bytes, sizeof( T ) );
+  return value;
+}
+
+
+/**
+* MappedImageContainer : the pixel container of an image whose pixels
+* are a mapping of a file, which it unmaps when the image is released.
+**/
+template <class TPixel>
+class MappedImageContainer
+  : public itk::Image< TPixel, 3 >::PixelContainer
+{
+public:
+  typedef MappedImageContainer                             Self;
+  typedef typename itk::Image< TPixel, 3 >::PixelContainer Superclass;
+  typedef itk::SmartPointer< Self >                        Pointer;
+
+  itkNewMacro( Self );
+
+  /*! Hold the count pixels at mapping, mapped from file, which the
+  *   container now owns */
+  void setMapping( QFile * file, uchar * mapping,
+    itk::SizeValueType count )
+    {
+    mFile.reset( file );
+    mMapping = mapping;
+    this->SetImportPointer( reinterpret_cast< TPixel * >( mapping ),
+      count, false );
+    }
+
+protected:
+  MappedImageContainer()
+    {
+    mMapping = NULL;
+    }
+
+  ~MappedImageContainer()
+    {
+    if( mMapping != NULL )
+      {
+      mFile->unmap( mMapping );
+      }
+    }
+
+  std::unique_ptr< QFile > mFile;
+  uchar *                  mMapping;
+};
+
+}
+
+
+MappedImageReader::
+MappedImageReader()
+{
+  mDataOffset = 0;
+  mCompressedSize = -1;
+  mInflatedOffset = 0;
+  mCompressed = false;
+  mChunked = false;
+  mBigEndian = false;
+  mCanMap = false;
+}
+
+
+bool
+MappedImageReader::
+setFileName( const QString & fileName )
+{
+  mFileName = fileName;
+  mDataFileName = QString();
+  mDataOffset = 0;
+  mCompressedSize = -1;
+  mInflatedOffset = 0;
+  mCompressed = false;
+  mChunked = false;
+  mBigEndian = false;
+  mCanMap = false;
+  mImageIO = NULL;
+
+  const QString suffix = QFileInfo( fileName ).suffix().toLower();
+  bool located = false;
+  if( suffix == "mha" || suffix == "mhd" )
+    {
+    located = this->readMetaImageHeader();
+    }
+  else if( suffix == "nrrd" || suffix == "nhdr" )
+    {
+    located = this->readNrrdHeader();
+    }
+  else if( fileName.toLower().endsWith( ".nii.gz" ) )
+    {
+    located = this->readNiftiHeader();
+    }
+  if( !located )
+    {
+    return false;
+    }
+  mChunked = mCompressed && this->isChunkedStream();
+
+  // The geometry and the pixel type are read by ITK
+  mImageIO = itk::ImageIOFactory::CreateImageIO(
+    fileName.toLatin1().data(), itk::ImageIOFactory::ReadMode );
+  if( mImageIO.IsNull() )
+    {
+    return false;
+    }
+  try
+    {
+    mImageIO->SetFileName( fileName.toLatin1().data() );
+    mImageIO->ReadImageInformation();
+    }
+  catch( itk::ExceptionObject & )
+    {
+    return false;
+    }
+  // ASCII pixels, e.g. of a MetaImage without BinaryData, are text
+  const unsigned int numberOfDimensions = mImageIO->GetNumberOfDimensions();
+  mCanMap = mImageIO->GetFileType() == itk::ImageIOBase::Binary
+    && mImageIO->GetNumberOfComponents() == 1
+    && numberOfDimensions >= 2 && numberOfDimensions <= 3;
+  return mCanMap;
+}
+
+
+bool
+MappedImageReader::
+readMetaImageHeader()
+{
+  QFile file( mFileName );
+  if( !file.open( QIODevice::ReadOnly ) )
+    {
+    return false;
+    }
+  qint64 headerSize = 0;
+  while( !file.atEnd() )
+    {
+    const QByteArray line = file.readLine();
+    const int equal = line.indexOf( '=' );
+    if( equal < 0 )
+      {
+      continue;
+      }
+    const QByteArray key = line.left( equal ).trimmed();
+    const QByteArray value = line.mid( equal + 1 ).trimmed();
+    if( key == "CompressedData" )
+      {
+      mCompressed = ( value.toLower() == "true" );
+      }
+    else if( key == "CompressedDataSize" )
+      {
+      mCompressedSize = value.toLongLong();
+      }
+    else if( key == "BinaryDataByteOrderMSB"
+      || key == "ElementByteOrderMSB" )
+      {
+      mBigEndian = ( value.toLower() == "true" );
+      }
+    else if( key == "HeaderSize" )
+      {
+      headerSize = value.toLongLong();
+      }
+    else if( key == "ElementDataFile" )
+      {
+      // The last field: the pixels follow it, or are in one data file
+      if( value == "LOCAL" )
+        {
+        mDataFileName = mFileName;
+        mDataOffset = file.pos();
+        return true;
+        }
+      if( value.startsWith( "LIST" ) || value.indexOf( '%' ) >= 0
+        || value.indexOf( ' ' ) >= 0 )
+        {
+        return false;
+        }
+      mDataFileName = QFileInfo( mFileName ).dir().filePath(
+        QString::fromLocal8Bit( value.constData() ) );
+      mDataOffset = headerSize;
+      return true;
+      }
+    }
+  return false;
+}
+
+
+bool
+MappedImageReader::
+readNrrdHeader()
+{
+  QFile file( mFileName );
+  if( !file.open( QIODevice::ReadOnly )
+    || !file.readLine().startsWith( "NRRD" ) )
+    {
+    return false;
+    }
+  bool raw = false;
+  bool detached = false;
+  bool headerEnded = false;
+  qint64 byteSkip = 0;
+  while( !file.atEnd() )
+    {
+    const QByteArray line = file.readLine().trimmed();
+    if( line.isEmpty() )
+      {
+      headerEnded = true;
+      break;
+      }
+    const int colon = line.indexOf( ':' );
+    if( line.startsWith( "#" ) || colon < 0
+      || line.mid( colon + 1 ).startsWith( "=" ) )
+      {
+      continue;
+      }
+    const QByteArray key = line.left( colon ).trimmed().toLower();
+    const QByteArray value = line.mid( colon + 1 ).trimmed();
+    if( key == "encoding" )
+      {
+      raw = ( value == "raw" );
+      mCompressed = ( value == "gzip" || value == "gz" );
+      }
+    else if( key == "endian" )
+      {
+      mBigEndian = ( value == "big" );
+      }
+    else if( key == "byte skip" || key == "byteskip" )
+      {
+      byteSkip = value.toLongLong();
+      }
+    else if( key == "line skip" || key == "lineskip" )
+      {
+      if( value.toLongLong() != 0 )
+        {
+        return false;
+        }
+      }
+    else if( key == "data file" || key == "datafile" )
+      {
+      if( value.startsWith( "LIST" ) || value.indexOf( ' ' ) >= 0 )
+        {
+        return false;
+        }
+      mDataFileName = QFileInfo( mFileName ).dir().filePath(
+        QString::fromLocal8Bit( value.constData() ) );
+      detached = true;
+      }
+    }
+  // The byte skip of compressed data applies to the inflated data
+  if( !( raw || ( mCompressed && byteSkip == 0 ) )
+    || ( !detached && !headerEnded ) )
+    {
+    return false;
+    }
+  if( detached || byteSkip < 0 )
+    {
+    mDataOffset = byteSkip;
+    }
+  else
+    {
+    mDataFileName = mFileName;
+    mDataOffset = file.pos() + byteSkip;
+    }
+  return true;
+}
+
+
+bool
+MappedImageReader::
+readNiftiHeader()
+{
+  // The header starts the inflated stream
+  gzFile file = gzopen( QFile::encodeName( mFileName ).constData(), "rb" );
+  if( file == NULL )
+    {
+    return false;
+    }
+  unsigned char header[NiftiHeaderSize];
+  const int headerSize = gzread( file, header, NiftiHeaderSize );
+  gzclose( file );
+  if( headerSize != NiftiHeaderSize )
+    {
+    return false;
+    }
+
+  // The header size tells the byte order of the header and the pixels
+  const bool swap = headerField< int >( header, 0, false ) != NiftiHeaderSize;
+  if( headerField< int >( header, 0, swap ) != NiftiHeaderSize )
+    {
+    return false;
+    }
+  mBigEndian = ( hostIsBigEndian() != swap );
+
+  // Scaled pixels are read as floats by ITK
+  const float voxelOffset = headerField< float >( header, 108, swap );
+  const float slope = headerField< float >( header, 112, swap );
+  const float intercept = headerField< float >( header, 116, swap );
+  if( voxelOffset < NiftiHeaderSize || voxelOffset != ( qint64 )voxelOffset
+    || ( slope != 0 && ( slope != 1 || intercept != 0 ) ) )
+    {
+    return false;
+    }
+  mDataFileName = mFileName;
+  mDataOffset = 0;
+  mCompressed = true;
+  mInflatedOffset = ( qint64 )voxelOffset;
+  return true;
+}
+
+
+bool
+MappedImageReader::
+canInflate() const
+{
+  return mCanMap && mCompressed && mDataOffset >= 0
+    && ( mImageIO->GetComponentSize() == 1
+    || mBigEndian == hostIsBigEndian() );
+}
+
+
+MappedImageReader::ImageBaseType::Pointer
+MappedImageReader::
+read()
+{
+  if( !mCanMap || ( mCompressed && ( !mChunked || mInflatedOffset != 0 ) ) )
+    {
+    return NULL;
+    }
+  switch( mImageIO->GetComponentType() )
+    {
+    case itk::ImageIOBase::UCHAR:
+      return mCompressed ? this->inflateImage< unsigned char >()
+        : this->mapImage< unsigned char >();
+    case itk::ImageIOBase::SHORT:
+      return mCompressed ? this->inflateImage< short >()
+        : this->mapImage< short >();
+    case itk::ImageIOBase::USHORT:
+      return mCompressed ? this->inflateImage< unsigned short >()
+        : this->mapImage< unsigned short >();
+    case itk::ImageIOBase::FLOAT:
+      return mCompressed ? this->inflateImage< float >()
+        : this->mapImage< float >();
+    case itk::ImageIOBase::DOUBLE:
+      return mCompressed ? this->inflateImage< double >()
+        : this->mapImage< double >();
+    default:
+      return NULL;
+    }
+}
+
+
+bool
+MappedImageReader::
+isChunkedStream() const
+{
+  QFile file( mDataFileName );
+  if( mDataOffset < 0 || !file.open( QIODevice::ReadOnly )
+    || !file.seek( mDataOffset ) )
+    {
+    return false;
+    }
+  char header[16];
+  const qint64 headerSize = file.read( header, sizeof( header ) );
+  return headerSize > 0 && ChunkedGzip::isChunked( header, headerSize );
+}
+
+
+template <class TPixel>
+typename itk::Image< TPixel, 3 >::Pointer
+MappedImageReader::
+newImage() const
+{
+  typedef itk::Image< TPixel, 3 > ImageType;
+
+  typename ImageType::SizeType size;
+  typename ImageType::SpacingType spacing;
+  typename ImageType::PointType origin;
+  typename ImageType::DirectionType direction;
+  direction.SetIdentity();
+  const unsigned int numberOfDimensions = mImageIO->GetNumberOfDimensions();
+  for( unsigned int i=0; i<3; ++i )
+    {
+    size[i] = 1;
+    spacing[i] = 1;
+    origin[i] = 0;
+    if( i < numberOfDimensions )
+      {
+      size[i] = mImageIO->GetDimensions( i );
+      spacing[i] = mImageIO->GetSpacing( i );
+      origin[i] = mImageIO->GetOrigin( i );
+      const std::vector< double > axis = mImageIO->GetDirection( i );
+      for( unsigned int j=0; j<numberOfDimensions && j<axis.size(); ++j )
+        {
+        direction[j][i] = axis[j];
+        }
+      }
+    }
+
+  typename ImageType::RegionType region;
+  region.SetSize( size );
+  typename ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->SetSpacing( spacing );
+  image->SetOrigin( origin );
+  image->SetDirection( direction );
+  return image;
+}
+
+
+template <class TPixel>
+MappedImageReader::ImageBaseType::Pointer
+MappedImageReader::
+mapImage()
+{
+  typedef itk::Image< TPixel, 3 >         ImageType;
+  typedef MappedImageContainer< TPixel >  ContainerType;
+
+  if( sizeof( TPixel ) > 1 && mBigEndian != hostIsBigEndian() )
+    {
+    return NULL;
+    }
+
+  typename ImageType::Pointer image = this->newImage< TPixel >();
+  const typename ImageType::SizeType size =
+    image->GetLargestPossibleRegion().GetSize();
+  const qint64 numberOfPixels = ( qint64 )size[0] * size[1] * size[2];
+  const qint64 dataSize = numberOfPixels * sizeof( TPixel );
+
+  // The mapping must start on a pixel for the kernels to read it
+  std::unique_ptr< QFile > file( new QFile( mDataFileName ) );
+  if( !file->open( QIODevice::ReadOnly ) )
+    {
+    return NULL;
+    }
+  const qint64 offset = ( mDataOffset < 0 ) ? file->size() - dataSize
+    : mDataOffset;
+  if( offset < 0 || offset + dataSize > file->size()
+    || offset % sizeof( TPixel ) != 0 )
+    {
+    return NULL;
+    }
+  uchar * mapping = file->map( offset, dataSize,
+    QFileDevice::MapPrivateOption );
+  if( mapping == NULL )
+    {
+    return NULL;
+    }
+
+  typename ContainerType::Pointer container = ContainerType::New();
+  container->setMapping( file.release(), mapping, numberOfPixels );
+  image->SetPixelContainer( container );
+  return image.GetPointer();
+}
+
+
+template <class TPixel>
+MappedImageReader::ImageBaseType::Pointer
+MappedImageReader::
+inflateImage()
+{
+  typedef itk::Image< TPixel, 3 > ImageType;
+
+  if( sizeof( TPixel ) > 1 && mBigEndian != hostIsBigEndian() )
+    {
+    return NULL;
+    }
+
+  typename ImageType::Pointer image = this->newImage< TPixel >();
+  const typename ImageType::SizeType size =
+    image->GetLargestPossibleRegion().GetSize();
+  const size_t dataSize = ( size_t )size[0] * size[1] * size[2]
+    * sizeof( TPixel );
+
+  // The compressed stream is mapped, and the chunks inflated from it
+  QFile file( mDataFileName );
+  if( !file.open( QIODevice::ReadOnly ) )
+    {
+    return NULL;
+    }
+  const qint64 streamSize = ( mCompressedSize < 0 )
+    ? file.size() - mDataOffset : mCompressedSize;
+  if( streamSize <= 0 || mDataOffset + streamSize > file.size() )
+    {
+    return NULL;
+    }
+  uchar * stream = file.map( mDataOffset, streamSize );
+  if( stream == NULL )
+    {
+    return NULL;
+    }
+  image->Allocate();
+  itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+  const bool inflated = ChunkedGzip::inflate(
+    reinterpret_cast< const char * >( stream ), streamSize,
+    image->GetBufferPointer(), dataSize, threader );
+  file.unmap( stream );
+  if( !inflated )
+    {
+    return NULL;
+    }
+  return image.GetPointer();
+}
@@ -0,0 +1,145 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __MappedImageReader_h
+#define __MappedImageReader_h
+
+// Qt includes
+#include <QString>
+
+// ITK includes
+#include "itkImage.h"
+#include "itkImageIOBase.h"
+
+/**
+* MappedImageReader : wraps the pixels of an uncompressed MetaImage (.mha,
+* or .mhd and its data file) or NRRD file as an itk::Image without
+* reading them, by mapping the file into memory.
+*
+* The system reads the pages of the file as the slices first touch them,
+* and keeps them in the page cache shared by every viewer of the file.
+* The mapping is private, so pixels changed in memory are never written
+* back to the file.
+*
+* Compressed pixels written as a ChunkedGzip stream, e.g., by
+* CompressedImageWriter, are inflated in parallel into a new image
+* instead. Other compressed data, of the MetaImage, NRRD and gzipped
+* NIfTI (.nii.gz) files, is only located, for a VolumeLoader to inflate
+* it. Multi-component data, data stored in the other byte order, pixel
+* types a SliceVolume cannot hold and pixels not aligned on their size
+* in the file cannot be mapped, and must be read by an
+* itk::ImageFileReader instead.
+**/
+class MappedImageReader
+{
+public:
+  typedef itk::ImageBase< 3 > ImageBaseType;
+
+  MappedImageReader();
+
+  /*! Read the header of fileName and locate its pixels. Returns false if
+  *   they cannot be located, are stored as text, or are not those of a
+  *   scalar 2D or 3D image. */
+  bool setFileName( const QString & fileName );
+
+  /*! File holding the pixels, and their offset in it, or -1 if they end
+  *   the file */
+  const QString & dataFileName() const
+    {
+    return mDataFileName;
+    }
+
+  qint64 dataOffset() const
+    {
+    return mDataOffset;
+    }
+
+  /*! True if the pixels are a zlib or gzip stream of compressedSize()
+  *   bytes, or up to the end of the file if it is -1 */
+  bool isCompressed() const
+    {
+    return mCompressed;
+    }
+
+  qint64 compressedSize() const
+    {
+    return mCompressedSize;
+    }
+
+  /*! True if the compressed pixels are a ChunkedGzip stream, which
+  *   read() inflates into an image owning its buffer */
+  bool isChunked() const
+    {
+    return mChunked;
+    }
+
+  /*! Offset of the pixels in the inflated stream */
+  qint64 inflatedOffset() const
+    {
+    return mInflatedOffset;
+    }
+
+  /*! True if the pixels are compressed in the byte order of the host, so
+  *   inflating the stream gives them as a SliceVolume holds them */
+  bool canInflate() const;
+
+  /*! Map the pixels and wrap them as an image of their own pixel type,
+  *   or inflate them into a new image if they are a ChunkedGzip stream.
+  *   Returns NULL if they cannot be read this way. */
+  ImageBaseType::Pointer read();
+
+protected:
+  /*! Parse the MetaImage header fields locating the pixels */
+  bool readMetaImageHeader();
+
+  /*! Parse the NRRD header fields locating the pixels */
+  bool readNrrdHeader();
+
+  /*! Check the gzipped NIfTI header for pixels stored as they are read */
+  bool readNiftiHeader();
+
+  /*! True if the data file holds a ChunkedGzip stream at the offset */
+  bool isChunkedStream() const;
+
+  /*! New image of the geometry of the file, without pixels */
+  template <class TPixel>
+  typename itk::Image< TPixel, 3 >::Pointer newImage() const;
+
+  template <class TPixel>
+  ImageBaseType::Pointer mapImage();
+
+  template <class TPixel>
+  ImageBaseType::Pointer inflateImage();
+
+  QString                    mFileName;
+  QString                    mDataFileName;
+  qint64                     mDataOffset;
+  /* bytes of compressed data, or -1 if they end the file */
+  qint64                     mCompressedSize;
+  qint64                     mInflatedOffset;
+  bool                       mCompressed;
+  bool                       mChunked;
+  bool                       mBigEndian;
+  bool                       mCanMap;
+  itk::ImageIOBase::Pointer  mImageIO;
+};
+
+#endif
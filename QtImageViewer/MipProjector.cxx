@@ -0,0 +1,170 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "MipProjector.h"
+
+// STD includes
+#include <limits>
+
+
+template <class TPixel>
+MipProjector<TPixel>::
+MipProjector()
+{
+  mBuffer = NULL;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = 0;
+    }
+}
+
+
+template <class TPixel>
+void
+MipProjector<TPixel>::
+setInput( const PixelType * buffer, const unsigned long dimSize[3] )
+{
+  mBuffer = buffer;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = dimSize[i];
+    }
+  this->clear();
+}
+
+
+template <class TPixel>
+void
+MipProjector<TPixel>::
+clear()
+{
+  for( int i=0; i<3; ++i )
+    {
+    mMaximum[i].clear();
+    mDepth[i].clear();
+    }
+}
+
+
+template <class TPixel>
+long
+MipProjector<TPixel>::
+stride( int axis, int imageAxis ) const
+{
+  const int u = ( axis == 0 ) ? 1 : 0;
+  return ( imageAxis == u ) ? 1 : ( long )mDimSize[u];
+}
+
+
+template <class TPixel>
+void
+MipProjector<TPixel>::
+update( int axis, itk::MultiThreaderBase * threader )
+{
+  if( mBuffer == NULL || this->isProjected( axis ) )
+    {
+    return;
+    }
+  const int u = ( axis == 0 ) ? 1 : 0;
+  const int v = ( axis == 2 ) ? 1 : 2;
+  const size_t size = mDimSize[u] * mDimSize[v];
+  mMaximum[axis].assign( size, -std::numeric_limits< double >::infinity() );
+  mDepth[axis].assign( size, 0 );
+
+  // Each projection row is independent
+  auto projectRow = [this, axis]( itk::SizeValueType row )
+    {
+    this->projectRow( axis, ( long )row );
+    };
+  if( threader != NULL && mDimSize[v] > 1 )
+    {
+    threader->ParallelizeArray( 0, mDimSize[v], projectRow, nullptr );
+    }
+  else
+    {
+    for( unsigned long row=0; row<mDimSize[v]; ++row )
+      {
+      projectRow( row );
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+MipProjector<TPixel>::
+projectRow( int axis, long row )
+{
+  const int u = ( axis == 0 ) ? 1 : 0;
+  const int v = ( axis == 2 ) ? 1 : 2;
+  const long imageStride[3] = { 1, ( long )mDimSize[0],
+    ( long )( mDimSize[0] * mDimSize[1] ) };
+  const long sizeU = ( long )mDimSize[u];
+  const long depth = ( long )mDimSize[axis];
+  double * maximum = &( mMaximum[axis][row * sizeU] );
+  unsigned short * maximumDepth = &( mDepth[axis][row * sizeU] );
+  const PixelType * rowBuffer = mBuffer + row * imageStride[v];
+
+  if( axis == 0 )
+    {
+    // Rays run along x, which is contiguous
+    for( long i=0; i<sizeU; ++i )
+      {
+      const PixelType * p = rowBuffer + i * imageStride[u];
+      double m = maximum[i];
+      unsigned short z = 0;
+      for( long l=0; l<depth; ++l )
+        {
+        if( p[l] > m )
+          {
+          m = ( double )p[l];
+          z = ( unsigned short )l;
+          }
+        }
+      maximum[i] = m;
+      maximumDepth[i] = z;
+      }
+    return;
+    }
+
+  // Rays cross x rows, which are compared element-wise, plane by plane.
+  //   The selects keep the loop free of branches so it vectorizes.
+  for( long l=0; l<depth; ++l )
+    {
+    const PixelType * p = rowBuffer + l * imageStride[axis];
+    const unsigned short z = ( unsigned short )l;
+    for( long i=0; i<sizeU; ++i )
+      {
+      const double value = ( double )p[i];
+      const bool greater = value > maximum[i];
+      maximum[i] = greater ? value : maximum[i];
+      maximumDepth[i] = greater ? z : maximumDepth[i];
+      }
+    }
+}
+
+
+template class MipProjector<unsigned char>;
+template class MipProjector<short>;
+template class MipProjector<unsigned short>;
+template class MipProjector<float>;
+template class MipProjector<double>;
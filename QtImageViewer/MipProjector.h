@@ -0,0 +1,94 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __MipProjector_h
+#define __MipProjector_h
+
+// ITK includes
+#include "itkMultiThreaderBase.h"
+
+// STD includes
+#include <cstddef>
+#include <vector>
+
+/**
+* MipProjector : maximum intensity projections of a 3D image along each
+* image axis, with the depth of each maximum.
+*
+* A projection is computed once, in parallel, the first time it is
+* requested, and kept until the input changes. It does not depend on the
+* intensity window: the IMG_MIP kernel of SliceReslicer clamps it to the
+* lower window bound when it maps it to window values.
+*
+* The projection along axis a is stored over the two other image axes,
+* u < v, with u fastest. The maximum of a ray is its first largest value,
+* and its depth is the index of that value along a.
+**/
+template <class TPixel>
+class MipProjector
+{
+public:
+  typedef TPixel PixelType;
+
+  MipProjector();
+
+  /*! Specify the x-fastest pixel buffer and its size. Drops the
+  *   projections. */
+  void setInput( const PixelType * buffer, const unsigned long dimSize[3] );
+
+  /*! Drop the projections, e.g., after the pixels changed in place */
+  void clear();
+
+  /*! Compute the projection along axis if it is not cached */
+  void update( int axis, itk::MultiThreaderBase * threader );
+
+  bool isProjected( int axis ) const
+    {
+    return !mMaximum[axis].empty();
+    }
+
+  /*! Maxima of the projection along axis, u fastest */
+  const double * maximum( int axis ) const
+    {
+    return &( mMaximum[axis][0] );
+    }
+
+  /*! Depth of each maximum along axis */
+  const unsigned short * depth( int axis ) const
+    {
+    return &( mDepth[axis][0] );
+    }
+
+  /*! Offset in the projection along axis between two consecutive
+  *   indices of imageAxis, one of the two other image axes */
+  long stride( int axis, int imageAxis ) const;
+
+protected:
+  /*! Project along axis the rays of the projection row v */
+  void projectRow( int axis, long v );
+
+  const PixelType *             mBuffer;
+  unsigned long                 mDimSize[3];
+  std::vector< double >         mMaximum[3];
+  std::vector< unsigned short > mDepth[3];
+};
+
+#endif
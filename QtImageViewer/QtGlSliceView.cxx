@@ -29,15 +29,23 @@ limitations under the License.
 
 //QtImageViewer include
 #include "QtGlSliceView.h"
+#include "CompressedImageWriter.h"
+#include "RenderBufferPool.h"
+#include "SliceCache.h"
+#include "SlicePrefetcher.h"
+#include "SliceVolume.h"
+#include "SparseLabelVolume.h"
+#include "VolumeLoader.h"
 
 //itk include
-#include "itkMinimumMaximumImageCalculator.h"
 #include "itkImageFileWriter.h"
 #include "itkExtractImageFilter.h"
 #include "itkImageDuplicator.h"
 
 //std includes
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 // Qt includes
 #include <QDebug>
@@ -48,6 +56,7 @@ limitations under the License.
 #include <QScrollArea>
 #include <QBoxLayout>
 #include <QTextEdit>
+#include <QTimer>
 #include <memory>
 #include <QInputDialog>
 #include <QGuiApplication>
@@ -142,6 +151,15 @@ QtGlSliceView::QtGlSliceView( QWidget* widgetParent )
   cViewAxisLabel = 0;
   cColorTable = ColorTableType::New();
   cColorTable->UseDiscreteColors();
+  for ( unsigned int i=0; i < 256; ++i )
+    {
+    cLabelVisible[i] = true;
+    cLabelOpacity[i] = 1;
+    }
+  cOverlayColorsModified = true;
+  cOverlayColorTableMTime = 0;
+  cOverlayColorsGeneration = 0;
+  this->updateOverlayColors();
   for ( unsigned int i=0; i < 3; ++i )
     {
     cFlipX[i] = false;
@@ -173,6 +191,46 @@ QtGlSliceView::QtGlSliceView( QWidget* widgetParent )
   inDataSizeY = 0;
   cWinImData = NULL;
   cWinZBuffer = NULL;
+  // Room for the buffers of a few zoom levels of a large slice
+  cWinBufferPool.reset( new RenderBufferPool( 64*1024*1024 ) );
+  cRenderThreader = itk::MultiThreaderBase::New();
+  cSliceCache.reset( new SliceCache() );
+  this->setSliceCacheSize( 256 );
+  cSlicePrefetcher.reset( new SlicePrefetcher( cSliceCache.get() ) );
+  cNumberOfLoadedSlices = 0;
+  cStatisticsRunning = false;
+  cStatisticsCancelled = false;
+  cAutoWindow = false;
+  cAutoWindowPercent[0] = 1;
+  cAutoWindowPercent[1] = 99;
+  cAutoWindowRange[0] = 0;
+  cAutoWindowRange[1] = 0;
+  cLoadTimer = new QTimer( this );
+  connect( cLoadTimer, &QTimer::timeout, this,
+    &QtGlSliceView::updateLoading );
+  cBrickSize = 0;
+  cMaxPyramidLevel = 4;
+  cWinDataLevel = 0;
+  cWinDataStartX = 0;
+  cWinDataStartY = 0;
+  cMaxTextureSize = 1024;
+  for( WinTexture * texture : { &cImageTexture, &cOverlayTexture } )
+    {
+    texture->sizeX = 0;
+    texture->sizeY = 0;
+    texture->tileSize = 0;
+    texture->dirtyStartRow = 0;
+    texture->dirtyEndRow = -1;
+    }
+  cUploadedBytes = 0;
+  cTotalUploadedBytes = 0;
+  cSlabThickness = 5;
+  cImageGeneration = 0;
+  cOverlayGeneration = 0;
+  cImageLayerRenderCount = 0;
+  cValidImageLayer = false;
+  cValidOverlayLayer = false;
+  this->setNumberOfRenderThreads( 0 );
 
   cMessage = "";
 
@@ -206,6 +264,22 @@ QtGlSliceView::QtGlSliceView( QWidget* widgetParent )
 
 QtGlSliceView::~QtGlSliceView()
 {
+  cVolumeLoader.reset();
+  this->stopStatistics();
+  cSlicePrefetcher.reset();
+  if( this->context() != NULL )
+    {
+    this->makeCurrent();
+    for( WinTexture * texture : { &cImageTexture, &cOverlayTexture } )
+      {
+      if( !texture->ids.empty() )
+        {
+        glDeleteTextures( ( GLsizei )texture->ids.size(),
+          texture->ids.data() );
+        }
+      }
+    this->doneCurrent();
+    }
   if( cSaveOnExitPrefix.size() > 0 ) {
     auto overlayFileName = cSaveOnExitPrefix + ".overlay." + cOverlayImageExtension;
     saveOverlay( overlayFileName.toStdString() );
@@ -222,12 +296,52 @@ QtGlSliceView::~QtGlSliceView()
 void
 QtGlSliceView::
 setInputImage( ImageType * newImData )
+{
+  this->setInputImage( static_cast< ImageBaseType * >( newImData ) );
+}
+
+
+void
+QtGlSliceView::
+setInputImage( ImageBaseType * newImData )
 {
   if( !newImData )
     {
     return;
     }
 
+  // The image is kept in its own pixel type
+  std::unique_ptr< SliceVolumeBase > volume =
+    SliceVolumeBase::create( newImData );
+  if( !volume )
+    {
+    qWarning() << "Unsupported image pixel type.  Aborting SetImage().";
+    return;
+    }
+  this->setInputVolume( std::move( volume ) );
+}
+
+
+void
+QtGlSliceView::
+setInputVolume( std::unique_ptr< SliceVolumeBase > volume )
+{
+  this->setInputVolume( std::move( volume ),
+    std::unique_ptr< VolumeLoader >() );
+}
+
+
+void
+QtGlSliceView::
+setInputVolume( std::unique_ptr< SliceVolumeBase > volume,
+  std::unique_ptr< VolumeLoader > loader )
+{
+  if( !volume )
+    {
+    return;
+    }
+
+  ImageBaseType * newImData = volume->image();
   RegionType region = newImData->GetLargestPossibleRegion();
   if( region.GetNumberOfPixels() == 0 )
     {
@@ -237,8 +351,12 @@ setInputImage( ImageType * newImData )
   SizeType myImageSize = region.GetSize();
   if( cValidOverlayData )
     {
-    RegionType overlayRegion = cOverlayData->GetLargestPossibleRegion();
-    SizeType   overlaySize   = overlayRegion.GetSize();
+    SizeType overlaySize;
+    for ( int i=0; i<3; i++ )
+      {
+      overlaySize[i] = cLabelVolume ? cLabelVolume->dimSize()[i]
+        : cOverlayData->GetLargestPossibleRegion().GetSize()[i];
+      }
 
     for ( int i=0; i<3; i++ )
       {
@@ -250,22 +368,59 @@ setInputImage( ImageType * newImData )
       }
     }
 
-  cImData = newImData;
+  // The previous loader writes to the previous image
+  cLoadTimer->stop();
+  cVolumeLoader.reset();
+  this->stopStatistics();
+  this->invalidateImage();
+  cVolume = std::move( volume );
+  cVolumeLoader = std::move( loader );
+  cAutoWindow = false;
+  cImData = NULL;
   cDimSize[0] = myImageSize[0];
   cDimSize[1] = myImageSize[1];
   cDimSize[2] = myImageSize[2];
-  cSpacing[0] = cImData->GetSpacing()[0];
-  cSpacing[1] = cImData->GetSpacing()[1];
-  cSpacing[2] = cImData->GetSpacing()[2];
-
-  typedef MinimumMaximumImageCalculator<ImageType> CalculatorType;
-  CalculatorType::Pointer calculator = CalculatorType::New();
-
-  calculator->SetImage( cImData );
-  calculator->Compute();
-
-  cDataMin = calculator->GetMinimum();
-  cDataMax = calculator->GetMaximum();
+  cSpacing[0] = newImData->GetSpacing()[0];
+  cSpacing[1] = newImData->GetSpacing()[1];
+  cSpacing[2] = newImData->GetSpacing()[2];
+  this->updateBrickedVolume();
+
+  // One pass gives the range, the histogram the windowing paces are
+  //   taken from, the statistics other callers ask for, and whether the
+  //   pixels can be read through lookup tables. Until the image is
+  //   loaded, they are those of the slices loaded, and the zeros of the
+  //   others must not size the tables. Those of a mapped image are
+  //   computed on a thread, as the pass would read the whole file, and
+  //   are those of the center slice until then.
+  if( !this->isLoaded() )
+    {
+    cImageStatistics.clear();
+    cVolumeLoader->loadedSlices( cLoadedSlices );
+    cCachedLoadedSlices = cLoadedSlices;
+    cNumberOfLoadedSlices = cVolumeLoader->numberOfLoadedSlices();
+    for( int slice=0; slice < ( int )cLoadedSlices.size(); ++slice )
+      {
+      if( cLoadedSlices[slice] )
+        {
+        cVolume->addSliceStatistics( cImageStatistics, slice,
+          cRenderThreader );
+        }
+      }
+    cLoadTimer->start( LoadProgressInterval );
+    }
+  else if( cVolume->isMapped() )
+    {
+    cImageStatistics.clear();
+    cVolume->addSliceStatistics( cImageStatistics,
+      ( ( int )cDimSize[2] - 1 ) / 2, cRenderThreader );
+    this->startStatistics();
+    }
+  else
+    {
+    cVolume->computeStatistics( cImageStatistics, cRenderThreader );
+    cVolume->setPixelStatistics( cImageStatistics );
+    }
+  this->updateIntensityRange();
   this->setIWMin( cDataMin );
   this->setIWMax( cDataMax );
 
@@ -284,8 +439,6 @@ setInputImage( ImageType * newImData )
   cWinSizeY = cWinSizeX;
   cWinMaxY = static_cast<int>( cWinSizeY ) - 1;
 
-  cWinDataSizeX = cWinSizeX;
-  cWinDataSizeY = cWinSizeX;
 
   cFastMoveValue[0] = 1;
   cFastMoveValue[2] = (int)(cWinSizeX / 10);
@@ -295,30 +448,215 @@ setInputImage( ImageType * newImData )
     }
   cFastMoveValue[1] = cFastMoveValue[2] / 2;
 
-  cFastIWValue[0] = (double)((cDataMax-cDataMin) / 10240);
-  cFastIWValue[1] = (double)((cDataMax-cDataMin) / 1024);
-  cFastIWValue[2] = (double)((cDataMax-cDataMin) / 20);
+  // The window buffers are sized by update() to the slice extent
+  this->resizeWinBuffers( 0, 0 );
+  cValidImageLayer = false;
+  cValidOverlayLayer = false;
+  this->changeSlice( ( ( this->maxSliceNum() -1 )/2 ) );
+  this->updateGeometry();
+
+  cValidImData = true;
+
+  this->update();
+  emit imageChanged();
+}
+
+
+void
+QtGlSliceView::
+updateIntensityRange()
+{
+  cDataMin = cImageStatistics.minimum();
+  cDataMax = cImageStatistics.maximum();
+
+  // The paces follow the range of most pixels, so a few outliers do not
+  //   make them too coarse
+  double iwRange = cImageStatistics.percentile( 0.99 )
+    - cImageStatistics.percentile( 0.01 );
+  if( iwRange <= 0 )
+    {
+    iwRange = cDataMax - cDataMin;
+    }
+  cFastIWValue[0] = iwRange / 10240;
+  cFastIWValue[1] = iwRange / 1024;
+  cFastIWValue[2] = iwRange / 20;
+}
+
+
+bool
+QtGlSliceView::
+isLoading() const
+{
+  return cVolumeLoader && cVolumeLoader->isRunning();
+}
+
 
-  if( cWinImData != NULL )
+bool
+QtGlSliceView::
+isLoaded() const
+{
+  return !cVolumeLoader || cVolumeLoader->isComplete();
+}
+
+
+int
+QtGlSliceView::
+loadProgress() const
+{
+  if( !cVolumeLoader )
     {
-    delete [] cWinImData;
+    return 100;
     }
+  return ( int )( 100.0 * cVolumeLoader->numberOfLoadedSlices()
+    / std::max( cVolumeLoader->numberOfSlices(), 1 ) );
+}
 
-  cWinImData = new unsigned char[ cWinDataSizeX * cWinDataSizeY ];
 
-  if( cWinZBuffer != NULL )
+void
+QtGlSliceView::
+cancelLoading()
+{
+  if( cVolumeLoader )
     {
-    delete [] cWinZBuffer;
+    cVolumeLoader->cancel();
     }
+}
 
-  cWinZBuffer = new unsigned short[ cWinDataSizeX * cWinDataSizeY ];
-  this->changeSlice( ( ( this->maxSliceNum() -1 )/2 ) );
-  this->updateGeometry();
 
-  cValidImData = true;
+void
+QtGlSliceView::
+updateLoading()
+{
+  if( cStatisticsThread.joinable() && !cStatisticsRunning )
+    {
+    cStatisticsThread.join();
+    this->setImageStatistics( cScannedStatistics );
+    this->update();
+    }
+  if( !cVolumeLoader )
+    {
+    if( !cStatisticsThread.joinable() )
+      {
+      cLoadTimer->stop();
+      }
+    return;
+    }
+  // New slices replace their placeholders
+  const int numberOfLoadedSlices = cVolumeLoader->numberOfLoadedSlices();
+  const bool running = cVolumeLoader->isRunning();
+  if( numberOfLoadedSlices != cNumberOfLoadedSlices )
+    {
+    cNumberOfLoadedSlices = numberOfLoadedSlices;
+    this->invalidateLoadedSlices();
+    emit loadProgressChanged( this->loadProgress() );
+    }
+  if( running )
+    {
+    this->update();
+    return;
+    }
 
+  // Done, cancelled or failed: the slices loaded stay, and a complete
+  //   image gets the statistics, bricks and pyramid of a loaded one
+  cLoadTimer->stop();
+  if( cVolumeLoader->isComplete() )
+    {
+    cVolumeLoader.reset();
+    cImData = NULL;
+    ImageStatistics statistics;
+    cVolume->computeStatistics( statistics, cRenderThreader );
+    this->setImageStatistics( statistics );
+    this->updateBrickedVolume();
+    }
+  emit loadFinished( cVolumeLoader == nullptr );
   this->update();
-  emit imageChanged();
+}
+
+
+void
+QtGlSliceView::
+invalidateLoadedSlices()
+{
+  // The other slices stay cached, and the projections are not computed
+  //   until the image is loaded, so nothing else is rebuilt
+  std::vector< unsigned char > loaded;
+  cVolumeLoader->loadedSlices( loaded );
+  std::vector< unsigned char > arrived( loaded.size(), 0 );
+  for( size_t slice=0; slice < loaded.size(); ++slice )
+    {
+    arrived[slice] = loaded[slice] && !cCachedLoadedSlices[slice];
+    }
+  cCachedLoadedSlices.swap( loaded );
+  cSliceCache->removeSlices( arrived );
+  const SliceRenderRegion & region = cRenderedImageKey.region;
+  if( cValidImageLayer
+    && ( region.order[2] != 2 || arrived[region.slice] ) )
+    {
+    cValidImageLayer = false;
+    }
+}
+
+
+void
+QtGlSliceView::
+setImageStatistics( const ImageStatistics & statistics )
+{
+  const bool fullWindow = cIWMin == cDataMin && cIWMax == cDataMax;
+  const bool autoWindow = cAutoWindow && cIWMin == cAutoWindowRange[0]
+    && cIWMax == cAutoWindowRange[1];
+  // The prefetcher must be done before the range, and so the steps of
+  //   the gradient magnitudes, change
+  this->invalidateImage();
+  cImageStatistics = statistics;
+  cVolume->setPixelStatistics( cImageStatistics );
+  this->updateIntensityRange();
+  if( autoWindow )
+    {
+    this->autoWindow( cAutoWindowPercent[0], cAutoWindowPercent[1] );
+    }
+  else if( fullWindow )
+    {
+    this->setIWMin( cDataMin );
+    this->setIWMax( cDataMax );
+    }
+}
+
+
+void
+QtGlSliceView::
+startStatistics()
+{
+  cScannedStatistics.clear();
+  cStatisticsCancelled = false;
+  cStatisticsRunning = true;
+  const SliceVolumeBase * volume = cVolume.get();
+  cStatisticsThread = std::thread( [this, volume]()
+    {
+    // Slice by slice, so a new image stops it soon
+    itk::MultiThreaderBase::Pointer threader =
+      itk::MultiThreaderBase::New();
+    const int numberOfSlices = ( int )volume->dimSize()[2];
+    for( int slice=0; slice<numberOfSlices && !cStatisticsCancelled;
+      ++slice )
+      {
+      volume->addSliceStatistics( cScannedStatistics, slice, threader );
+      }
+    cStatisticsRunning = false;
+    } );
+  cLoadTimer->start( LoadProgressInterval );
+}
+
+
+void
+QtGlSliceView::
+stopStatistics()
+{
+  cStatisticsCancelled = true;
+  if( cStatisticsThread.joinable() )
+    {
+    cStatisticsThread.join();
+    }
+  cStatisticsRunning = false;
 }
 
 
@@ -326,6 +664,11 @@ const QtGlSliceView::ImagePointer &
 QtGlSliceView
 ::inputImage( void ) const
 {
+  // A copy of a partly loaded image would keep the slices not loaded
+  if( cImData.IsNull() && cVolume && this->isLoaded() )
+    {
+    cImData = cVolume->doubleImage();
+    }
   return cImData;
 }
 
@@ -338,29 +681,17 @@ QtGlSliceView
 
   SizeType newoverlay_size = newoverlay_region.GetSize();
 
-  RegionType cImData_region = cImData->GetLargestPossibleRegion();
-
-  SizeType cImData_size = cImData_region.GetSize();
-
-  if( !cValidImData || newoverlay_size[2]==cImData_size[2] )
+  if( !cValidImData || newoverlay_size[2]==cDimSize[2] )
     {
     cPrevOverlayData = cOverlayData;
     cOverlayData = newOverlayData;
+    cLabelVolume.reset();
+    cPrevLabelVolume.reset();
+    this->invalidateOverlay();
     cViewOverlayData  = true;
     cValidOverlayData = true;
-
-    if( cWinOverlayData != NULL )
-      {
-      delete [] cWinOverlayData;
-      }
-
-    cWinOverlayData = new unsigned char[ cWinDataSizeX * cWinDataSizeY * 4 ];
-
-    if( cWinZBuffer != NULL )
-      {
-      delete [] cWinZBuffer;
-      }
-    cWinZBuffer = new unsigned short[cWinDataSizeX * cWinDataSizeY * 4];
+    cValidImageLayer = false;
+    cValidOverlayLayer = false;
     emit validOverlayDataChanged( cValidOverlayData );
     update();
     }
@@ -397,6 +728,7 @@ void
 QtGlSliceView::setOverlayOpacity( double newOverlayOpacity )
 {
   cOverlayOpacity = qBound( 0., newOverlayOpacity, 1. );
+  cOverlayColorsModified = true;
   emit overlayOpacityChanged( cOverlayOpacity );
   update();
 }
@@ -408,6 +740,79 @@ QtGlSliceView::overlayOpacity( void ) const
   return cOverlayOpacity;
 }
 
+
+void
+QtGlSliceView::setLabelVisible( int label, bool visible )
+{
+  if( label < 1 || label > 255 )
+    {
+    return;
+    }
+  cLabelVisible[label] = visible;
+  cOverlayColorsModified = true;
+  update();
+}
+
+
+bool
+QtGlSliceView::labelVisible( int label ) const
+{
+  return label >= 1 && label <= 255 && cLabelVisible[label];
+}
+
+
+void
+QtGlSliceView::setLabelOpacity( int label, double opacity )
+{
+  if( label < 1 || label > 255 )
+    {
+    return;
+    }
+  cLabelOpacity[label] = qBound( 0., opacity, 1. );
+  cOverlayColorsModified = true;
+  update();
+}
+
+
+double
+QtGlSliceView::labelOpacity( int label ) const
+{
+  return ( label >= 1 && label <= 255 ) ? cLabelOpacity[label] : 0;
+}
+
+
+void
+QtGlSliceView::
+updateOverlayColors()
+{
+  if( !cOverlayColorsModified
+    && cColorTable->GetMTime() == cOverlayColorTableMTime )
+    {
+    return;
+    }
+  cOverlayColorsModified = false;
+  cOverlayColorTableMTime = cColorTable->GetMTime();
+  ++cOverlayColorsGeneration;
+
+  // Label m is drawn with color m-1 of the table, and label 0 is
+  //   transparent, as are hidden labels
+  cOverlayColors[0] = 0;
+  for( int m=1; m < 256; m++ )
+    {
+    unsigned char rgba[4] = { 0, 0, 0, 0 };
+    if( cLabelVisible[m] )
+      {
+      const ColorTableType::RGBPixelType color =
+        cColorTable->GetColor( m-1 );
+      rgba[0] = ( unsigned char )( color.GetRed()*255 );
+      rgba[1] = ( unsigned char )( color.GetGreen()*255 );
+      rgba[2] = ( unsigned char )( color.GetBlue()*255 );
+      rgba[3] = ( unsigned char )( cOverlayOpacity*cLabelOpacity[m]*255 );
+      }
+    memcpy( &( cOverlayColors[m] ), rgba, 4 );
+    }
+}
+
 void QtGlSliceView::setOverlayImageExtension(const char * ext )
 {
   cOverlayImageExtension = ext;
@@ -598,13 +1003,10 @@ void QtGlSliceView::saveCornerText( std::string fileName )
 }
 
 
-void
-QtGlSliceView::update()
+SliceRenderRegion
+QtGlSliceView::
+computeRenderRegion()
 {
-  if( !cValidImData )
-    {
-    return;
-    }
   cWinSizeX = ( int )( (cSpanMax / cWinZoom)
     / (cDimSize[cWinOrder[0]]*cSpacing[cWinOrder[0]])
     * cDimSize[cWinOrder[0]] );
@@ -643,266 +1045,670 @@ QtGlSliceView::update()
     cWinMaxY = cDimSize[ cWinOrder[1] ] + cWinSizeY;
     }
 
-  memset( cWinImData, 0, cWinDataSizeX*cWinDataSizeY );
-  if( cValidOverlayData )
+  SliceRenderRegion region;
+  for( int i=0; i<3; i++ )
+    {
+    region.order[i] = cWinOrder[i];
+    }
+  region.slice = cWinCenter[ cWinOrder[ 2 ] ];
+  region.imageMode = cImageMode;
+  region.slabThickness = imageModeIsSlab( cImageMode ) ? cSlabThickness : 0;
+
+  // Zoomed out, the window is rendered from a pyramid level
+  region.level = this->pyramidLevel();
+  const int lastX = ( ( int )cDimSize[cWinOrder[0]] - 1 ) >> region.level;
+  const int lastY = ( ( int )cDimSize[cWinOrder[1]] - 1 ) >> region.level;
+  const int minX = qBound( 0, cWinMinX, lastX << region.level )
+    >> region.level;
+  const int maxX = qBound( 0, cWinMaxX, lastX << region.level )
+    >> region.level;
+  const int minY = qBound( 0, cWinMinY, lastY << region.level )
+    >> region.level;
+  const int maxY = qBound( 0, cWinMaxY, lastY << region.level )
+    >> region.level;
+
+  // While the window stays in the rendered region, panning and zooming
+  //   only move it on the widget, and scrolling keeps the region of the
+  //   cached and prefetched slices
+  const SliceRenderRegion & rendered = cRenderedImageKey.region;
+  if( cValidImageLayer && rendered.order[0] == region.order[0]
+    && rendered.order[1] == region.order[1]
+    && rendered.level == region.level
+    && rendered.startX <= minX && maxX <= rendered.endX
+    && rendered.startY <= minY && maxY <= rendered.endY
+    && rendered.endX <= lastX && rendered.endY <= lastY )
+    {
+    region.startX = rendered.startX;
+    region.endX = rendered.endX;
+    region.startY = rendered.startY;
+    region.endY = rendered.endY;
+    return region;
+    }
+
+  // Otherwise the window is rendered with a margin of half its size on
+  //   each side, so the buffers scale with the widget rather than the
+  //   slice
+  const int marginX = ( maxX - minX + 1 ) / 2;
+  const int marginY = ( maxY - minY + 1 ) / 2;
+  region.startX = qMax( minX - marginX, 0 );
+  region.endX = qMin( maxX + marginX, lastX );
+  region.startY = qMax( minY - marginY, 0 );
+  region.endY = qMin( maxY + marginY, lastY );
+  return region;
+}
+
+
+int
+QtGlSliceView::
+pyramidLevel() const
+{
+  // The depth buffer of these modes holds slices of the image itself,
+  //   and the levels of an image still loading would be rebuilt as its
+  //   slices arrive
+  if( !cVolume || cMaxPyramidLevel <= 0 || imageModeHasDepth( cImageMode )
+    || imageModeIsSlab( cImageMode ) || !this->isLoaded() )
+    {
+    return 0;
+    }
+  // paintGL scales the larger widget side to cWinSizeX / cWinSizeY
+  //   voxels, so the level must not make a voxel larger than a pixel
+  const int sizeMax = qMax( this->width(), this->height() );
+  if( sizeMax <= 0 )
+    {
+    return 0;
+    }
+  const double voxelsPerPixel = qMin( cWinSizeX, cWinSizeY )
+    / ( double )sizeMax;
+  const int maxLevel = qMin( cMaxPyramidLevel, cVolume->maxPyramidLevel() );
+  int level = 0;
+  while( level < maxLevel && ( 2 << level ) <= voxelsPerPixel )
+    {
+    level++;
+    }
+  return level;
+}
+
+
+ImageLayerKey
+QtGlSliceView::
+imageLayerKey( const SliceRenderRegion & region ) const
+{
+  ImageLayerKey key;
+  key.region = region;
+  key.image = cVolume->image();
+  key.generation = cImageGeneration;
+  key.iwMin = cIWMin;
+  key.iwMax = cIWMax;
+  key.iwModeMin = cIWModeMin;
+  key.iwModeMax = cIWModeMax;
+  return key;
+}
+
+
+OverlayLayerKey
+QtGlSliceView::
+overlayLayerKey( const SliceRenderRegion & region ) const
+{
+  OverlayLayerKey key;
+  key.region = region;
+  key.overlay = cLabelVolume ? ( const void * )cLabelVolume.get()
+    : cOverlayData.GetPointer();
+  key.generation = cOverlayGeneration;
+  key.colors = cOverlayColorsGeneration;
+  key.imageLayer = imageModeHasDepth( region.imageMode )
+    ? cImageLayerRenderCount : 0;
+  return key;
+}
+
+
+void
+QtGlSliceView::
+invalidateImage()
+{
+  // The prefetcher must be done with the pixels before they change
+  cSlicePrefetcher->cancel();
+  cSlicePrefetcher->waitForIdle();
+  ++cImageGeneration;
+  // Cached slices and projections of the previous generation can never be
+  //   used again
+  cSliceCache->clear();
+  if( cVolume )
+    {
+    cVolume->clear();
+    }
+}
+
+
+void
+QtGlSliceView::
+invalidateOverlay()
+{
+  ++cOverlayGeneration;
+}
+
+
+void
+QtGlSliceView::update()
+{
+  if( !cValidImData )
+    {
+    return;
+    }
+  const SliceRenderRegion region = this->computeRenderRegion();
+  this->updateOverlayColors();
+  this->resizeWinBuffers( region.endX-region.startX+1,
+    region.endY-region.startY+1 );
+  cWinDataLevel = region.level;
+  cWinDataStartX = region.startX;
+  cWinDataStartY = region.startY;
+
+  // Only the layers whose inputs changed are recomputed; annotations are
+  //   drawn by paintGL, so changing them costs a repaint only
+  const ImageLayerKey imageKey = this->imageLayerKey( region );
+  const size_t numberOfWinPixels = cWinDataSizeX*cWinDataSizeY;
+  const bool imageKeyChanged = !cValidImageLayer
+    || imageKey != cRenderedImageKey;
+  bool renderImage = imageKeyChanged;
+
+  // Changing only the slice, by at most the fast move pace, is a scroll
+  int scrollStep = 0;
+  if( cValidImageLayer && imageKeyChanged )
+    {
+    ImageLayerKey previousKey = cRenderedImageKey;
+    previousKey.region.slice = imageKey.region.slice;
+    const int maxStep = qMax( cFastMoveValue[2], cFixedSliceMoveValue );
+    scrollStep = imageKey.region.slice - cRenderedImageKey.region.slice;
+    if( previousKey != imageKey || qAbs( scrollStep ) > maxStep )
+      {
+      scrollStep = 0;
+      }
+    }
+  if( renderImage )
+    {
+    ++cImageLayerRenderCount;
+    if( cSliceCache->fetch( imageKey, cWinImData, cWinZBuffer,
+        numberOfWinPixels ) )
+      {
+      cRenderedImageKey = imageKey;
+      cValidImageLayer = true;
+      renderImage = false;
+      }
+    }
+  // The buffers cover the rendered region exactly, so every pixel is
+  //   written and they need no clearing
+  const OverlayLayerKey overlayKey = this->overlayLayerKey( region );
+  const bool renderOverlay = cValidOverlayData && ( !cValidOverlayLayer
+    || overlayKey != cRenderedOverlayKey );
+
+  SliceReslicerBase * imageReslicer = cVolume->reslicer();
+  imageReslicer->setOrder( region.order );
+  imageReslicer->setSlice( region.slice );
+  imageReslicer->setImageMode( region.imageMode );
+  imageReslicer->setSlabThickness( region.slabThickness );
+  imageReslicer->setIntensityWindow( cIWMin, cIWMax, cIWModeMin,
+    cIWModeMax );
+  imageReslicer->update();
+  itk::MultiThreaderBase * projectionThreader =
+    cNumberOfRenderThreads > 1 ? cRenderThreader.GetPointer() : NULL;
+  // Zoomed out, the slice is taken from the pyramid level of the region;
+  //   the overlay is still sampled from the image through imageReslicer
+  SliceReslicerBase * reslicer = imageReslicer;
+  if( region.level > 0 )
+    {
+    reslicer = cVolume->levelReslicer( region.level, projectionThreader );
+    reslicer->setOrder( region.order );
+    reslicer->setSlice( region.slice >> region.level );
+    reslicer->setImageMode( region.imageMode );
+    reslicer->setIntensityWindow( cIWMin, cIWMax, cIWModeMin,
+      cIWModeMax );
+    reslicer->update();
+    }
+  // Until the image is loaded, the projections are placeholders, as they
+  //   would be rebuilt as every slice arrives
+  const bool projectionPending = !this->isLoaded()
+    && ( region.imageMode == IMG_MIP
+      || imageModeIsSlab( region.imageMode ) );
+
+  // The projection is computed once per axis; window changes and slice
+  //   moves only re-map it
+  if( renderImage && region.imageMode == IMG_MIP && !projectionPending )
+    {
+    cVolume->updateMip( region.order[2], projectionThreader );
+    }
+  // A slab slides along with the slice, so a scroll only reads the slices
+  //   entering it
+  if( renderImage && imageModeIsSlab( region.imageMode )
+    && !projectionPending )
+    {
+    cVolume->updateSlab( region.order, region.slice,
+      region.slabThickness, region.imageMode, region.startX, region.endX,
+      region.startY, region.endY, projectionThreader );
+    }
+  // The gradient magnitudes are computed in the background; until they
+  //   are ready, the rows compute their own
+  if( region.imageMode == IMG_GRAD && region.level == 0
+    && this->isLoaded() )
+    {
+    cVolume->requestGradient();
+    }
+
+  // Render the next slices in the scroll direction in the background, and
+  //   drop the pending ones when anything else changed. A MIP does not
+  //   depend on the slice, a slab is cheaper to slide than to prefetch,
+  //   and pyramid levels are cheap to render.
+  if( imageKeyChanged )
+    {
+    if( scrollStep != 0 && region.imageMode != IMG_MIP
+      && !imageModeIsSlab( region.imageMode ) && region.level == 0
+      && this->isLoaded() )
+      {
+      cSlicePrefetcher->prefetch( *imageReslicer, imageKey, scrollStep,
+        ( int )cDimSize[region.order[2]], cWinDataSizeX,
+        numberOfWinPixels );
+      }
+    else
+      {
+      cSlicePrefetcher->cancel();
+      }
+    }
+
+  // The pixels of the slices not loaded yet are replaced by
+  //   placeholders. The slices loaded are taken once, before reslicing.
+  const bool renderPlaceholders = renderImage && !this->isLoaded();
+  if( renderPlaceholders )
+    {
+    cVolumeLoader->loadedSlices( cLoadedSlices );
+    }
+
+  // Blocks of rows are independent, so they are split across the render
+  //   threads. A block is the tile height of the reslicer.
+  const int blockRows = SliceReslicerBase::TileRows;
+  auto renderBlock = [&]( itk::SizeValueType block )
+    {
+    const int startK = region.startY + ( int )block*blockRows;
+    const int endK = std::min( startK + blockRows - 1, region.endY );
+    const int rowOffset = ( startK-region.startY )*cWinDataSizeX;
+    if( renderImage )
+      {
+      if( !projectionPending )
+        {
+        reslicer->resliceRows( startK, endK, region.startX, region.endX,
+          &( cWinImData[rowOffset] ), &( cWinZBuffer[rowOffset] ),
+          cWinDataSizeX );
+        }
+      if( renderPlaceholders )
+        {
+        this->renderPlaceholderRows( region, startK, endK );
+        }
+      }
+    if( renderOverlay )
+      {
+      for( int k=startK; k <= endK; k++ )
+        {
+        this->renderOverlayRow( region, k, region.startX, region.endX );
+        }
+      }
+    };
+
+  const int numberOfRows = region.endY - region.startY + 1;
+  const int numberOfBlocks = ( numberOfRows + blockRows - 1 ) / blockRows;
+  if( renderImage || renderOverlay )
+    {
+    if( cNumberOfRenderThreads > 1 && numberOfBlocks > 1 )
+      {
+      cRenderThreader->ParallelizeArray( 0, numberOfBlocks, renderBlock,
+        nullptr );
+      }
+    else
+      {
+      for( int block=0; block < numberOfBlocks; block++ )
+        {
+        renderBlock( block );
+        }
+      }
+    }
+  if( renderImage )
+    {
+    cRenderedImageKey = imageKey;
+    cValidImageLayer = true;
+    cSliceCache->store( imageKey, cWinImData, cWinZBuffer,
+      numberOfWinPixels );
+    }
+  if( renderOverlay )
+    {
+    cRenderedOverlayKey = this->overlayLayerKey( region );
+    cValidOverlayLayer = true;
+    }
+  // Rendered or fetched from the cache, the layers must be uploaded
+  if( imageKeyChanged )
+    {
+    markDirtyRows( cImageTexture, 0, cWinDataSizeY-1 );
+    }
+  if( renderOverlay )
+    {
+    markDirtyRows( cOverlayTexture, 0, cWinDataSizeY-1 );
+    }
+
+  Superclass::update();
+}
+
+
+void
+QtGlSliceView::
+resizeWinBuffers( int sizeX, int sizeY )
+{
+  sizeX = std::max( sizeX, 0 );
+  sizeY = std::max( sizeY, 0 );
+  const size_t numberOfPixels = ( size_t )sizeX*sizeY;
+  if( sizeX != cWinDataSizeX || sizeY != cWinDataSizeY )
+    {
+    // Release before allocating, so a block can be handed back at once
+    cWinBufferPool->release( cWinImData );
+    cWinBufferPool->release( cWinZBuffer );
+    cWinBufferPool->release( cWinOverlayData );
+    cWinImData = NULL;
+    cWinZBuffer = NULL;
+    cWinOverlayData = NULL;
+    cWinDataSizeX = sizeX;
+    cWinDataSizeY = sizeY;
+    cValidImageLayer = false;
+    cValidOverlayLayer = false;
+    }
+  if( numberOfPixels == 0 )
+    {
+    return;
+    }
+  if( cWinImData == NULL )
+    {
+    cWinImData =
+      cWinBufferPool->allocate< unsigned char >( numberOfPixels );
+    cWinZBuffer =
+      cWinBufferPool->allocate< unsigned short >( numberOfPixels );
+    }
+  if( cValidOverlayData && cWinOverlayData == NULL )
+    {
+    cWinOverlayData =
+      cWinBufferPool->allocate< unsigned char >( numberOfPixels*4 );
+    cValidOverlayLayer = false;
+    }
+}
+
+
+void
+QtGlSliceView::
+renderOverlayRow( const SliceRenderRegion & region, int k, int startJ,
+  int endJ )
+{
+  // One table load and one 32-bit store per pixel
+  const unsigned int * colors = cOverlayColors;
+  const SliceReslicerBase * reslicer = cVolume->reslicer();
+  const int l = ( k-region.startY )*cWinDataSizeX + startJ-region.startX;
+  unsigned char * rgba = &( cWinOverlayData[l*4] );
+  if( cLabelVolume )
+    {
+    this->renderLabelVolumeRow( region, k, startJ, endJ, rgba );
+    return;
+    }
+  const OverlayPixelType * overlayBuffer = cOverlayData->GetBufferPointer();
+  if( imageModeHasDepth( region.imageMode ) )
+    {
+    const unsigned short * depth = &( cWinZBuffer[l] );
+    for( int j=startJ; j <= endJ; j++, rgba+=4 )
+      {
+      const OverlayPixelType m =
+        overlayBuffer[ reslicer->voxelOffset( j, k, depth[j-startJ] ) ];
+      memcpy( rgba, &( colors[m] ), 4 );
+      }
+    return;
+    }
+  // On a pyramid level, each pixel shows the label of the first voxel
+  //   of its block on the slice
+  const int level = region.level;
+  const long strideJ = reslicer->columnStride() << level;
+  const OverlayPixelType * p = overlayBuffer
+    + reslicer->voxelOffset( startJ << level, k << level, region.slice );
+  for( int j=startJ; j <= endJ; j++, rgba+=4, p+=strideJ )
+    {
+    memcpy( rgba, &( colors[*p] ), 4 );
+    }
+}
+
+
+void
+QtGlSliceView::
+renderPlaceholderRows( const SliceRenderRegion & region, int startK,
+  int endK )
+{
+  // An axial slice not loaded is a checkerboard; on the other views, so
+  //   are the rows or columns of the axial slices not loaded. A pending
+  //   projection is all checkerboard, at the depth of the slice.
+  const bool projection = region.imageMode == IMG_MIP
+    || imageModeIsSlab( region.imageMode );
+  if( !projection && region.order[2] == 2 && cLoadedSlices[region.slice] )
+    {
+    return;
+    }
+  const int level = region.level;
+  for( int k=startK; k <= endK; k++ )
+    {
+    unsigned char * row =
+      &( cWinImData[( k-region.startY )*cWinDataSizeX] );
+    if( projection )
+      {
+      for( int j=region.startX; j <= region.endX; j++ )
+        {
+        row[j-region.startX] = ( ( ( j ^ k ) >> 3 ) & 1 ) ? 96 : 64;
+        }
+      std::fill_n( &( cWinZBuffer[( k-region.startY )*cWinDataSizeX] ),
+        region.endX-region.startX+1, ( unsigned short )region.slice );
+      continue;
+      }
+    for( int j=region.startX; j <= region.endX; j++ )
+      {
+      int slice = region.slice;
+      if( region.order[0] == 2 )
+        {
+        slice = j << level;
+        }
+      else if( region.order[1] == 2 )
+        {
+        slice = k << level;
+        }
+      if( !cLoadedSlices[slice] )
+        {
+        row[j-region.startX] = ( ( ( j ^ k ) >> 3 ) & 1 ) ? 96 : 64;
+        }
+      }
+    }
+}
+
+
+void
+QtGlSliceView::
+renderLabelVolumeRow( const SliceRenderRegion & region, int k, int startJ,
+  int endJ, unsigned char * rgba )
+{
+  // The labels are looked up by index, brick by brick
+  const unsigned int * colors = cOverlayColors;
+  const int level = region.level;
+  const int * order = region.order;
+  const bool hasDepth = imageModeHasDepth( region.imageMode );
+  const unsigned short * depth = &( cWinZBuffer[( k-region.startY )
+    * cWinDataSizeX + startJ-region.startX] );
+  long index[3];
+  index[order[1]] = k << level;
+  index[order[2]] = region.slice;
+  for( int j=startJ; j <= endJ; j++, rgba+=4 )
+    {
+    index[order[0]] = j << level;
+    if( hasDepth )
+      {
+      index[order[2]] = depth[j-startJ];
+      }
+    const OverlayPixelType m =
+      cLabelVolume->value( index[0], index[1], index[2] );
+    memcpy( rgba, &( colors[m] ), 4 );
+    }
+}
+
+
+void
+QtGlSliceView::
+updateOverlayRegion( const int minIndex[3], const int maxIndex[3] )
+{
+  if( !cValidImData || !cValidOverlayData )
+    {
+    return;
+    }
+  // The overlay was edited, but only the box needs recoloring if the
+  //   window overlay is otherwise current
+  const SliceRenderRegion region = this->computeRenderRegion();
+  this->updateOverlayColors();
+  const bool current = cValidOverlayLayer
+    && this->overlayLayerKey( region ) == cRenderedOverlayKey
+    && cValidImageLayer
+    && this->imageLayerKey( region ) == cRenderedImageKey;
+  this->invalidateOverlay();
+  if( !current )
+    {
+    this->update();
+    return;
+    }
+
+  // With a depth buffer the overlay is sampled at the depth of each
+  //   pixel, so the whole column range of the box may change
+  if( imageModeHasDepth( region.imageMode )
+    || ( region.slice >= minIndex[region.order[2]]
+      && region.slice <= maxIndex[region.order[2]] ) )
+    {
+    const int level = region.level;
+    const int startJ = std::max( region.startX,
+      minIndex[region.order[0]] >> level );
+    const int endJ = std::min( region.endX,
+      maxIndex[region.order[0]] >> level );
+    const int startK = std::max( region.startY,
+      minIndex[region.order[1]] >> level );
+    const int endK = std::min( region.endY,
+      maxIndex[region.order[1]] >> level );
+    for( int k=startK; k <= endK; k++ )
+      {
+      this->renderOverlayRow( region, k, startJ, endJ );
+      }
+    markDirtyRows( cOverlayTexture, startK-region.startY,
+      endK-region.startY );
+    }
+  cRenderedOverlayKey = this->overlayLayerKey( region );
+
+  Superclass::update();
+}
+
+
+void
+QtGlSliceView::
+setNumberOfRenderThreads( unsigned int numberOfThreads )
+{
+  if( numberOfThreads == 0 )
     {
-    memset( cWinOverlayData, 0, cWinDataSizeX*cWinDataSizeY*4 );
+    numberOfThreads =
+      itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
     }
+  numberOfThreads = std::min( numberOfThreads, ( unsigned int )
+    itk::MultiThreaderBase::GetGlobalMaximumNumberOfThreads() );
+  cNumberOfRenderThreads = numberOfThreads;
+  cRenderThreader->SetMaximumNumberOfThreads( numberOfThreads );
+  cRenderThreader->SetNumberOfWorkUnits( numberOfThreads );
+}
+
+
+void
+QtGlSliceView::
+setSliceCacheSize( unsigned int megabytes )
+{
+  cSliceCache->setMemoryBudget( ( size_t )megabytes * 1024 * 1024 );
+}
+
+
+unsigned int
+QtGlSliceView::
+sliceCacheSize() const
+{
+  return ( unsigned int )( cSliceCache->memoryBudget() / ( 1024 * 1024 ) );
+}
 
-  IndexType ind;
 
-  int l, m;
+void
+QtGlSliceView::
+setNumberOfPrefetchSlices( unsigned int numberOfSlices )
+{
+  cSlicePrefetcher->setNumberOfSlices( numberOfSlices );
+}
+
+
+unsigned int
+QtGlSliceView::
+numberOfPrefetchSlices() const
+{
+  return cSlicePrefetcher->numberOfSlices();
+}
 
-  double tf;
 
-  ind[ cWinOrder[ 2 ] ] = cWinCenter[ cWinOrder[ 2 ] ];
-  int startK = cWinMinY;
-  if( startK<0 )
-    startK = 0;
-  int endK = cWinMaxY;
-  if( endK >= (int)(cDimSize[cWinOrder[1]]) )
+void
+QtGlSliceView::
+setBrickSize( unsigned int brickSize )
+{
+  if( ( brickSize & ( brickSize - 1 ) ) != 0 )
     {
-    endK = (int)(cDimSize[cWinOrder[1]])-1;
+    qWarning() << "Brick size" << brickSize
+      << "is not a power of two. Ignoring it.";
+    return;
     }
-  int startJ = cWinMinX;
-  if( startJ<0 )
-    startJ = 0;
-  int endJ = cWinMaxX;
-  if( endJ >= (int)(cDimSize[cWinOrder[0]]) )
+  if( brickSize == cBrickSize )
     {
-    endJ = (int)(cDimSize[cWinOrder[0]])-1;
+    return;
     }
-
-  for( int k=startK; k <= endK; k++ )
+  cBrickSize = brickSize;
+  // Both layouts render the same pixels, so the window is still current
+  if( cValidImData )
     {
-    ind[cWinOrder[1]] = k;
-
-    if( k-startK >= ( int )cWinDataSizeY )
-      {
-      continue;
-      }
-
-    for( int j=startJ; j <= endJ; j++ )
-      {
-      ind[cWinOrder[0]] = j;
-
-      if( j-startJ >= ( int )cWinDataSizeX )
-        {
-        continue;
-        }
+    this->updateBrickedVolume();
+    }
+}
 
-      switch( cImageMode )
-        {
-        default:
-        case IMG_VAL:
-          tf = ( double )( ( cImData->GetPixel( ind )-cIWMin )
-            / ( cIWMax-cIWMin )*255 );
-          break;
-        case IMG_INV:
-          tf = ( double )( ( cIWMax-cImData->GetPixel( ind ) )
-            / ( cIWMax-cIWMin )*255 );
-          break;
-        case IMG_LOG:
-          tf = ( double )( log(
-              cImData->GetPixel( ind ) - cIWMin + 0.00000001 )
-            / log( cIWMax-cIWMin+0.00000001 )*255 );
-          break;
-        case IMG_DX:
-          if( ind[0]>0 )
-            {
-            tf = ( double )( ( cImData->GetPixel( ind )-cIWMin )
-              / ( cIWMax-cIWMin )*255 );
-            ind[0]--;
-            tf -= ( double )( ( cImData->GetPixel( ind )-cIWMin )
-              / ( cIWMax-cIWMin )*255 );
-            ind[0]++;
-            tf += 128;
-            }
-          else
-            {
-            tf = 128;
-            }
-          break;
-        case IMG_DY:
-          if( ind[1]>0 )
-            {
-            tf = ( double )( ( cImData->GetPixel( ind )-cIWMin )
-              / ( cIWMax-cIWMin )*255 );
-            ind[1]--;
-            tf -= ( double )( ( cImData->GetPixel( ind )-cIWMin )
-              / ( cIWMax-cIWMin )*255 );
-            ind[1]++;
-            tf += 128;
-            }
-          else
-            {
-            tf = 128;
-            }
-          break;
-        case IMG_DZ:
-          if( ind[2]>0 )
-            {
-            tf = ( double )( ( cImData->GetPixel( ind )-cIWMin )
-              / ( cIWMax-cIWMin )*255 );
-            ind[2]--;
-            tf -= ( double )( ( cImData->GetPixel( ind )-cIWMin )
-              / ( cIWMax-cIWMin )*255 );
-            ind[2]++;
-            tf += 128;
-            }
-          else
-            {
-            tf = 128;
-            }
-          break;
-        case IMG_BLEND:
-          {
-          const int tempval = ( int )cWinCenter[cWinOrder[2]]-1;
-          int tmpI = ind[cWinOrder[2]];
-          ind[cWinOrder[2]] = ( tempval < 0 ) ? 0 : tempval;
-          tf = ( double )( cImData->GetPixel( ind ) );
 
-          ind[cWinOrder[2]] = cWinCenter[cWinOrder[2]];
-          tf += ( double )( cImData->GetPixel( ind ) )*2;
+size_t
+QtGlSliceView::
+brickedVolumeMemorySize() const
+{
+  return cVolume ? cVolume->brickedMemorySize() : 0;
+}
 
-          const int tempval1 = ( int )cDimSize[cWinOrder[2]]-1;
-          const int tempval2 = ( int )cWinCenter[cWinOrder[2]]+1;
-          ind[cWinOrder[2]] = ( tempval1 < tempval2 ) ? tempval1 : tempval2;
-          tf += ( double )( cImData->GetPixel( ind ) );
 
-          tf = ( double )( ( tf/4-cIWMin )/( cIWMax-cIWMin )*255 );
-          ind[cWinOrder[2]] = tmpI;
-          break;
-          }
-        case IMG_MIP:
-          tf = cIWMin;
-          m = ( j-startJ ) + ( k-startK )*cWinDataSizeX;
-          cWinZBuffer[m] = 0;
-          int tmpI = ind[cWinOrder[2]];
-          for( l=0; l<( int )cDimSize[cWinOrder[2]]; l++ )
-            {
-            ind[cWinOrder[2]] = l;
-            if( cImData->GetPixel( ind ) > tf )
-              {
-              tf = ( double )( cImData->GetPixel( ind ) );
-              cWinZBuffer[m] = ( unsigned short )l;
-              }
-            }
-          tf = ( double )( ( tf-cIWMin )/( cIWMax-cIWMin )*255 );
-          ind[cWinOrder[2]] = tmpI;
-          break;
-          }
+void
+QtGlSliceView::
+setSlabThickness( int thickness )
+{
+  cSlabThickness = std::max( thickness, 1 );
+}
 
-      if( tf > 255 )
-        {
-        switch( cIWModeMax )
-          {
-          case IW_MIN:
-            tf = 0;
-            break;
-          default:
-          case IW_MAX:
-            tf = 255;
-            break;
-          case IW_FLIP:
-            tf = 512-tf;
-            if( tf<0 )
-              {
-              tf = 0;
-              }
-            break;
-          }
-        }
-      else
-        {
-        if( tf < 0 )
-          {
-          switch( cIWModeMin )
-            {
-            default:
-            case IW_MIN:
-              tf = 0;
-              break;
-            case IW_MAX:
-              tf = 255;
-              break;
-            case IW_FLIP:
-              tf = -tf;
-              if( tf>255 )
-                {
-                tf = 255;
-                }
-              break;
-            }
-          }
-        }
 
-      l = ( j-startJ ) + ( k-startK )*cWinDataSizeX;
-      cWinImData[l] = ( unsigned char )tf;
+void
+QtGlSliceView::
+setMaxPyramidLevel( int level )
+{
+  cMaxPyramidLevel = qBound( 0, level,
+    ( int )ImagePyramid< ImagePixelType >::MaxLevel );
+}
 
-      if( cValidOverlayData )
-        {
-        l = l * 4;
-        if( cImageMode == IMG_MIP )
-          {
-          ind[cWinOrder[2]] = cWinZBuffer[( j-startJ ) +
-            ( k-startK )*cWinDataSizeX];
-          }
 
-        if( sizeof( OverlayPixelType ) == 1 )
-          {
-          m = ( int )*( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) );
-          if( m > 0 )
-            {
-            m = m - 1;
-            cWinOverlayData[l+0] =
-              ( unsigned char )( cColorTable->GetColor( m ).GetRed()*255 );
-            cWinOverlayData[l+1] =
-              ( unsigned char )( cColorTable->GetColor( m ).GetGreen()*255 );
-            cWinOverlayData[l+2] =
-              ( unsigned char )( cColorTable->GetColor( m ).GetBlue()*255 );
-            cWinOverlayData[l+3] =
-              ( unsigned char )( cOverlayOpacity*255 );
-            }
-          }
-        else
-          {
-          if( ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[0]
-            + ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[1]
-            + ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[2] > 0 )
-              {
-            if( sizeof( OverlayPixelType ) == 3 )
-              {
-              cWinOverlayData[l+0] =
-                ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[0];
-              cWinOverlayData[l+1] =
-                ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[1];
-              cWinOverlayData[l+2] =
-                ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[2];
-              cWinOverlayData[l+3] =
-                ( unsigned char )( cOverlayOpacity*255 );
-              }
-            else
-              {
-              if( sizeof( OverlayPixelType ) == 4 )
-                {
-                cWinOverlayData[l+0] =
-                  ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[0];
-                cWinOverlayData[l+1] =
-                  ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[1];
-                cWinOverlayData[l+2] =
-                  ( ( unsigned char * )&( cOverlayData->GetPixel( ind ) ) )[2];
-                cWinOverlayData[l+3] =
-                  ( unsigned char )( ( ( unsigned char * )
-                  &( cOverlayData->GetPixel( ind ) ) )[3]*cOverlayOpacity );
-                }
-              }
-            }
-          }
-        }
-      }
-    }
-  Superclass::update();
+void
+QtGlSliceView::
+updateBrickedVolume()
+{
+  // The prefetcher may be reading the volume being replaced
+  cSlicePrefetcher->cancel();
+  cSlicePrefetcher->waitForIdle();
+  // The bricks are copied once the image is loaded
+  cVolume->setBrickSize( this->isLoaded() ? cBrickSize : 0 );
 }
 
 
@@ -1006,6 +1812,7 @@ void QtGlSliceView::showHelp()
     str << QString("   < , - View the previous slice");
     str << QString("");
     str << QString("   r -reset all options");
+    str << QString("   Esc - Stop loading the image, keeping the slices loaded");
     str << QString("   h - help (this document)");
     str << QString("");
     str << QString("   x - Flip the x-axis");
@@ -1016,6 +1823,7 @@ void QtGlSliceView::showHelp()
     str << QString("");
     str << QString("   q w - Decrease, Increase the upper limit of the intensity windowing");
     str << QString("   e - Toggle between clipping and setting-to-black values above IW upper limit");
+    str << QString("   W - Window the intensities between the 1st and 99th percentiles");
     str << QString("   ");
     str << QString("   a s - Decrease, Increase the lower limit of the intensity windowing");
     str << QString("   d - Toggle between clipping and setting-to-white values below IW lower limit");
@@ -1045,8 +1853,11 @@ void QtGlSliceView::showHelp()
     str << QString("         - Derivative wrt x");
     str << QString("         - Derivative wrt y");
     str << QString("         - Derivative wrt z");
+    str << QString("         - Gradient magnitude");
     str << QString("         - Blend with previous and next slice");
     str << QString("         - MIP");
+    str << QString("         - Maximum, minimum and mean of a slab of slices");
+    str << QString("   ( ) - decrease / increase the slab thickness by 2 slices");
     str << QString("    ");
     str << QString("   \\ - cycle between mouse Modes: Select Points, Custom, Ruler, Box, Paint");
     str << QString("        - Default Custom is threshold connected components");
@@ -1411,11 +2222,29 @@ void QtGlSliceView::setOverlay( bool newOverlay )
 
 void QtGlSliceView::createOverlay( void )
 {
+  // A streamed image is labeled in a sparse volume, which holds the
+  //   bricks painted only
+  if( cVolume && cVolume->isStreamed() )
+    {
+    cPrevOverlayData = NULL;
+    cOverlayData = NULL;
+    cPrevLabelVolume.reset();
+    cLabelVolume.reset( new SparseLabelVolume( cDimSize ) );
+    this->invalidateOverlay();
+    cViewOverlayData  = true;
+    cValidOverlayData = true;
+    cValidImageLayer = false;
+    cValidOverlayLayer = false;
+    emit validOverlayDataChanged( cValidOverlayData );
+    update();
+    return;
+    }
+
   cPrevOverlayData = cOverlayData;
   cOverlayData = OverlayType::New();
 
-  cOverlayData->CopyInformation( cImData );
-  cOverlayData->SetRegions( cImData->GetLargestPossibleRegion() );
+  cOverlayData->CopyInformation( cVolume->image() );
+  cOverlayData->SetRegions( cVolume->image()->GetLargestPossibleRegion() );
   cOverlayData->Allocate();
   cOverlayData->FillBuffer( 0 );
 
@@ -1424,6 +2253,11 @@ void QtGlSliceView::createOverlay( void )
 
 void QtGlSliceView::interpolateOverlay (int start, int stop)
 {
+  if( cLabelVolume )
+    {
+    qWarning() << "The overlay of a streamed image cannot be interpolated.";
+    return;
+    }
   std::cout << "Interploating..." << std::endl;
   std::vector<itk::IndexValueType> indices;
   indices.push_back(start);
@@ -1435,6 +2269,7 @@ void QtGlSliceView::interpolateOverlay (int start, int stop)
   mci->Update();
   cPrevOverlayData = cOverlayData;
   cOverlayData = mci->GetOutput();
+  this->invalidateOverlay();
   std::cout << "...Done!" << std::endl;
 }
 
@@ -1547,7 +2382,15 @@ void QtGlSliceView::paintOverlayPoint( double x, double y, double z, std::string
         if( z2 + y2 + x2 <= r2 )
           {
           idx[0] = ix;
-          if( c == 0 || // allow eraser
+          if( cLabelVolume )
+            {
+            if( c == 0 || !cPreserveOverlayPaint
+                || cLabelVolume->value( ix, iy, iz ) == 0 )
+              {
+              cLabelVolume->setValue( ix, iy, iz, c );
+              }
+            }
+          else if( c == 0 || // allow eraser
               !cPreserveOverlayPaint || // no preserve
               cOverlayData->GetPixel( idx ) == 0 ) // preserve labeled pixels
             {
@@ -1557,7 +2400,10 @@ void QtGlSliceView::paintOverlayPoint( double x, double y, double z, std::string
         }
       }
     }
-  update();
+
+  const int minIndex[3] = { minX, minY, minZ };
+  const int maxIndex[3] = { maxX, maxY, maxZ };
+  this->updateOverlayRegion( minIndex, maxIndex );
 }
 
 void QtGlSliceView::saveOverlayWithPrompt( void )
@@ -1567,8 +2413,10 @@ void QtGlSliceView::saveOverlayWithPrompt( void )
     return;
     }
 
+  // Large overlays are only written slab by slab to MetaImage files
   QString fileName = QFileDialog::getSaveFileName( this,
-    "Please select a file name", "*.*", "" );
+    "Please select a file name", "*.*",
+    cLabelVolume ? "MetaImage (*.mha *.mhd)" : "" );
   if( fileName.isNull() )
     {
     return;
@@ -1584,7 +2432,19 @@ void QtGlSliceView::saveOverlay( std::string fileName )
     return;
     }
 
-  if( cOverlayData->GetLargestPossibleRegion().GetSize()[2] == 1 )
+  if( cLabelVolume )
+    {
+    try
+      {
+      cLabelVolume->write( fileName, cVolume->image() );
+      }
+    catch( itk::ExceptionObject & error )
+      {
+      qWarning() << "Failed to write" << fileName.c_str() << ":"
+        << error.GetDescription();
+      }
+    }
+  else if( cOverlayData->GetLargestPossibleRegion().GetSize()[2] == 1 )
     {
     typedef itk::Image<unsigned char, 2> Overlay2DType;
 
@@ -1605,6 +2465,16 @@ void QtGlSliceView::saveOverlay( std::string fileName )
     writer->SetUseCompression( true );
     writer->Update();
     }
+  else if( CompressedImageWriter::canWrite( fileName ) )
+    {
+    // Compressed in chunks on the render threads, and inflated the same
+    //   way when loaded back
+    if( !CompressedImageWriter::write( fileName,
+      cOverlayData.GetPointer(), cRenderThreader ) )
+      {
+      qWarning() << "Failed to write" << fileName.c_str();
+      }
+    }
   else
     {
     typedef itk::ImageFileWriter< OverlayType > WriterType;
@@ -1687,6 +2557,9 @@ void QtGlSliceView::keyPressEvent(QKeyEvent* keyEvent)
     }
   switch (keyEvent->key())
     {
+    case Qt::Key_Escape:
+      cancelLoading();
+      break;
     case Qt::Key_0:
       setOrientation(X_AXIS);
       transpose(true);
@@ -1926,12 +2799,20 @@ void QtGlSliceView::keyPressEvent(QKeyEvent* keyEvent)
         }
       else if (keyEvent->modifiers() & Qt::ShiftModifier)
         {
-        if( cPrevOverlayData.IsNotNull() )
+        if( cPrevLabelVolume )
+          {
+          std::cout << "Undo." << std::endl;
+          std::swap( cLabelVolume, cPrevLabelVolume );
+          this->invalidateOverlay();
+          update();
+          }
+        else if( cPrevOverlayData.IsNotNull() )
           {
           std::cout << "Undo." << std::endl;
           OverlayPointer tmpOverlayData = cOverlayData;
           cOverlayData = cPrevOverlayData;
           cPrevOverlayData = tmpOverlayData;
+          this->invalidateOverlay();
           update();
           }
         }
@@ -1965,6 +2846,10 @@ void QtGlSliceView::keyPressEvent(QKeyEvent* keyEvent)
           update();
           break;
         case IMG_DZ:
+          setImageMode( IMG_GRAD );
+          update();
+          break;
+        case IMG_GRAD:
           setImageMode( IMG_BLEND );
           update();
           break;
@@ -1973,11 +2858,34 @@ void QtGlSliceView::keyPressEvent(QKeyEvent* keyEvent)
           update();
           break;
         case IMG_MIP:
+          setImageMode( IMG_SLAB_MAX );
+          update();
+          break;
+        case IMG_SLAB_MAX:
+          setImageMode( IMG_SLAB_MIN );
+          update();
+          break;
+        case IMG_SLAB_MIN:
+          setImageMode( IMG_SLAB_MEAN );
+          update();
+          break;
+        case IMG_SLAB_MEAN:
           setImageMode( IMG_VAL );
           update();
           break;
         }
       break;
+    case Qt::Key_ParenRight:
+      setSlabThickness( slabThickness() + 2 );
+      update();
+      break;
+    case Qt::Key_ParenLeft:
+      if( slabThickness() > 1 )
+        {
+        setSlabThickness( slabThickness() - 2 );
+        update();
+        }
+      break;
     case Qt::Key_F:
       if( ++cFastPace > 2 )
         {
@@ -1990,8 +2898,15 @@ void QtGlSliceView::keyPressEvent(QKeyEvent* keyEvent)
       update();
       break;
     case Qt::Key_W:
-      iwPace = cFastIWValue[ cFastPace ];
-      setIWMax( iwMax()+iwPace );
+      if( keyEvent->modifiers() & Qt::ShiftModifier )
+        {
+        autoWindow();
+        }
+      else
+        {
+        iwPace = cFastIWValue[ cFastPace ];
+        setIWMax( iwMax()+iwPace );
+        }
       update();
       break;
     case ( Qt::Key_A ):
@@ -2255,6 +3170,165 @@ void QtGlSliceView::initializeGL()
   glClearColor( 0.0, 0.0, 0.0, 0.0 );
   glShadeModel( GL_FLAT );
   glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+  // Larger window buffers are drawn in tiles
+  GLint maxTextureSize = 0;
+  glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTextureSize );
+  cMaxTextureSize = std::max( ( int )maxTextureSize, 64 );
+  // A new context has none of the textures of a previous one
+  for( WinTexture * texture : { &cImageTexture, &cOverlayTexture } )
+    {
+    texture->ids.clear();
+    texture->sizeX = 0;
+    texture->sizeY = 0;
+    texture->tileSize = 0;
+    }
+}
+
+
+void
+QtGlSliceView::
+markDirtyRows( WinTexture & texture, int startRow, int endRow )
+{
+  if( startRow > endRow )
+    {
+    return;
+    }
+  if( texture.dirtyStartRow > texture.dirtyEndRow )
+    {
+    texture.dirtyStartRow = startRow;
+    texture.dirtyEndRow = endRow;
+    }
+  else
+    {
+    texture.dirtyStartRow = std::min( texture.dirtyStartRow, startRow );
+    texture.dirtyEndRow = std::max( texture.dirtyEndRow, endRow );
+    }
+}
+
+
+void
+QtGlSliceView::
+uploadWinTexture( WinTexture & texture, GLenum format, int bytesPerPixel,
+  const unsigned char * data )
+{
+  // A buffer wider or taller than the largest texture GL takes would be
+  //   drawn black, so it is split in tiles
+  const int tileSize = cMaxTextureSize;
+  const int tilesX = ( cWinDataSizeX + tileSize - 1 ) / tileSize;
+  const int tilesY = ( cWinDataSizeY + tileSize - 1 ) / tileSize;
+  int startRow = 0;
+  int endRow = -1;
+  if( texture.sizeX != cWinDataSizeX || texture.sizeY != cWinDataSizeY
+    || texture.tileSize != tileSize )
+    {
+    if( !texture.ids.empty() )
+      {
+      glDeleteTextures( ( GLsizei )texture.ids.size(), texture.ids.data() );
+      }
+    texture.ids.assign( tilesX*tilesY, 0 );
+    glGenTextures( ( GLsizei )texture.ids.size(), texture.ids.data() );
+    for( int tile=0; tile<tilesX*tilesY; ++tile )
+      {
+      const int tileX = tile % tilesX;
+      const int tileY = tile / tilesX;
+      glBindTexture( GL_TEXTURE_2D, texture.ids[tile] );
+      // Nearest sampling replicates the buffer pixels as glPixelZoom
+      //   does
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+      glTexImage2D( GL_TEXTURE_2D, 0, format,
+        std::min( tileSize, cWinDataSizeX - tileX*tileSize ),
+        std::min( tileSize, cWinDataSizeY - tileY*tileSize ), 0, format,
+        GL_UNSIGNED_BYTE, NULL );
+      }
+    texture.sizeX = cWinDataSizeX;
+    texture.sizeY = cWinDataSizeY;
+    texture.tileSize = tileSize;
+    endRow = cWinDataSizeY-1;
+    }
+  else if( texture.dirtyStartRow <= texture.dirtyEndRow )
+    {
+    startRow = std::max( texture.dirtyStartRow, 0 );
+    endRow = std::min( texture.dirtyEndRow, cWinDataSizeY-1 );
+    }
+  texture.dirtyStartRow = 0;
+  texture.dirtyEndRow = -1;
+  if( startRow > endRow )
+    {
+    return;
+    }
+
+  // The tiles read their columns of the buffer rows. QPainter may change
+  //   the unpack state while drawing the text.
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, cWinDataSizeX );
+  const size_t rowBytes = ( size_t )cWinDataSizeX*bytesPerPixel;
+  for( int tileY=startRow / tileSize; tileY<=endRow / tileSize; ++tileY )
+    {
+    const int tileStartRow = std::max( startRow, tileY*tileSize );
+    const int tileEndRow = std::min( endRow, ( tileY+1 )*tileSize - 1 );
+    for( int tileX=0; tileX<tilesX; ++tileX )
+      {
+      const int tileStartX = tileX*tileSize;
+      glBindTexture( GL_TEXTURE_2D, texture.ids[tileY*tilesX + tileX] );
+      glTexSubImage2D( GL_TEXTURE_2D, 0, 0, tileStartRow - tileY*tileSize,
+        std::min( tileSize, cWinDataSizeX - tileStartX ),
+        tileEndRow-tileStartRow+1, format, GL_UNSIGNED_BYTE,
+        data + tileStartRow*rowBytes + ( size_t )tileStartX*bytesPerPixel );
+      }
+    }
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+  cUploadedBytes += rowBytes*( endRow-startRow+1 );
+}
+
+
+void
+QtGlSliceView::
+drawWinTexture( const WinTexture & texture, double x0, double y0,
+  double x1, double y1, double extentX, double extentY )
+{
+  if( texture.ids.empty() )
+    {
+    return;
+    }
+  glEnable( GL_TEXTURE_2D );
+  glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE );
+  // Each tile covers its share of the quad, cut at the extent
+  const int tileSize = texture.tileSize;
+  const int tilesX = ( texture.sizeX + tileSize - 1 ) / tileSize;
+  for( int tile=0; tile<( int )texture.ids.size(); ++tile )
+    {
+    const int startX = ( tile % tilesX )*tileSize;
+    const int startY = ( tile / tilesX )*tileSize;
+    const int sizeX = std::min( tileSize, texture.sizeX - startX );
+    const int sizeY = std::min( tileSize, texture.sizeY - startY );
+    const double endX = std::min( ( double )( startX + sizeX ), extentX );
+    const double endY = std::min( ( double )( startY + sizeY ), extentY );
+    if( endX <= startX || endY <= startY )
+      {
+      continue;
+      }
+    const double u1 = ( endX - startX ) / sizeX;
+    const double v1 = ( endY - startY ) / sizeY;
+    const double tileX0 = x0 + ( x1-x0 )*startX / extentX;
+    const double tileX1 = x0 + ( x1-x0 )*endX / extentX;
+    const double tileY0 = y0 + ( y1-y0 )*startY / extentY;
+    const double tileY1 = y0 + ( y1-y0 )*endY / extentY;
+    glBindTexture( GL_TEXTURE_2D, texture.ids[tile] );
+    glBegin( GL_QUADS );
+    glTexCoord2f( 0, 0 );
+    glVertex2d( tileX0, tileY0 );
+    glTexCoord2f( u1, 0 );
+    glVertex2d( tileX1, tileY0 );
+    glTexCoord2f( u1, v1 );
+    glVertex2d( tileX1, tileY1 );
+    glTexCoord2f( 0, v1 );
+    glVertex2d( tileX0, tileY1 );
+    glEnd();
+    }
+  glDisable( GL_TEXTURE_2D );
 }
 
 /** Draw */
@@ -2276,7 +3350,7 @@ void QtGlSliceView::paintGL( void )
   widgetFont.setPointSize(10);
   QFontMetrics widgetFontMetric( widgetFont );
 
-  if( !cImData )
+  if( !cVolume )
     {
     return;
     }
@@ -2295,27 +3369,49 @@ void QtGlSliceView::paintGL( void )
     originY = 0;
     }
 
-  glRasterPos2i( ( isXFlipped() )?width()-originX:originX,
-     ( isYFlipped() )?height()-originY:originY );
-
-  glPixelZoom( ( isXFlipped() )?-scale0:scale0,
-     ( isYFlipped() )?-scale1:scale1 );
-
-  if( cValidImData && cViewImData )
+  // The window buffers hold the rendered region and are drawn as
+  //   textured quads from the widget position of its first voxel, which
+  //   may be off the widget. A buffer pixel of pyramid level l covers 2^l
+  //   voxels, but the last ones of a slice row or column only cover the
+  //   voxels left, so the region spans extentX by extentY pixels.
+  const double pixelZoom0 = scale0 * ( 1 << cWinDataLevel );
+  const double pixelZoom1 = scale1 * ( 1 << cWinDataLevel );
+  const double extentX = std::min( ( double )cWinDataSizeX,
+    std::ldexp( ( double )cDimSize[cWinOrder[0]], -cWinDataLevel )
+    - cWinDataStartX );
+  const double extentY = std::min( ( double )cWinDataSizeY,
+    std::ldexp( ( double )cDimSize[cWinOrder[1]], -cWinDataLevel )
+    - cWinDataStartY );
+  const double regionX = ( ( cWinDataStartX << cWinDataLevel ) - cWinMinX )
+    * scale0;
+  const double regionY = ( ( cWinDataStartY << cWinDataLevel ) - cWinMinY )
+    * scale1;
+  const double x0 = ( isXFlipped() )?width()-regionX:regionX;
+  const double y0 = ( isYFlipped() )?height()-regionY:regionY;
+  const double x1 = x0 + ( ( isXFlipped() )?-pixelZoom0:pixelZoom0 )
+    * extentX;
+  const double y1 = y0 + ( ( isYFlipped() )?-pixelZoom1:pixelZoom1 )
+    * extentY;
+  cUploadedBytes = 0;
+
+  if( cValidImData && cViewImData && cWinImData != NULL )
     {
-    glDrawPixels( cWinDataSizeX, cWinDataSizeY,
-                  GL_LUMINANCE, GL_UNSIGNED_BYTE,
-                  cWinImData );
+    this->uploadWinTexture( cImageTexture, GL_LUMINANCE, 1, cWinImData );
+    this->drawWinTexture( cImageTexture, x0, y0, x1, y1, extentX,
+      extentY );
     }
 
-  if( cValidOverlayData && viewOverlayData() )
+  if( cValidOverlayData && viewOverlayData() && cWinOverlayData != NULL )
     {
+    this->uploadWinTexture( cOverlayTexture, GL_RGBA, 4,
+      cWinOverlayData );
     glEnable( GL_BLEND );
     glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-    glDrawPixels( cWinDataSizeX, cWinDataSizeY, GL_RGBA,
-       GL_UNSIGNED_BYTE, cWinOverlayData );
+    this->drawWinTexture( cOverlayTexture, x0, y0, x1, y1, extentX,
+      extentY );
     glDisable( GL_BLEND );
     }
+  cTotalUploadedBytes += cUploadedBytes;
 
   if( viewClickedPoints() )
     {
@@ -2599,14 +3695,14 @@ void QtGlSliceView::paintGL( void )
         this->cClickSelect[2] );
 
       ImageType::PointType pnt;
-      cImData->TransformIndexToPhysicalPoint( index, pnt );
+      cVolume->image()->TransformIndexToPhysicalPoint( index, pnt );
       px = pnt[0];
       py = pnt[1];
       pz = pnt[2];
 
       suffix = this->cPhysicalUnitsName;
       }
-    if( ( ImagePixelType )1.5==1.5 )
+    if( !cVolume->isInteger() )
       {
       sprintf( s, "( %0.1f%s,  %0.1f%s,  %0.1f%s ) = %0.3f",
               px, suffix,
@@ -2668,6 +3764,9 @@ void QtGlSliceView::paintGL( void )
     .arg( IWModeTypeName[this->cIWModeMax] );
   details << QString( "View Mode: %1" ).arg(
     ImageModeTypeName[this->cImageMode] );
+  details << QString( "Uploaded: %1 KB ( %2 MB total )" )
+    .arg( this->uploadedBytes() / 1024 )
+    .arg( this->totalUploadedBytes() / ( 1024*1024 ) );
 
   if( this->cDisplayState & 0x01 )
     {
@@ -2675,7 +3774,7 @@ void QtGlSliceView::paintGL( void )
     glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
     glColor4f( 0.9, 0.4, 0.1, ( double )0.75 );
 
-    int i = 6;
+    int i = details.size();
     foreach( QString text, details )
       {
       int posX = widgetFontMetric.horizontalAdvance("00");
@@ -2695,6 +3794,17 @@ void QtGlSliceView::paintGL( void )
     this->renderText( posX, posY, cMessage, widgetFont );
     }
 
+  if( !this->isLoaded() )
+    {
+    const QString progress = this->isLoading()
+      ? QString( "Loading %1% (Esc cancels)" ).arg( this->loadProgress() )
+      : QString( "Loaded %1% of the slices" ).arg( this->loadProgress() );
+    int posX = ( width()/2 )
+      - ( widgetFontMetric.horizontalAdvance( progress )/2 );
+    int posY = height() - ( 2 * ( widgetFontMetric.height() + 1 ) );
+    this->renderText( posX, posY, progress, widgetFont );
+    }
+
   if( viewCrosshairs()
     && static_cast<int>( cClickSelect[cWinOrder[2]] ) ==
        static_cast<int>( sliceNum() ) )
@@ -2811,14 +3921,19 @@ QtGlSliceView::PointType3D QtGlSliceView::screenPointToIndex(double x, double y)
       {
       p[cWinOrder[1]] = cWinMaxY;
       }
-    if (imageMode() != IMG_MIP)
+    // The window buffers start at the first voxel of the rendered region,
+    //   and the depth modes are never rendered from a pyramid level
+    const int bufferX = (int)p[cWinOrder[0]] - cWinDataStartX;
+    const int bufferY = (int)p[cWinOrder[1]] - cWinDataStartY;
+    if (!imageModeHasDepth(imageMode()) || cWinZBuffer == NULL
+      || bufferX < 0 || bufferX >= cWinDataSizeX
+      || bufferY < 0 || bufferY >= cWinDataSizeY)
       {
       p[cWinOrder[2]] = cWinCenter[cWinOrder[2]];
       }
     else
       {
-      p[cWinOrder[2]] = cWinZBuffer[(int)p[cWinOrder[0]] - cWinMinX
-        + ((int)p[cWinOrder[1]] - cWinMinY) * cWinDataSizeX];
+      p[cWinOrder[2]] = cWinZBuffer[bufferX + bufferY * cWinDataSizeX];
       }
 
   return PointType3D(p);
@@ -2831,13 +3946,13 @@ QtGlSliceView::PointType3D QtGlSliceView::indexToPhysicalPoint(const PointType3D
   idx.SetElement(1, indexPoint[1]);
   idx.SetElement(2, indexPoint[2]);
   PointType3D ans{ };
-  this->cImData->TransformContinuousIndexToPhysicalPoint(idx, ans);
+  this->cVolume->image()->TransformContinuousIndexToPhysicalPoint(idx, ans);
   return ans;
 }
 
 void QtGlSliceView::mouseSelectEvent( QMouseEvent* mouseEvent )
 {
-  if( !cImData )
+  if( !cVolume )
     {
     return;
     }
@@ -2872,7 +3987,15 @@ void QtGlSliceView::mouseSelectEvent( QMouseEvent* mouseEvent )
       getBoxToolCollection()->handleMouseEvent(mouseEvent, p);
       }
     }
-  this->update();
+  if( cClickMode == CM_PAINT3D || cClickMode == CM_PAINT2D )
+    {
+    // paintOverlayPoint() only refreshed the painted region
+    Superclass::update();
+    }
+  else
+    {
+    this->update();
+    }
 }
 
 /** catches the mouse press to react appropriate
@@ -2886,11 +4009,18 @@ void QtGlSliceView::mousePressEvent( QMouseEvent* mouseEvent )
         cClickMode == CM_CUSTOM )
       {
       std::cout << "Saving overlay for potential undo." << std::endl;
-      using DuplicatorType = itk::ImageDuplicator<OverlayType>;
-      DuplicatorType::Pointer duplicator = DuplicatorType::New();
-      duplicator->SetInputImage(cOverlayData);
-      duplicator->Update();
-      cPrevOverlayData = duplicator->GetOutput();
+      if( cLabelVolume )
+        {
+        cPrevLabelVolume.reset( new SparseLabelVolume( *cLabelVolume ) );
+        }
+      else
+        {
+        using DuplicatorType = itk::ImageDuplicator<OverlayType>;
+        DuplicatorType::Pointer duplicator = DuplicatorType::New();
+        duplicator->SetInputImage(cOverlayData);
+        duplicator->Update();
+        cPrevOverlayData = duplicator->GetOutput();
+        }
       }
     cSelectMovement = SM_PRESS;
     this->mouseSelectEvent( mouseEvent );
@@ -2987,7 +4117,7 @@ void QtGlSliceView::selectPoint( double newX, double newY, double newZ )
   ind[0] = ( unsigned long )cClickSelect[0];
   ind[1] = ( unsigned long )cClickSelect[1];
   ind[2] = ( unsigned long )cClickSelect[2];
-  cClickSelectV = cImData->GetPixel( ind );
+  cClickSelectV = cVolume->value( ind );
 
   /*if length of list is equal to max, remove the earliest point stored */
   if( ( cMaxClickPoints>0 )&&( cClickedPoints.size() == cMaxClickPoints ) )
@@ -3038,6 +4168,22 @@ double QtGlSliceView::fastIWValue() const
 }
 
 
+void QtGlSliceView::autoWindow( double lowerPercent, double upperPercent )
+{
+  const double lower = cImageStatistics.percentile( lowerPercent / 100 );
+  const double upper = cImageStatistics.percentile( upperPercent / 100 );
+  this->setIWMin( lower );
+  this->setIWMax( upper );
+  // The statistics of an image loading or mapped are partial until
+  //   setImageStatistics() gets those of every pixel
+  cAutoWindow = true;
+  cAutoWindowPercent[0] = lowerPercent;
+  cAutoWindowPercent[1] = upperPercent;
+  cAutoWindowRange[0] = cIWMin;
+  cAutoWindowRange[1] = cIWMax;
+}
+
+
 bool QtGlSliceView::viewAxisLabel() const
 {
   return cViewAxisLabel;
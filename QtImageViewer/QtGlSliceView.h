@@ -33,13 +33,17 @@ limitations under the License.
 #include "itkImage.h"
 #include "itkColorTable.h"
 #include "itkMorphologicalContourInterpolator.h"
+#include "itkMultiThreaderBase.h"
 
 // ImageViewer includes
 #include "QtImageViewer_Export.h"
 #include "RulerWidget.h"
 #include "BoxWidget.h"
+#include "ImageStatistics.h"
 
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <unordered_map>
 
 class RulerToolCollection;
@@ -48,6 +52,13 @@ class ONSDMetaDataGenerator;
 class RainbowMetaDataGenerator;
 class RulerToolMetaDataFactory;
 class BoxToolMetaDataFactory;
+class SliceVolumeBase;
+class RenderBufferPool;
+class SliceCache;
+class SlicePrefetcher;
+class SparseLabelVolume;
+class VolumeLoader;
+class QTimer;
 struct RulerToolMetaData;
 
 using namespace itk;
@@ -78,18 +89,37 @@ typedef enum {SM_PRESS, SM_MOVE, SM_RELEASE} SelectMovementType;
 *  IW_MAX = set values outside range to max value
 *  IW_FLIP = rescale values to be within range by flipping
 */
-const int NUM_ImageModeTypes = 8;
+const int NUM_ImageModeTypes = 12;
 typedef enum {IMG_VAL, IMG_INV, IMG_LOG, IMG_DX, IMG_DY, IMG_DZ,
-  IMG_BLEND, IMG_MIP} ImageModeType;
-const char ImageModeTypeName[8][8] =
-  {{'V', 'a', 'l', 'u', 'e', '\0', ' ', ' '},
-  {'I', 'n', 'v', 'e', 'r', 's', 'e', '\0'},
-  {'L', 'o', 'g', '\0', ' ', ' ', ' ', ' '},
-  {'D', 'e', 'r', 'i', 'v', '-', 'X', '\0'},
-  {'D', 'e', 'r', 'i', 'v', '-', 'Y', '\0'},
-  {'D', 'e', 'r', 'i', 'v', '-', 'Z', '\0'},
-  {'B', 'l', 'e', 'n', 'd', '\0', ' ', ' '},
-  {'M', 'I', 'P', '\0', ' ', ' ', ' ', ' '}};
+  IMG_BLEND, IMG_MIP, IMG_SLAB_MAX, IMG_SLAB_MIN,
+  IMG_SLAB_MEAN, IMG_GRAD} ImageModeType;
+const char ImageModeTypeName[12][9] =
+  {{'V', 'a', 'l', 'u', 'e', '\0', ' ', ' ', ' '},
+  {'I', 'n', 'v', 'e', 'r', 's', 'e', '\0', ' '},
+  {'L', 'o', 'g', '\0', ' ', ' ', ' ', ' ', ' '},
+  {'D', 'e', 'r', 'i', 'v', '-', 'X', '\0', ' '},
+  {'D', 'e', 'r', 'i', 'v', '-', 'Y', '\0', ' '},
+  {'D', 'e', 'r', 'i', 'v', '-', 'Z', '\0', ' '},
+  {'B', 'l', 'e', 'n', 'd', '\0', ' ', ' ', ' '},
+  {'M', 'I', 'P', '\0', ' ', ' ', ' ', ' ', ' '},
+  {'S', 'l', 'a', 'b', 'M', 'a', 'x', '\0', ' '},
+  {'S', 'l', 'a', 'b', 'M', 'i', 'n', '\0', ' '},
+  {'S', 'l', 'a', 'b', 'M', 'e', 'a', 'n', '\0'},
+  {'G', 'r', 'a', 'd', 'i', 'e', 'n', 't', '\0'}};
+
+/*! True for the modes that project several slices: each window pixel
+*   then comes from the slice kept in the window depth buffer */
+inline bool imageModeHasDepth( ImageModeType mode )
+  {
+  return mode == IMG_MIP || mode == IMG_SLAB_MAX || mode == IMG_SLAB_MIN;
+  }
+
+/*! True for the thick-slab projection modes */
+inline bool imageModeIsSlab( ImageModeType mode )
+  {
+  return mode == IMG_SLAB_MAX || mode == IMG_SLAB_MIN
+    || mode == IMG_SLAB_MEAN;
+  }
 
 const int NUM_IWModeTypes = 3;
 typedef enum {IW_MIN, IW_MAX, IW_FLIP} IWModeType;
@@ -118,6 +148,90 @@ struct ClickPoint
   //double operator[](int index){return }
   };
 
+/*! Structure SliceRenderRegion to store the part of the image held by the
+* window buffers: the image axes along window x, window y and the slice
+* direction, the slice, the image mode, the slab thickness of the slab
+* modes (0 otherwise), the image pyramid level rendered, and the x / y
+* range of the slice, in voxels of that level. The region spans the
+* window and a margin around it, and is kept while the window stays in
+* it, so panning and zooming within a level do not change the region.
+*/
+struct SliceRenderRegion
+  {
+  int order[3];
+  int slice;
+  ImageModeType imageMode;
+  int slabThickness;
+  int level;
+  int startX, endX;
+  int startY, endY;
+
+  bool operator==( const SliceRenderRegion & other ) const
+    {
+    return order[0] == other.order[0] && order[1] == other.order[1]
+      && order[2] == other.order[2] && slice == other.slice
+      && imageMode == other.imageMode
+      && slabThickness == other.slabThickness && level == other.level
+      && startX == other.startX && endX == other.endX
+      && startY == other.startY && endY == other.endY;
+    }
+  bool operator!=( const SliceRenderRegion & other ) const
+    {
+    return !( *this == other );
+    }
+  };
+
+/*! Structure ImageLayerKey to store what the grayscale window buffer
+* was rendered from. The buffer is only resliced when the key changes.
+*/
+struct ImageLayerKey
+  {
+  SliceRenderRegion region;
+  const void * image;
+  unsigned long generation;
+  double iwMin;
+  double iwMax;
+  IWModeType iwModeMin;
+  IWModeType iwModeMax;
+
+  bool operator==( const ImageLayerKey & other ) const
+    {
+    return region == other.region && image == other.image
+      && generation == other.generation
+      && iwMin == other.iwMin && iwMax == other.iwMax
+      && iwModeMin == other.iwModeMin && iwModeMax == other.iwModeMax;
+    }
+  bool operator!=( const ImageLayerKey & other ) const
+    {
+    return !( *this == other );
+    }
+  };
+
+/*! Structure OverlayLayerKey to store what the RGBA overlay window buffer
+* was rendered from. In the modes with a depth buffer (MIP, SlabMax and
+* SlabMin) the overlay follows the depth buffer of the grayscale layer,
+* so imageLayer then counts grayscale renders.
+*/
+struct OverlayLayerKey
+  {
+  SliceRenderRegion region;
+  const void * overlay;
+  unsigned long generation;
+  unsigned long colors;
+  unsigned long imageLayer;
+
+  bool operator==( const OverlayLayerKey & other ) const
+    {
+    return region == other.region && overlay == other.overlay
+      && generation == other.generation && colors == other.colors
+      && imageLayer == other.imageLayer;
+    }
+  bool operator!=( const OverlayLayerKey & other ) const
+    {
+    return !( *this == other );
+    }
+  };
+
 /*! Parent struct defining a Step (with a type)
 * The type is a ClickModeType.
 */
@@ -221,6 +335,7 @@ public:
   typedef unsigned char                    OverlayPixelType;
   typedef long int                         IndexValueType;
   typedef itk::Image<ImagePixelType,3>     ImageType;
+  typedef itk::ImageBase<3>                ImageBaseType;
   typedef itk::Image<OverlayPixelType,3>   OverlayType;
   typedef ImageType::Pointer      ImagePointer;
   typedef OverlayType::Pointer    OverlayPointer;
@@ -237,8 +352,22 @@ public:
   QtGlSliceView(QWidget *parent = 0);
   ~QtGlSliceView();
 
+  /*! Return the input image as double. An input of another pixel type
+  *   is converted on the first call, and the copy is kept until the
+  *   input changes; changing its pixels does not change the view.
+  *   NULL if the input is streamed from its file or still loading. */
   virtual const ImagePointer & inputImage(void) const;
 
+  /*! Return the input image in its own pixel type, with the reslicers
+  *   and projections rendered from it */
+  const SliceVolumeBase * inputVolume(void) const
+    { return cVolume.get(); }
+
+  /*! Return the overlay of a streamed input, NULL if the overlay is an
+  *   image */
+  const SparseLabelVolume * inputLabelVolume(void) const
+    { return cLabelVolume.get(); }
+
   /*! Return a pointer to the overlay data */
   const OverlayPointer &inputOverlay(void) const;
 
@@ -288,6 +417,12 @@ public:
   /*! Get the opacity of the overlay */
   double overlayOpacity(void) const;
 
+  /*! Whether the overlay pixels of label, 1 to 255, are shown */
+  bool labelVisible( int label ) const;
+
+  /*! Opacity of label, relative to the opacity of the overlay */
+  double labelOpacity( int label ) const;
+
   ColorTableType *colorTable(void) const;
 
   virtual QSize minimumSizeHint()const;
@@ -327,6 +462,24 @@ public:
   /// \sa minIntensity(), maxIntensity()
   double intensityRange() const;
 
+  /// Return the statistics and histogram of the image, computed once
+  /// when it is set, or those of its center slice until the pixels of a
+  /// mapped image are all read
+  /// \sa autoWindow()
+  const ImageStatistics & imageStatistics() const
+    { return cImageStatistics; }
+
+  /// Return true while slices of the image are being loaded
+  /// \sa setInputVolume(), isLoaded()
+  bool isLoading() const;
+
+  /// Return false if slices of the image are not loaded, because they are
+  /// being loaded or the loading was cancelled
+  bool isLoaded() const;
+
+  /// Return the percentage of the slices of the image loaded
+  int loadProgress() const;
+
   /// Return the lower intensity of the window.
   /// \sa iwMin
   double iwMin() const;
@@ -536,9 +689,36 @@ public slots:
   /*! Specify the opacity of the overlay */
   void  setOverlayOpacity(double newOverlayOpacity);
 
+  /*! Show or hide the overlay pixels of label, 1 to 255 */
+  void setLabelVisible( int label, bool visible );
+
+  /*! Specify the opacity of label, 1 to 255, as a fraction of the
+  *   opacity of the overlay */
+  void setLabelOpacity( int label, double opacity );
+
   /*! Specify the 3D image to view slice by slice */
   virtual void setInputImage(ImageType * newImData);
 
+  /*! Specify the 3D image to view slice by slice, which is kept in its
+  *   own pixel type: unsigned char, short, unsigned short, float or
+  *   double. Images of other types are ignored. */
+  virtual void setInputImage(ImageBaseType * newImData);
+
+  /*! Specify the volume to view slice by slice, e.g., one streamed from
+  *   its file by SliceVolumeBase::createStreamed(). The overlay created
+  *   for a streamed volume is a SparseLabelVolume. */
+  virtual void setInputVolume( std::unique_ptr< SliceVolumeBase > volume );
+
+  /*! Specify the volume to view while loader, which has read its first
+  *   slice, fills in the others. The slices not loaded yet are shown as
+  *   placeholders, and the statistics are those of the slices loaded
+  *   until all are. */
+  void setInputVolume( std::unique_ptr< SliceVolumeBase > volume,
+    std::unique_ptr< VolumeLoader > loader );
+
+  /*! Stop loading the image. The slices loaded are kept. */
+  void cancelLoading();
+
   /*! Specify the 3D image to view as an overlay */
   void setInputOverlay(OverlayType * newOverlayData);
 
@@ -548,6 +728,16 @@ public slots:
   void saveOverlayWithPrompt( void );
   void saveOverlay( std::string fileName );
   void paintOverlayPoint( double x, double y, double z, std::string dimension);
+
+  /*! Recompute the window overlay for an index box of the overlay that
+  *   was edited, without reslicing the image. Falls back to update() if
+  *   the view changed since the last update(). */
+  void updateOverlayRegion( const int minIndex[3], const int maxIndex[3] );
+
+  /*! Tell the view that the pixels of the image or of the overlay were
+  *   changed in place, so the next update() reslices them */
+  void invalidateImage();
+  void invalidateOverlay();
   void setPreserveOverlayPaint( bool preserve )
     { cPreserveOverlayPaint = preserve; };
   void setPaintRadius( int r )
@@ -558,6 +748,55 @@ public slots:
   void setFixedSliceMoveValue( int delta )
     { cFixedSliceMoveValue = delta; }
 
+  /*! Number of threads used to render the slice. 0 uses ITK's global
+  *   default, which follows the number of cores of the host. */
+  void setNumberOfRenderThreads( unsigned int numberOfThreads );
+  unsigned int numberOfRenderThreads() const
+    { return cNumberOfRenderThreads; }
+
+  /*! Memory, in megabytes, kept for recently rendered slices so that
+  *   scrolling back over them skips the reslicing. 0 disables the cache. */
+  void setSliceCacheSize( unsigned int megabytes );
+  unsigned int sliceCacheSize() const;
+
+  /*! Number of slices rendered in the background ahead of the scroll
+  *   direction, into the slice cache. 0 disables the prefetching. */
+  void setNumberOfPrefetchSlices( unsigned int numberOfSlices );
+  unsigned int numberOfPrefetchSlices() const;
+
+  /*! Render slices from a copy of the image stored in bricks of
+  *   brickSize^3 voxels, so all orientations have similar memory access
+  *   costs. brickSize must be a power of two; 0 reads the image buffer. */
+  void setBrickSize( unsigned int brickSize );
+  unsigned int brickSize() const
+    { return cBrickSize; }
+
+  /*! Bytes used by the bricked copy of the image, 0 if there is none */
+  size_t brickedVolumeMemorySize() const;
+
+  /*! Bytes of window buffers uploaded to textures by the last repaint,
+  *   and since the view was created. Repaints that only change the
+  *   annotations upload nothing. Shown with the image details. */
+  size_t uploadedBytes() const
+    { return cUploadedBytes; }
+  size_t totalUploadedBytes() const
+    { return cTotalUploadedBytes; }
+
+  /*! Number of slices, centered on the current slice, projected by the
+  *   SlabMax, SlabMin and SlabMean image modes. Values below 1 are
+  *   clamped to 1. */
+  void setSlabThickness( int thickness );
+  int slabThickness() const
+    { return cSlabThickness; }
+
+  /*! Highest level of the image pyramid rendered when zoomed out. Level
+  *   l averages blocks of 2^l voxels per axis and is used once a screen
+  *   pixel covers that many voxels, except in the MIP and slab modes.
+  *   0 always renders the image itself. */
+  void setMaxPyramidLevel( int level );
+  int maxPyramidLevel() const
+    { return cMaxPyramidLevel; }
+
   void setSaveOnExitPrefix( const char* prefix );
 
   void saveRulersWithPrompt( void );
@@ -631,6 +870,12 @@ public slots:
 
   void setFastIWValue(double iwVal);
 
+  /// Fix the intensity windowing to the lower and upper percentiles of
+  /// the image, read from imageStatistics(). While those are partial, the
+  /// window is set again from the full statistics once they arrive,
+  /// unless it was changed in between.
+  void autoWindow(double lowerPercent = 1, double upperPercent = 99);
+
   void zoomIn();
   void zoomOut();
   void showHelp();
@@ -665,7 +910,15 @@ signals:
   void validOverlayDataChanged(bool valid);
   void maxClickedPointsStoredChanged(int max);
   void displayStateChanged(int state);
-  
+  void loadProgressChanged(int percent);
+  /// Emitted when the loading stops, complete or not
+  void loadFinished(bool complete);
+
+protected slots:
+  /* shows the slices loaded since the last call, and the statistics of
+     the image once it is loaded or cStatisticsThread is done */
+  void updateLoading();
+
 protected:
 
   void initializeGL();
@@ -693,12 +946,28 @@ protected:
 
   OverlayPointer cOverlayData;
   OverlayPointer cPrevOverlayData;
+  /* overlay of a streamed input, used instead of cOverlayData */
+  std::unique_ptr< SparseLabelVolume > cLabelVolume;
+  std::unique_ptr< SparseLabelVolume > cPrevLabelVolume;
 
   unsigned char *cWinOverlayData;
   QDialog* cHelpDialog;
 
   ColorTablePointer cColorTable;
 
+  /* packed RGBA, in memory order, of each overlay label, built from
+     cColorTable, cOverlayOpacity and the label settings */
+  unsigned int cOverlayColors[256];
+  bool cLabelVisible[256];
+  double cLabelOpacity[256];
+  bool cOverlayColorsModified;
+  itk::ModifiedTimeType cOverlayColorTableMTime;
+  unsigned long cOverlayColorsGeneration;
+
+  /* rebuilds cOverlayColors if its inputs changed since the last call;
+     changes to cColorTable are found through its modified time */
+  void updateOverlayColors();
+
   void (*cSliceNumCallBack)(void);
   void *cSliceNumArg;
   void (*cSliceNumArgCallBack)(void *sliceNumArg);
@@ -706,7 +975,10 @@ protected:
   bool cValidImData;
   bool cViewImData;
   bool cViewClickedPoints;
-  ImagePointer cImData;
+  /* inputImage(), the input itself or converted on demand */
+  mutable ImagePointer cImData;
+  /* the input image, its reslicers and projections */
+  std::unique_ptr< SliceVolumeBase > cVolume;
   unsigned long cDimSize[3];
   double cSpanMax;
   double cSpacing[3];
@@ -780,15 +1052,147 @@ protected:
   int cWinMinY;
   int cWinMaxY;
   unsigned int cWinSizeY;
+  /* size of the window buffers, that of the rendered region */
   int cWinDataSizeX;
   int cWinDataSizeY;
   int inDataSizeX;
   int inDataSizeY;
   unsigned char *cWinImData;
   unsigned short *cWinZBuffer;
+  std::unique_ptr< RenderBufferPool > cWinBufferPool;
+
+  /* reallocates the window buffers from cWinBufferPool if the size of
+     the rendered region changed, and the overlay buffer once there is
+     an overlay */
+  void resizeWinBuffers( int sizeX, int sizeY );
+
+  itk::MultiThreaderBase::Pointer cRenderThreader;
+  unsigned int cNumberOfRenderThreads;
+  std::unique_ptr< SliceCache > cSliceCache;
+  std::unique_ptr< SlicePrefetcher > cSlicePrefetcher;
+  unsigned int cBrickSize;
+  int cSlabThickness;
+  int cMaxPyramidLevel;
+  /* level of the window buffers, and the slice voxel of that level
+     their first pixel holds */
+  int cWinDataLevel;
+  int cWinDataStartX;
+  int cWinDataStartY;
+
+  /* pyramid level to render for the current zoom and widget size */
+  int pyramidLevel() const;
+
+  /* a window buffer mirrored in GL textures, row by row tiles of at
+     most tileSize pixels a side, and the range of buffer rows changed
+     since they were uploaded */
+  struct WinTexture
+    {
+    std::vector< GLuint > ids;
+    int sizeX;
+    int sizeY;
+    int tileSize;
+    int dirtyStartRow;
+    int dirtyEndRow;
+    };
+  WinTexture cImageTexture;
+  WinTexture cOverlayTexture;
+  /* largest side of a texture, GL_MAX_TEXTURE_SIZE */
+  int cMaxTextureSize;
+  size_t cUploadedBytes;
+  size_t cTotalUploadedBytes;
+
+  /* adds rows startRow to endRow to the rows of texture to upload */
+  static void markDirtyRows( WinTexture & texture, int startRow,
+    int endRow );
+
+  /* uploads the changed rows of data, a window buffer with bytesPerPixel
+     bytes per pixel, or all of it if the buffer size changed, to the
+     tiles of texture */
+  void uploadWinTexture( WinTexture & texture, GLenum format,
+    int bytesPerPixel, const unsigned char * data );
+
+  /* draws the first extentX by extentY pixels of the tiles of texture on
+     the quad from ( x0, y0 ) to ( x1, y1 ) */
+  void drawWinTexture( const WinTexture & texture, double x0, double y0,
+    double x1, double y1, double extentX, double extentY );
+
+  /* rebuilds or drops cBrickedVolume after the image or brick size
+     changed */
+  void updateBrickedVolume();
+
+  /* sets cDataMin/Max and the windowing paces from cImageStatistics */
+  void updateIntensityRange();
+
+  /* replaces cImageStatistics by statistics, those of every pixel, and
+     widens a window over the whole range to the new range */
+  void setImageStatistics( const ImageStatistics & statistics );
+
+  /* computes the statistics of cVolume on cStatisticsThread */
+  void startStatistics();
+
+  /* stops cStatisticsThread, its statistics are dropped */
+  void stopStatistics();
+
+  /* milliseconds between two updateLoading() */
+  enum { LoadProgressInterval = 100 };
+
+  /* fills the image slices being loaded, their number when last shown,
+     which are loaded when last rendered, and which were loaded when the
+     slices cached with their placeholders were last dropped */
+  std::unique_ptr< VolumeLoader > cVolumeLoader;
+  QTimer * cLoadTimer;
+  int cNumberOfLoadedSlices;
+  std::vector< unsigned char > cLoadedSlices;
+  std::vector< unsigned char > cCachedLoadedSlices;
+
+  /* drops the cached slices and the image layer that show placeholders
+     for slices loaded since the last call */
+  void invalidateLoadedSlices();
+
+  /* computes cScannedStatistics, those of every pixel of a mapped image,
+     slice by slice, which would otherwise read the whole file before
+     the first slice is shown */
+  std::thread cStatisticsThread;
+  std::atomic< bool > cStatisticsRunning;
+  std::atomic< bool > cStatisticsCancelled;
+  ImageStatistics cScannedStatistics;
+
+  /* what cWinImData / cWinOverlayData hold after the last update() */
+  unsigned long cImageGeneration;
+  unsigned long cOverlayGeneration;
+  unsigned long cImageLayerRenderCount;
+  ImageLayerKey cRenderedImageKey;
+  OverlayLayerKey cRenderedOverlayKey;
+  bool cValidImageLayer;
+  bool cValidOverlayLayer;
+
+  ImageLayerKey imageLayerKey( const SliceRenderRegion & region ) const;
+  OverlayLayerKey overlayLayerKey( const SliceRenderRegion & region ) const;
+
+  /* updates cWinMin/Max/Size X/Y and returns the region to render */
+  SliceRenderRegion computeRenderRegion();
+
+  /* colors window overlay row k, columns startJ to endJ */
+  void renderOverlayRow( const SliceRenderRegion & region, int k,
+    int startJ, int endJ );
+  /* the same from cLabelVolume, to rgba */
+  void renderLabelVolumeRow( const SliceRenderRegion & region, int k,
+    int startJ, int endJ, unsigned char * rgba );
+  /* replaces the pixels of the slices not loaded in window image rows
+     startK to endK by a checkerboard, or all of them for the projection
+     modes, which are only computed once the image is loaded */
+  void renderPlaceholderRows( const SliceRenderRegion & region, int startK,
+    int endK );
 
   double cDataMax;
   double cDataMin;
+  ImageStatistics cImageStatistics;
+
+  /* percentiles of the last autoWindow() of the image, and the window it
+     set, which is set again from new statistics if it is unchanged */
+  bool cAutoWindow;
+  double cAutoWindowPercent[2];
+  double cAutoWindowRange[2];
 
   /* list of points clicked and maximum no. of points to be stored*/
   typedef QList<ClickPoint> ClickPointListType;
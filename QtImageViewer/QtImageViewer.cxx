@@ -40,10 +40,14 @@ limitations under the License.
 // QtImageViewer includes
 #include "QtImageViewer.h"
 #include "QtGlSliceView.h"
+#include "MappedImageReader.h"
+#include "SliceVolume.h"
+#include "VolumeLoader.h"
 #include "ui_QtImageViewer.h"
 
 // ITK includes
 #include <itkImageFileReader.h>
+#include <itkImageIOFactory.h>
 
 // STD includes
 #include <iostream>
@@ -66,6 +70,33 @@ public:
   typename itk::Image<PixelType,3>::Pointer readImage(const QString &
     filePath);
 
+  /// Read an image in the component type of the file if the slice view
+  /// can keep it, as double otherwise.
+  itk::ImageBase<3>::Pointer loadNativeImage(QString& filePath,
+    const QString& imageType = QString());
+
+  /// Allocate the image of the file if the slice view can keep it, and
+  /// start loader reading its pixels from the center slice on. NULL
+  /// otherwise.
+  std::unique_ptr<SliceVolumeBase> loadProgressiveVolume(
+    const QString& filePath, std::unique_ptr<VolumeLoader>& loader);
+
+  /// Show volume, while loader reads its pixels if it is not NULL
+  void showVolume(std::unique_ptr<SliceVolumeBase> volume,
+    std::unique_ptr<VolumeLoader> loader);
+
+  /// Open the file for streaming if its pixels take more than
+  /// StreamingMemory and its format can be read by region, NULL
+  /// otherwise.
+  std::unique_ptr<SliceVolumeBase> loadStreamedVolume(
+    const QString& filePath);
+
+  /// Prompt for the file if filePath is empty, and check that it exists.
+  bool selectImageFile(QString& filePath, const QString& imageType);
+
+  /// Size the slice view for an image width, in pixels
+  void resizeSliceView(int width);
+
   /// Resize the entire dialog based on the current size and to ensure it
   /// fits
   /// the contents.
@@ -78,6 +109,7 @@ public:
 
   QDialog* HelpDialog;
   bool IsRedirectingEvent;
+  int StreamingMemory;
 
 protected:
   QtImageViewer* const q_ptr;
@@ -87,6 +119,7 @@ protected:
 QtImageViewerPrivate::QtImageViewerPrivate(QtImageViewer& obj)
   : HelpDialog(0)
   , IsRedirectingEvent(false)
+  , StreamingMemory(0)
   , q_ptr(&obj)
 {
 }
@@ -98,12 +131,10 @@ void QtImageViewerPrivate::setupUi(QDialog* widgetToSetup)
   this->Superclass::setupUi(widgetToSetup);
 }
 
-template <class PixelType>
-typename itk::Image<PixelType, 3>::Pointer QtImageViewerPrivate
-::loadImage(QString& filePath, const QString& imageType)
+bool QtImageViewerPrivate::selectImageFile(QString& filePath,
+  const QString& imageType)
 {
   Q_Q(QtImageViewer);
-  typename itk::Image<PixelType, 3>::Pointer res;
   // If the path is empty, prompt a dialog to give a chance to select the
   // image to load.
   if (filePath.isEmpty())
@@ -114,7 +145,7 @@ typename itk::Image<PixelType, 3>::Pointer QtImageViewerPrivate
   // Empty if the user cancelled the dialog.
   if (filePath.isEmpty())
     {
-    return res;
+    return false;
     }
   // Might be a non existing path.
   QFileInfo fileInfo(filePath);
@@ -124,6 +155,18 @@ typename itk::Image<PixelType, 3>::Pointer QtImageViewerPrivate
     const QString message = QString(
       "The file you have selected does not exist. %1").arg(filePath);
     QMessageBox::warning(q, messageTitle, message);
+    return false;
+    }
+  return true;
+}
+
+template <class PixelType>
+typename itk::Image<PixelType, 3>::Pointer QtImageViewerPrivate
+::loadImage(QString& filePath, const QString& imageType)
+{
+  typename itk::Image<PixelType, 3>::Pointer res;
+  if (!this->selectImageFile(filePath, imageType))
+    {
     return res;
     }
 
@@ -132,6 +175,146 @@ typename itk::Image<PixelType, 3>::Pointer QtImageViewerPrivate
   return res;
 }
 
+itk::ImageBase<3>::Pointer QtImageViewerPrivate
+::loadNativeImage(QString& filePath, const QString& imageType)
+{
+  itk::ImageBase<3>::Pointer res;
+  if (!this->selectImageFile(filePath, imageType))
+    {
+    return res;
+    }
+
+  // Only the header is read to find the component type. If it cannot be
+  // read, readImage() reports the error.
+  itk::ImageIOBase::IOComponentType componentType =
+    itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    filePath.toLatin1().data(), itk::ImageIOFactory::ReadMode );
+  if (imageIO.IsNotNull())
+    {
+    try
+      {
+      imageIO->SetFileName( filePath.toLatin1().data() );
+      imageIO->ReadImageInformation();
+      if (imageIO->GetNumberOfComponents() == 1)
+        {
+        componentType = imageIO->GetComponentType();
+        }
+      }
+    catch (itk::ExceptionObject &)
+      {
+      }
+    }
+
+  // Read the file.
+  switch (componentType)
+    {
+    case itk::ImageIOBase::UCHAR:
+      res = this->readImage<unsigned char>(filePath).GetPointer();
+      break;
+    case itk::ImageIOBase::SHORT:
+      res = this->readImage<short>(filePath).GetPointer();
+      break;
+    case itk::ImageIOBase::USHORT:
+      res = this->readImage<unsigned short>(filePath).GetPointer();
+      break;
+    case itk::ImageIOBase::FLOAT:
+      res = this->readImage<float>(filePath).GetPointer();
+      break;
+    default:
+      res = this->readImage<double>(filePath).GetPointer();
+      break;
+    }
+  return res;
+}
+
+std::unique_ptr<SliceVolumeBase> QtImageViewerPrivate
+::loadStreamedVolume(const QString& filePath)
+{
+  std::unique_ptr<SliceVolumeBase> res;
+  if (this->StreamingMemory <= 0)
+    {
+    return res;
+    }
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    filePath.toLatin1().data(), itk::ImageIOFactory::ReadMode );
+  if (imageIO.IsNull())
+    {
+    return res;
+    }
+  try
+    {
+    imageIO->SetFileName( filePath.toLatin1().data() );
+    imageIO->ReadImageInformation();
+    }
+  catch (itk::ExceptionObject &)
+    {
+    return res;
+    }
+  const size_t budget = size_t(this->StreamingMemory) << 20;
+  if (imageIO->GetImageSizeInBytes() > budget)
+    {
+    res = SliceVolumeBase::createStreamed(imageIO, budget);
+    }
+  return res;
+}
+
+std::unique_ptr<SliceVolumeBase> QtImageViewerPrivate
+::loadProgressiveVolume(const QString& filePath,
+  std::unique_ptr<VolumeLoader>& loader)
+{
+  std::unique_ptr<SliceVolumeBase> res;
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    filePath.toLatin1().data(), itk::ImageIOFactory::ReadMode );
+  if (imageIO.IsNull())
+    {
+    return res;
+    }
+  try
+    {
+    imageIO->SetFileName( filePath.toLatin1().data() );
+    imageIO->ReadImageInformation();
+    }
+  catch (itk::ExceptionObject &)
+    {
+    return res;
+    }
+  itk::ImageBase<3>::Pointer image =
+    SliceVolumeBase::createImage(imageIO, true);
+  if (image.IsNull())
+    {
+    return res;
+    }
+  res = SliceVolumeBase::create(image);
+  loader.reset(new VolumeLoader(imageIO, res->buffer()));
+
+  // Compressed pixels are inflated as they load, not read whole by ITK
+  MappedImageReader mappedReader;
+  if (mappedReader.setFileName(filePath) && mappedReader.canInflate())
+    {
+    loader->setCompressedData(mappedReader.dataFileName(),
+      mappedReader.dataOffset(), mappedReader.compressedSize(),
+      mappedReader.inflatedOffset());
+    }
+  if (!loader->start((int(res->dimSize()[2]) - 1)/2))
+    {
+    loader.reset();
+    res.reset();
+    }
+  return res;
+}
+
+void QtImageViewerPrivate::showVolume(
+  std::unique_ptr<SliceVolumeBase> volume,
+  std::unique_ptr<VolumeLoader> loader)
+{
+  const int width = volume->dimSize()[0];
+  this->OpenGlWindow->setInputVolume(std::move(volume), std::move(loader));
+  this->OpenGlWindow->changeSlice(
+    (this->OpenGlWindow->maxSliceNum() - 1)/2);
+  this->resizeSliceView(width);
+}
+
 template <class PixelType>
 typename itk::Image<PixelType, 3>::Pointer QtImageViewerPrivate::readImage(
   const QString& filePath )
@@ -162,6 +345,31 @@ typename itk::Image<PixelType, 3>::Pointer QtImageViewerPrivate::readImage(
   return res;
 }
 
+void QtImageViewerPrivate::resizeSliceView(int width)
+{
+  Q_Q(QtImageViewer);
+  int height = width;
+  while( width > 500 || height > 500 )
+    {
+    width /= 2;
+    height /= 2;
+    }
+  QSize newSize = QSize( width, height );
+  this->OpenGlWindow->setMinimumSize( newSize );
+  while( width < 500 && height < 500 )
+    {
+    width *= 2;
+    height *= 2;
+    }
+  newSize = QSize( width, height );
+  this->OpenGlWindow->resize( newSize );
+  // Use adjustSize() instead of updateSize() because there is no valid
+  // prior size.
+  q->layout()->activate();
+  q->adjustSize();
+  this->updateSize();
+}
+
 void QtImageViewerPrivate::updateSize()
 {
   Q_Q(QtImageViewer);
@@ -266,32 +474,31 @@ QtGlSliceView* QtImageViewer::sliceView()const
 
 
 void QtImageViewer::setInputImage(ImageType* newImData)
+{
+  this->setInputImage(static_cast<ImageBaseType*>(newImData));
+}
+
+
+void QtImageViewer::setInputImage(ImageBaseType* newImData)
 {
   Q_D(QtImageViewer);
   d->OpenGlWindow->setInputImage(newImData);
   d->OpenGlWindow->changeSlice((d->OpenGlWindow->maxSliceNum() - 1)/2);
+  d->resizeSliceView(newImData->GetLargestPossibleRegion().GetSize()[0]);
+}
 
-  int width = newImData->GetLargestPossibleRegion().GetSize()[0];
-  int height = width; //newImData->GetLargestPossibleRegion().GetSize()[1];
-  while( width > 500 || height > 500 )
-    {
-    width /= 2;
-    height /= 2;
-    }
-  QSize newSize = QSize( width, height );
-  d->OpenGlWindow->setMinimumSize( newSize );
-  while( width < 500 && height < 500 )
-    {
-    width *= 2;
-    height *= 2;
-    }
-  newSize = QSize( width, height );
-  d->OpenGlWindow->resize( newSize );
-  // Use adjustSize() instead of updateSize() because there is no valid
-  // prior size.
-  this->layout()->activate();
-  this->adjustSize();
-  d->updateSize();
+
+void QtImageViewer::setStreamingMemory(int megabytes)
+{
+  Q_D(QtImageViewer);
+  d->StreamingMemory = megabytes;
+}
+
+
+int QtImageViewer::streamingMemory()const
+{
+  Q_D(const QtImageViewer);
+  return d->StreamingMemory;
 }
 
 
@@ -306,8 +513,44 @@ void QtImageViewer::setOverlayImage(OverlayImageType* newImData)
 bool QtImageViewer::loadInputImage(QString filePathToLoad)
 {
   Q_D(QtImageViewer);
-  
-  ImageType::Pointer image = d->loadImage<double>(filePathToLoad);
+
+  if (!d->selectImageFile(filePathToLoad, QString()))
+    {
+    return false;
+    }
+  // The pixels of uncompressed MetaImage and NRRD files are mapped
+  // instead of read, whatever their size, so they keep every mode.
+  // Other files are streamed if they are larger than StreamingMemory,
+  // or shown while they load, compressed ones included.
+  std::unique_ptr<VolumeLoader> loader;
+  std::unique_ptr<SliceVolumeBase> volume;
+  ImageBaseType::Pointer image;
+  MappedImageReader mappedReader;
+  if (mappedReader.setFileName(filePathToLoad)
+    && !mappedReader.isCompressed())
+    {
+    image = mappedReader.read();
+    }
+  if (image.IsNull())
+    {
+    volume = d->loadStreamedVolume(filePathToLoad);
+    }
+  if (!volume && image.IsNull())
+    {
+    volume = d->loadProgressiveVolume(filePathToLoad, loader);
+    }
+  if (volume)
+    {
+    d->showVolume(std::move(volume), std::move(loader));
+    this->sliceView()->setInputImageFilepath(filePathToLoad);
+    this->setWindowTitle(filePathToLoad);
+    return true;
+    }
+
+  if (image.IsNull())
+    {
+    image = d->loadNativeImage(filePathToLoad);
+    }
   if (image.IsNotNull())
     {
     this->setInputImage( image );
@@ -322,7 +565,21 @@ bool QtImageViewer::loadOverlayImage(QString filePathToLoad)
 {
   Q_D(QtImageViewer);
 
-  OverlayImageType::Pointer image = d->loadImage<OverlayPixelType>(filePathToLoad);
+  // Overlays saved by the slice view are compressed in chunks. Others
+  // are read: overlays are painted in place and saved back to their
+  // file, so they must not be mappings of it.
+  OverlayImageType::Pointer image;
+  MappedImageReader mappedReader;
+  if (mappedReader.setFileName(filePathToLoad)
+    && mappedReader.isChunked())
+    {
+    ImageBaseType::Pointer mappedImage = mappedReader.read();
+    image = dynamic_cast<OverlayImageType*>(mappedImage.GetPointer());
+    }
+  if (image.IsNull())
+    {
+    image = d->loadImage<OverlayPixelType>(filePathToLoad);
+    }
   if (image.IsNotNull())
     {
     this->setOverlayImage( image );
@@ -364,6 +621,12 @@ bool QtImageViewer::loadJSONAnnotations(QString filePathToLoad)
 void QtImageViewer::keyPressEvent(QKeyEvent* keyEvent)
 {
   Q_D(QtImageViewer);
+  // Escape stops the loading before it closes the viewer
+  if (keyEvent->key() == Qt::Key_Escape && d->OpenGlWindow->isLoading())
+    {
+    d->OpenGlWindow->cancelLoading();
+    return;
+    }
   if (keyEvent->key() != Qt::Key_Escape &&
       keyEvent->key() != Qt::Key_Enter &&
       keyEvent->key() != Qt::Key_Return)
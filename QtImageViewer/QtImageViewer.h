@@ -41,6 +41,7 @@ public:
   typedef QDialog Superclass;
   typedef double                              ImagePixelType;
   typedef itk::Image<double,3>                ImageType;
+  typedef itk::ImageBase<3>                   ImageBaseType;
   typedef unsigned char                       OverlayPixelType;
   typedef itk::Image<OverlayPixelType,3>      OverlayImageType;
 
@@ -50,9 +51,21 @@ public:
 
   QtGlSliceView* sliceView()const;
 
+  /// Memory, in megabytes, above which the pixels of an input image are
+  /// streamed from its file chunk by chunk instead of being read, and
+  /// that the chunks read are kept within. 0, the default, never
+  /// streams. Files whose pixels can be mapped are never streamed.
+  /// \sa loadInputImage(), SliceVolumeBase::createStreamed()
+  void setStreamingMemory(int megabytes);
+  int streamingMemory()const;
+
 public slots:
   /// Load an image from a file path.
   /// If the path is empty, a file dialog is prompted to the user.
+  /// The image is kept in the component type of the file when the viewer
+  /// supports it, see QtGlSliceView::setInputImage(). Images larger than
+  /// streamingMemory() are streamed if their format allows it and
+  /// their pixels cannot be mapped.
   /// \sa loadOverlayImage(), setInputImage()
   bool loadInputImage(QString filePath = QString());
 
@@ -66,6 +79,8 @@ public slots:
   /// Set the image to view.
   /// \sa setOverlayImage(), loadInputImage()
   virtual void setInputImage(ImageType * newImData);
+  /// Set the image to view, in any pixel type the viewer supports.
+  virtual void setInputImage(ImageBaseType * newImData);
   /// Set an image as overlay.
   /// \sa setInputImage(), loadOverlayImage()
   virtual void setOverlayImage(OverlayImageType * newImData);
@@ -0,0 +1,497 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "RenderBenchmark.h"
+#include "BrickedVolume.h"
+#include "MipProjector.h"
+#include "SlabProjector.h"
+#include "SliceReslicer.h"
+#include "WindowLevelKernel.h"
+
+// STD includes
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <vector>
+
+namespace
+{
+
+/*! Calls f() until minimumTime has elapsed and returns the calls/second */
+template <class TFunction>
+double
+callsPerSecond( TFunction f, double minimumTime )
+{
+  typedef std::chrono::steady_clock ClockType;
+  const ClockType::time_point start = ClockType::now();
+  double elapsed = 0;
+  long calls = 0;
+  do
+    {
+    f();
+    ++calls;
+    elapsed = std::chrono::duration<double>( ClockType::now() - start )
+      .count();
+    }
+  while( elapsed < minimumTime );
+  return calls / elapsed;
+}
+
+template <class TPixel>
+bool
+createBenchmark( const SliceVolumeBase * volume,
+  const ImageStatistics & statistics,
+  std::unique_ptr< RenderBenchmarkBase > & benchmark )
+{
+  typedef itk::Image< TPixel, 3 > ImageType;
+  const ImageType * typedImage =
+    dynamic_cast< const ImageType * >( volume->image() );
+  if( typedImage != NULL )
+    {
+    benchmark.reset( new RenderBenchmark< TPixel >( typedImage,
+      statistics ) );
+    }
+  return typedImage != NULL;
+}
+
+} // end namespace
+
+
+std::unique_ptr< RenderBenchmarkBase >
+RenderBenchmarkBase::
+create( const SliceVolumeBase * volume )
+{
+  std::unique_ptr< RenderBenchmarkBase > benchmark;
+  if( volume == NULL || volume->isStreamed() )
+    {
+    return benchmark;
+    }
+  // Those of every pixel, as the view has once the image is loaded
+  ImageStatistics statistics;
+  itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+  volume->computeStatistics( statistics, threader );
+  createBenchmark< unsigned char >( volume, statistics, benchmark )
+    || createBenchmark< short >( volume, statistics, benchmark )
+    || createBenchmark< unsigned short >( volume, statistics, benchmark )
+    || createBenchmark< float >( volume, statistics, benchmark )
+    || createBenchmark< double >( volume, statistics, benchmark );
+  return benchmark;
+}
+
+
+RenderBenchmarkBase::
+RenderBenchmarkBase( const SliceVolumeBase::ImageBaseType * image,
+  const ImageStatistics & statistics )
+{
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = image->GetLargestPossibleRegion().GetSize()[i];
+    }
+  mStatistics = statistics;
+  mMinimumTime = 0.5;
+}
+
+
+void
+RenderBenchmarkBase::
+run( std::ostream & os )
+{
+  os << "Image size: " << mDimSize[0] << " x " << mDimSize[1] << " x "
+    << mDimSize[2] << ", " << ( mStatistics.isInteger() ? "integer"
+    : "real" ) << " pixels of " << this->pixelSize() << " bytes"
+    << std::endl;
+  this->runWindowLevel( os );
+  this->runOrientations( os );
+  this->runBricks( os );
+  this->runMip( os );
+  this->runSlab( os );
+}
+
+
+template <class TPixel>
+void
+RenderBenchmarkBase::
+setUpReslicer( SliceReslicer< TPixel > & reslicer,
+  const TPixel * buffer ) const
+{
+  reslicer.setInputBuffer( buffer, mDimSize );
+  reslicer.setInputRange( mStatistics.isInteger(), mStatistics.minimum(),
+    mStatistics.maximum() );
+}
+
+
+template <class TPixel>
+RenderBenchmark<TPixel>::
+RenderBenchmark( const ImageType * image,
+  const ImageStatistics & statistics )
+  : RenderBenchmarkBase( image, statistics )
+{
+  mImage = image;
+}
+
+
+template <class TPixel>
+size_t
+RenderBenchmark<TPixel>::
+pixelSize() const
+{
+  return sizeof( PixelType );
+}
+
+
+template <class TPixel>
+void
+RenderBenchmark<TPixel>::
+runWindowLevel( std::ostream & os )
+{
+  // A window over the middle half of the data range, so all the IW mode
+  //   branches are taken
+  const double dataMin = mStatistics.minimum();
+  const double dataMax = mStatistics.maximum();
+  const double iwMin = dataMin + ( dataMax - dataMin ) / 4;
+  const double iwMax = dataMax - ( dataMax - dataMin ) / 4;
+
+  // The kernel maps the doubles the reslicer converts its pixels to, a
+  //   chunk at a time, so the first rows of the image are converted once
+  const int rowLength = ( int )mDimSize[0];
+  const long numberOfRows = std::min( ( long )( mDimSize[1] * mDimSize[2] ),
+    1024L );
+  const PixelType * buffer = mImage->GetBufferPointer();
+  std::vector< double > rows( buffer, buffer + rowLength * numberOfRows );
+  std::vector< unsigned char > out( rowLength );
+
+  os << "Window/level kernel (Mpixels/s)" << std::endl;
+  os << std::setw( 8 ) << "ISA" << std::setw( 8 ) << "IWMin"
+    << std::setw( 8 ) << "IWMax" << std::setw( 12 ) << "Value"
+    << std::setw( 12 ) << "Inverse" << std::endl;
+  for( int isa=WL_SCALAR; isa<=WindowLevelKernel::hostISA(); ++isa )
+    {
+    WindowLevelKernel kernel;
+    kernel.setISA( static_cast< WindowLevelISAType >( isa ) );
+    for( int modeMin=IW_MIN; modeMin<=IW_FLIP; ++modeMin )
+      {
+      for( int modeMax=IW_MIN; modeMax<=IW_FLIP; ++modeMax )
+        {
+        kernel.setIntensityWindow( iwMin, iwMax,
+          static_cast< IWModeType >( modeMin ),
+          static_cast< IWModeType >( modeMax ) );
+        os << std::setw( 8 ) << WindowLevelKernel::isaName( kernel.isa() )
+          << std::setw( 8 ) << IWModeTypeName[modeMin]
+          << std::setw( 8 ) << IWModeTypeName[modeMax];
+        for( int invert=0; invert<2; ++invert )
+          {
+          kernel.setInvert( invert != 0 );
+          long row = 0;
+          const double rowsPerSecond = callsPerSecond( [&]()
+            {
+            kernel.apply( &( rows[row * rowLength] ), rowLength,
+              &( out[0] ) );
+            row = ( row + 1 ) % numberOfRows;
+            }, mMinimumTime );
+          os << std::setw( 12 ) << std::fixed << std::setprecision( 1 )
+            << rowsPerSecond * rowLength / 1.0e6;
+          }
+        os << std::endl;
+        }
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+RenderBenchmark<TPixel>::
+runOrientations( std::ostream & os )
+{
+  const double dataMin = mStatistics.minimum();
+  const double dataMax = mStatistics.maximum();
+
+  const unsigned long * dimSize = mDimSize;
+  SliceReslicer< PixelType > reslicer;
+  this->setUpReslicer( reslicer, mImage->GetBufferPointer() );
+  reslicer.setImageMode( IMG_VAL );
+  reslicer.setIntensityWindow( dataMin + ( dataMax - dataMin ) / 4,
+    dataMax - ( dataMax - dataMin ) / 4, IW_MIN, IW_MAX );
+  reslicer.update();
+
+  // The window axis orders used by QtGlSliceView for each orientation,
+  //   then transposed
+  const int orders[6][3] = { { 2, 1, 0 }, { 0, 2, 1 }, { 0, 1, 2 },
+    { 1, 2, 0 }, { 2, 0, 1 }, { 1, 0, 2 } };
+  const char * names[6] = { "X", "Y", "Z", "X^T", "Y^T", "Z^T" };
+  const int groupSize = SliceReslicer< PixelType >::MaxSlicesPerPass;
+
+  os << "Slice orientations (ms/frame, "
+    << ( reslicer.usesLookupTable() ? "lookup table" : "window/level kernel" )
+    << ")" << std::endl;
+  os << std::setw( 8 ) << "View" << std::setw( 12 ) << "Rows"
+    << std::setw( 12 ) << "Tiled" << std::setw( 12 ) << "Grouped"
+    << std::endl;
+  for( int o=0; o<6; ++o )
+    {
+    const int * order = orders[o];
+    const int sizeX = ( int )dimSize[order[0]];
+    const int sizeY = ( int )dimSize[order[1]];
+    const int depth = ( int )dimSize[order[2]];
+    std::vector< unsigned char > out( groupSize * sizeX * sizeY );
+    std::vector< unsigned short > zBuffer( sizeX * sizeY );
+    reslicer.setOrder( order );
+    reslicer.setSlice( depth / 2 );
+    reslicer.update();
+
+    const double rows = callsPerSecond( [&]()
+      {
+      for( int k=0; k<sizeY; ++k )
+        {
+        reslicer.resliceRow( k, 0, sizeX-1, &( out[k*sizeX] ),
+          &( zBuffer[k*sizeX] ) );
+        }
+      }, mMinimumTime );
+    const double tiled = callsPerSecond( [&]()
+      {
+      reslicer.resliceRows( 0, sizeY-1, 0, sizeX-1, &( out[0] ),
+        &( zBuffer[0] ), sizeX );
+      }, mMinimumTime );
+    os << std::setw( 8 ) << names[o] << std::fixed << std::setprecision( 2 )
+      << std::setw( 12 ) << 1000 / rows << std::setw( 12 ) << 1000 / tiled;
+
+    // Slices filled together, as the prefetcher does when the slice axis
+    //   is the image x axis
+    if( order[2] == 0 && depth >= groupSize )
+      {
+      int slices[SliceReslicer< PixelType >::MaxSlicesPerPass];
+      unsigned char * rowOut[SliceReslicer< PixelType >::MaxSlicesPerPass];
+      for( int i=0; i<groupSize; ++i )
+        {
+        slices[i] = ( depth - groupSize ) / 2 + i;
+        }
+      const double grouped = callsPerSecond( [&]()
+        {
+        for( int k=0; k<sizeY; ++k )
+          {
+          for( int i=0; i<groupSize; ++i )
+            {
+            rowOut[i] = &( out[( i*sizeY + k )*sizeX] );
+            }
+          reslicer.resliceRowSlices( k, 0, sizeX-1, slices, groupSize,
+            rowOut );
+          }
+        }, mMinimumTime );
+      os << std::setw( 12 ) << 1000 / ( grouped * groupSize );
+      }
+    os << std::endl;
+    }
+}
+
+
+template <class TPixel>
+void
+RenderBenchmark<TPixel>::
+runBricks( std::ostream & os )
+{
+  const double dataMin = mStatistics.minimum();
+  const double dataMax = mStatistics.maximum();
+
+  const unsigned long * dimSize = mDimSize;
+  SliceReslicer< PixelType > reslicer;
+  this->setUpReslicer( reslicer, mImage->GetBufferPointer() );
+  reslicer.setImageMode( IMG_VAL );
+  reslicer.setIntensityWindow( dataMin + ( dataMax - dataMin ) / 4,
+    dataMax - ( dataMax - dataMin ) / 4, IW_MIN, IW_MAX );
+
+  const int orders[3][3] = { { 2, 1, 0 }, { 0, 2, 1 }, { 0, 1, 2 } };
+  const unsigned int brickSizes[4] = { 0, 16, 32, 64 };
+  const double flatSize = ( double )dimSize[0] * dimSize[1] * dimSize[2]
+    * sizeof( PixelType );
+
+  os << "Bricked volume (ms/frame)" << std::endl;
+  os << std::setw( 8 ) << "Brick" << std::setw( 12 ) << "Memory"
+    << std::setw( 10 ) << "X" << std::setw( 10 ) << "Y"
+    << std::setw( 10 ) << "Z" << std::endl;
+  for( int b=0; b<4; ++b )
+    {
+    BrickedVolume< PixelType > volume;
+    double memory = flatSize;
+    if( brickSizes[b] > 0 )
+      {
+      volume.build( mImage->GetBufferPointer(), dimSize, brickSizes[b] );
+      memory = volume.memorySize();
+      reslicer.setBrickedInput( &volume );
+      os << std::setw( 8 ) << brickSizes[b];
+      }
+    else
+      {
+      reslicer.setBrickedInput( NULL );
+      os << std::setw( 8 ) << "flat";
+      }
+    os << std::fixed << std::setprecision( 1 ) << std::setw( 11 )
+      << 100 * ( memory - flatSize ) / flatSize << "%";
+    for( int o=0; o<3; ++o )
+      {
+      const int * order = orders[o];
+      const int sizeX = ( int )dimSize[order[0]];
+      const int sizeY = ( int )dimSize[order[1]];
+      std::vector< unsigned char > out( sizeX * sizeY );
+      std::vector< unsigned short > zBuffer( sizeX * sizeY );
+      reslicer.setOrder( order );
+      reslicer.setSlice( ( int )dimSize[order[2]] / 2 );
+      reslicer.update();
+      const double frames = callsPerSecond( [&]()
+        {
+        reslicer.resliceRows( 0, sizeY-1, 0, sizeX-1, &( out[0] ),
+          &( zBuffer[0] ), sizeX );
+        }, mMinimumTime );
+      os << std::setw( 10 ) << std::setprecision( 2 ) << 1000 / frames;
+      }
+    os << std::endl;
+    }
+  reslicer.setBrickedInput( NULL );
+}
+
+
+template <class TPixel>
+void
+RenderBenchmark<TPixel>::
+runMip( std::ostream & os )
+{
+  const double dataMin = mStatistics.minimum();
+  const double dataMax = mStatistics.maximum();
+
+  const unsigned long * dimSize = mDimSize;
+  SliceReslicer< PixelType > reslicer;
+  this->setUpReslicer( reslicer, mImage->GetBufferPointer() );
+  reslicer.setImageMode( IMG_MIP );
+  reslicer.setIntensityWindow( dataMin + ( dataMax - dataMin ) / 4,
+    dataMax - ( dataMax - dataMin ) / 4, IW_MIN, IW_MAX );
+  MipProjector< PixelType > projector;
+  projector.setInput( mImage->GetBufferPointer(), dimSize );
+  itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+
+  const int orders[3][3] = { { 2, 1, 0 }, { 0, 2, 1 }, { 0, 1, 2 } };
+  const char * names[3] = { "X", "Y", "Z" };
+
+  os << "MIP (ms)" << std::endl;
+  os << std::setw( 8 ) << "Axis" << std::setw( 12 ) << "Project"
+    << std::setw( 12 ) << "Scan" << std::setw( 12 ) << "Re-map"
+    << std::endl;
+  for( int o=0; o<3; ++o )
+    {
+    const int * order = orders[o];
+    const int sizeX = ( int )dimSize[order[0]];
+    const int sizeY = ( int )dimSize[order[1]];
+    std::vector< unsigned char > out( sizeX * sizeY );
+    std::vector< unsigned short > zBuffer( sizeX * sizeY );
+    auto frame = [&]()
+      {
+      reslicer.resliceRows( 0, sizeY-1, 0, sizeX-1, &( out[0] ),
+        &( zBuffer[0] ), sizeX );
+      };
+    reslicer.setOrder( order );
+    reslicer.setMipProjector( NULL );
+    reslicer.update();
+    const double scan = callsPerSecond( frame, mMinimumTime );
+
+    const double project = callsPerSecond( [&]()
+      {
+      projector.clear();
+      projector.update( order[2], threader );
+      }, mMinimumTime );
+    reslicer.setMipProjector( &projector );
+    reslicer.update();
+    const double remap = callsPerSecond( frame, mMinimumTime );
+
+    os << std::setw( 8 ) << names[o] << std::fixed << std::setprecision( 2 )
+      << std::setw( 12 ) << 1000 / project << std::setw( 12 ) << 1000 / scan
+      << std::setw( 12 ) << 1000 / remap << std::endl;
+    }
+}
+
+
+template <class TPixel>
+void
+RenderBenchmark<TPixel>::
+runSlab( std::ostream & os )
+{
+  const double dataMin = mStatistics.minimum();
+  const double dataMax = mStatistics.maximum();
+
+  const unsigned long * dimSize = mDimSize;
+  const int order[3] = { 0, 1, 2 };
+  const int sizeX = ( int )dimSize[0];
+  const int sizeY = ( int )dimSize[1];
+  const int depth = ( int )dimSize[2];
+  SliceReslicer< PixelType > reslicer;
+  this->setUpReslicer( reslicer, mImage->GetBufferPointer() );
+  reslicer.setOrder( order );
+  reslicer.setSlabThickness( SlabThickness );
+  reslicer.setIntensityWindow( dataMin, dataMax, IW_MIN, IW_MAX );
+  SlabProjector< PixelType > projector;
+  projector.setInput( mImage->GetBufferPointer(), dimSize );
+  itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+  std::vector< unsigned char > out( sizeX * sizeY );
+  std::vector< unsigned short > zBuffer( sizeX * sizeY );
+
+  const ImageModeType modes[3] = { IMG_SLAB_MAX, IMG_SLAB_MIN,
+    IMG_SLAB_MEAN };
+  os << "Slab of " << ( int )SlabThickness << " slices, Z axis (ms)"
+    << std::endl;
+  os << std::setw( 10 ) << "Mode" << std::setw( 12 ) << "Project"
+    << std::setw( 12 ) << "Slide" << std::endl;
+  for( int m=0; m<3; ++m )
+    {
+    reslicer.setImageMode( modes[m] );
+    // Each frame scrolls one slice forward, wrapping at the last one
+    int slice = 0;
+    auto frame = [&]()
+      {
+      slice = ( slice + 1 ) % depth;
+      projector.update( order, slice, SlabThickness, modes[m], 0,
+        sizeX-1, 0, sizeY-1, threader );
+      reslicer.setSlice( slice );
+      reslicer.resliceRows( 0, sizeY-1, 0, sizeX-1, &( out[0] ),
+        &( zBuffer[0] ), sizeX );
+      };
+    reslicer.setSlabProjector( NULL );
+    reslicer.update();
+    const double project = callsPerSecond( [&]()
+      {
+      slice = ( slice + 1 ) % depth;
+      reslicer.setSlice( slice );
+      reslicer.resliceRows( 0, sizeY-1, 0, sizeX-1, &( out[0] ),
+        &( zBuffer[0] ), sizeX );
+      }, mMinimumTime );
+    reslicer.setSlabProjector( &projector );
+    reslicer.update();
+    const double slide = callsPerSecond( frame, mMinimumTime );
+
+    os << std::setw( 10 ) << ImageModeTypeName[modes[m]] << std::fixed
+      << std::setprecision( 2 ) << std::setw( 12 ) << 1000 / project
+      << std::setw( 12 ) << 1000 / slide << std::endl;
+    }
+}
+
+
+template class RenderBenchmark<unsigned char>;
+template class RenderBenchmark<short>;
+template class RenderBenchmark<unsigned short>;
+template class RenderBenchmark<float>;
+template class RenderBenchmark<double>;
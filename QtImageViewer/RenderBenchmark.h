@@ -0,0 +1,126 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __RenderBenchmark_h
+#define __RenderBenchmark_h
+
+// ImageViewer includes
+#include "ImageStatistics.h"
+#include "SliceVolume.h"
+
+// STD includes
+#include <memory>
+#include <ostream>
+
+/**
+* RenderBenchmarkBase : times the slice rendering kernels on an image and
+* reports their throughput.
+*
+* Run by ImageViewer --benchmark. create() returns the RenderBenchmark of
+* the pixel type of a volume, so the kernels and lookup tables the view
+* uses for that type are the ones timed. The image is only read.
+**/
+class RenderBenchmarkBase
+{
+public:
+  virtual ~RenderBenchmarkBase() {}
+
+  /*! New benchmark of the pixels of volume, or NULL if it is streamed */
+  static std::unique_ptr< RenderBenchmarkBase > create(
+    const SliceVolumeBase * volume );
+
+  /*! Minimum time, in seconds, spent on each measurement */
+  void setMinimumTime( double seconds )
+    {
+    mMinimumTime = seconds;
+    }
+
+  /*! Run all the benchmarks */
+  void run( std::ostream & os );
+
+  /*! Pixels/second of the window/level kernel for each instruction set
+  *   and each combination of IW modes */
+  virtual void runWindowLevel( std::ostream & os ) = 0;
+
+  /*! Frame time of each view orientation, row by row and with the tiled
+  *   gather, and of filling sagittal slices in groups */
+  virtual void runOrientations( std::ostream & os ) = 0;
+
+  /*! Memory used and frame time of each orientation when slices are
+  *   read from bricked copies of the image, against the image buffer */
+  virtual void runBricks( std::ostream & os ) = 0;
+
+  /*! Time of the parallel projection along each axis, and frame time
+  *   of IMG_MIP when re-mapping it against scanning the depth */
+  virtual void runMip( std::ostream & os ) = 0;
+
+  /*! Frame time of each slab mode when scrolling through a slab of
+  *   SlabThickness slices, sliding the projection against projecting
+  *   each slab */
+  virtual void runSlab( std::ostream & os ) = 0;
+
+  enum { SlabThickness = 15 };
+
+protected:
+  RenderBenchmarkBase( const SliceVolumeBase::ImageBaseType * image,
+    const ImageStatistics & statistics );
+
+  /*! Number of bytes of a pixel */
+  virtual size_t pixelSize() const = 0;
+
+  /*! Reslicer of the pixels, reading them through a lookup table when
+  *   the statistics allow it, as SliceVolume does */
+  template <class TPixel>
+  void setUpReslicer( SliceReslicer< TPixel > & reslicer,
+    const TPixel * buffer ) const;
+
+  unsigned long     mDimSize[3];
+  ImageStatistics   mStatistics;
+  double            mMinimumTime;
+};
+
+
+/**
+* RenderBenchmark : the RenderBenchmarkBase of an itk::Image< TPixel, 3 >.
+**/
+template <class TPixel>
+class RenderBenchmark : public RenderBenchmarkBase
+{
+public:
+  typedef TPixel                     PixelType;
+  typedef itk::Image< PixelType, 3 > ImageType;
+
+  RenderBenchmark( const ImageType * image,
+    const ImageStatistics & statistics );
+
+  virtual void runWindowLevel( std::ostream & os );
+  virtual void runOrientations( std::ostream & os );
+  virtual void runBricks( std::ostream & os );
+  virtual void runMip( std::ostream & os );
+  virtual void runSlab( std::ostream & os );
+
+protected:
+  virtual size_t pixelSize() const;
+
+  typename ImageType::ConstPointer mImage;
+};
+
+#endif
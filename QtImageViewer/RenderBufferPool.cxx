@@ -0,0 +1,150 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "RenderBufferPool.h"
+
+// STD includes
+#include <cstdlib>
+#include <new>
+
+
+RenderBufferPool::
+RenderBufferPool( size_t maxFreeBytes )
+{
+  mMaxFreeBytes = maxFreeBytes;
+  mUsedBytes = 0;
+  mFreeBytes = 0;
+}
+
+
+RenderBufferPool::
+~RenderBufferPool()
+{
+  this->clear();
+  for( auto & used : mUsed )
+    {
+    std::free( used.first );
+    }
+}
+
+
+void *
+RenderBufferPool::
+allocate( size_t bytes )
+{
+  bytes = ( ( bytes + PageSize - 1 ) / PageSize ) * PageSize;
+  if( bytes == 0 )
+    {
+    bytes = PageSize;
+    }
+
+  // Smallest kept block that fits without wasting half of it
+  size_t best = mFree.size();
+  for( size_t i=0; i<mFree.size(); ++i )
+    {
+    if( mFree[i].bytes >= bytes && mFree[i].bytes / 2 < bytes
+      && ( best == mFree.size() || mFree[i].bytes < mFree[best].bytes ) )
+      {
+      best = i;
+      }
+    }
+  Block block;
+  if( best < mFree.size() )
+    {
+    block = mFree[best];
+    mFree[best] = mFree.back();
+    mFree.pop_back();
+    mFreeBytes -= block.bytes;
+    }
+  else
+    {
+    block.bytes = bytes;
+    block.data = std::malloc( bytes );
+    if( block.data == NULL )
+      {
+      // Give the kept blocks back to the system and retry once
+      this->clear();
+      block.data = std::malloc( bytes );
+      if( block.data == NULL )
+        {
+        throw std::bad_alloc();
+        }
+      }
+    }
+  mUsed[block.data] = block.bytes;
+  mUsedBytes += block.bytes;
+  return block.data;
+}
+
+
+void
+RenderBufferPool::
+release( void * data )
+{
+  if( data == NULL )
+    {
+    return;
+    }
+  auto used = mUsed.find( data );
+  if( used == mUsed.end() )
+    {
+    return;
+    }
+  Block block;
+  block.data = data;
+  block.bytes = used->second;
+  mUsed.erase( used );
+  mUsedBytes -= block.bytes;
+  mFree.push_back( block );
+  mFreeBytes += block.bytes;
+  this->shrink( mMaxFreeBytes );
+}
+
+
+void
+RenderBufferPool::
+clear()
+{
+  this->shrink( 0 );
+}
+
+
+void
+RenderBufferPool::
+shrink( size_t maxFreeBytes )
+{
+  while( mFreeBytes > maxFreeBytes )
+    {
+    size_t largest = 0;
+    for( size_t i=1; i<mFree.size(); ++i )
+      {
+      if( mFree[i].bytes > mFree[largest].bytes )
+        {
+        largest = i;
+        }
+      }
+    std::free( mFree[largest].data );
+    mFreeBytes -= mFree[largest].bytes;
+    mFree[largest] = mFree.back();
+    mFree.pop_back();
+    }
+}
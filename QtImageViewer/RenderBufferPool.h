@@ -0,0 +1,94 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __RenderBufferPool_h
+#define __RenderBufferPool_h
+
+// STD includes
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+/**
+* RenderBufferPool : recycles the memory of the window buffers, which are
+* reallocated whenever the extent of the rendered slice changes.
+*
+* Released blocks are kept, up to a memory budget, and handed out again
+* to requests they fit without wasting more than half of the block, so
+* zooming back and forth reuses the same few blocks instead of returning
+* large allocations to the system and faulting their pages in again.
+* Sizes are rounded up to whole pages so that close sizes share blocks.
+*
+* The pool is not thread-safe; it is used by the GUI thread only.
+**/
+class RenderBufferPool
+{
+public:
+  enum { PageSize = 4096 };
+
+  /*! Keep at most maxFreeBytes of released blocks */
+  explicit RenderBufferPool( size_t maxFreeBytes );
+  ~RenderBufferPool();
+
+  /*! A block of at least bytes bytes, suitably aligned for any type */
+  void * allocate( size_t bytes );
+
+  /*! Return a block obtained from allocate(). NULL is ignored. */
+  void release( void * block );
+
+  /*! Typed helpers for count elements of T */
+  template <class T>
+  T * allocate( size_t count )
+    {
+    return static_cast< T * >( this->allocate( count * sizeof( T ) ) );
+    }
+
+  /*! Bytes of the blocks in use and of the blocks kept for reuse */
+  size_t usedBytes() const
+    {
+    return mUsedBytes;
+    }
+  size_t freeBytes() const
+    {
+    return mFreeBytes;
+    }
+
+  /*! Free the blocks kept for reuse */
+  void clear();
+
+protected:
+  struct Block
+    {
+    void * data;
+    size_t bytes;
+    };
+
+  /*! Free the largest kept blocks until they fit maxFreeBytes */
+  void shrink( size_t maxFreeBytes );
+
+  size_t                               mMaxFreeBytes;
+  size_t                               mUsedBytes;
+  size_t                               mFreeBytes;
+  std::vector< Block >                 mFree;
+  std::unordered_map< void *, size_t > mUsed;
+};
+
+#endif
@@ -0,0 +1,315 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "SlabProjector.h"
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+template <class TPixel>
+SlabProjector<TPixel>::
+SlabProjector()
+{
+  mBuffer = NULL;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = 0;
+    mImageStride[i] = 0;
+    mOrder[i] = i;
+    }
+  mValid = false;
+  mSlice = 0;
+  mThickness = 1;
+  mMode = IMG_SLAB_MAX;
+  mStartJ = 0;
+  mEndJ = -1;
+  mStartK = 0;
+  mEndK = -1;
+  mWidth = 0;
+  mFirst = 0;
+  mLast = -1;
+}
+
+
+template <class TPixel>
+void
+SlabProjector<TPixel>::
+setInput( const PixelType * buffer, const unsigned long dimSize[3] )
+{
+  mBuffer = buffer;
+  mImageStride[0] = 1;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = dimSize[i];
+    if( i > 0 )
+      {
+      mImageStride[i] = mImageStride[i-1] * ( long )dimSize[i-1];
+      }
+    }
+  this->clear();
+}
+
+
+template <class TPixel>
+void
+SlabProjector<TPixel>::
+clear()
+{
+  mValid = false;
+}
+
+
+template <class TPixel>
+void
+SlabProjector<TPixel>::
+slabRange( int slice, int thickness, int depth, int & first, int & last )
+{
+  first = slice - ( thickness - 1 ) / 2;
+  last = first + thickness - 1;
+  first = std::max( first, 0 );
+  last = std::min( last, depth - 1 );
+}
+
+
+template <class TPixel>
+bool
+SlabProjector<TPixel>::
+isProjected( const int order[3], int slice, int thickness,
+  ImageModeType mode, int k, int startJ, int endJ ) const
+{
+  return mValid && order[0] == mOrder[0] && order[1] == mOrder[1]
+    && order[2] == mOrder[2] && slice == mSlice && thickness == mThickness
+    && mode == mMode && k >= mStartK && k <= mEndK && startJ >= mStartJ
+    && endJ <= mEndJ;
+}
+
+
+template <class TPixel>
+void
+SlabProjector<TPixel>::
+update( const int order[3], int slice, int thickness, ImageModeType mode,
+  int startJ, int endJ, int startK, int endK,
+  itk::MultiThreaderBase * threader )
+{
+  if( mBuffer == NULL || endJ < startJ || endK < startK )
+    {
+    return;
+    }
+  thickness = std::max( thickness, 1 );
+  int first;
+  int last;
+  slabRange( slice, thickness, ( int )mDimSize[order[2]], first, last );
+
+  const bool sameSlab = mValid && order[0] == mOrder[0]
+    && order[1] == mOrder[1] && order[2] == mOrder[2]
+    && thickness == mThickness && mode == mMode && startJ == mStartJ
+    && endJ == mEndJ && startK == mStartK && endK == mEndK;
+  if( sameSlab && first == mFirst && last == mLast )
+    {
+    mSlice = slice;
+    return;
+    }
+
+  // Slide if the slab only moved along the slice axis, by less than its
+  //   thickness
+  bool rebuild = !sameSlab;
+  bool forward = true;
+  if( sameSlab )
+    {
+    forward = first >= mFirst && last >= mLast;
+    const bool backward = first <= mFirst && last <= mLast;
+    const bool overlap = first <= mLast && last >= mFirst;
+    rebuild = !overlap || !( forward || backward );
+    }
+
+  const int previousFirst = mFirst;
+  const int previousLast = mLast;
+  for( int i=0; i<3; ++i )
+    {
+    mOrder[i] = order[i];
+    }
+  mSlice = slice;
+  mThickness = thickness;
+  mMode = mode;
+  mStartJ = startJ;
+  mEndJ = endJ;
+  mStartK = startK;
+  mEndK = endK;
+  mWidth = endJ - startJ + 1;
+  mFirst = first;
+  mLast = last;
+  if( rebuild )
+    {
+    const size_t numberOfPixels = ( size_t )mWidth * ( endK - startK + 1 );
+    mValue.resize( numberOfPixels );
+    mDepth.resize( numberOfPixels );
+    if( mode == IMG_SLAB_MEAN )
+      {
+      mSum.resize( numberOfPixels );
+      mNonFinite.resize( numberOfPixels );
+      }
+    }
+
+  auto projectRow = [&]( itk::SizeValueType row )
+    {
+    this->projectRow( startK + ( int )row, rebuild, forward, previousFirst,
+      previousLast );
+    };
+  const int numberOfRows = endK - startK + 1;
+  if( threader != NULL && numberOfRows > 1 )
+    {
+    threader->ParallelizeArray( 0, numberOfRows, projectRow, nullptr );
+    }
+  else
+    {
+    for( int row=0; row<numberOfRows; ++row )
+      {
+      projectRow( row );
+      }
+    }
+  mValid = true;
+}
+
+
+template <class TPixel>
+void
+SlabProjector<TPixel>::
+projectRow( int k, bool rebuild, bool forward, int previousFirst,
+  int previousLast )
+{
+  const long strideJ = mImageStride[mOrder[0]];
+  const long strideL = mImageStride[mOrder[2]];
+  const int first = mFirst;
+  const int last = mLast;
+  const bool isMax = ( mMode == IMG_SLAB_MAX );
+  const double empty = isMax ? -std::numeric_limits< double >::infinity()
+    : std::numeric_limits< double >::infinity();
+  long i = ( long )( k - mStartK ) * mWidth;
+  const PixelType * ray = mBuffer + mStartJ * strideJ
+    + k * mImageStride[mOrder[1]];
+  for( int j=mStartJ; j<=mEndJ; ++j, ++i, ray+=strideJ )
+    {
+    if( mMode == IMG_SLAB_MEAN )
+      {
+      double & sum = mSum[i];
+      int & nonFinite = mNonFinite[i];
+      auto add = [&]( int from, int to, double sign )
+        {
+        for( int l=from; l<=to; ++l )
+          {
+          const double v = ( double )ray[l * strideL];
+          if( std::isfinite( v ) )
+            {
+            sum += sign * v;
+            }
+          else
+            {
+            nonFinite += ( sign > 0 ) ? 1 : -1;
+            }
+          }
+        };
+      if( rebuild )
+        {
+        sum = 0;
+        nonFinite = 0;
+        add( first, last, 1 );
+        }
+      else
+        {
+        add( previousFirst, std::min( previousLast, first - 1 ), -1 );
+        add( std::max( previousFirst, last + 1 ), previousLast, -1 );
+        add( first, std::min( last, previousFirst - 1 ), 1 );
+        add( std::max( first, previousLast + 1 ), last, 1 );
+        }
+      double mean = sum;
+      if( nonFinite > 0 )
+        {
+        mean = 0;
+        for( int l=first; l<=last; ++l )
+          {
+          mean += ( double )ray[l * strideL];
+          }
+        }
+      mValue[i] = mean / ( last - first + 1 );
+      mDepth[i] = ( unsigned short )mSlice;
+      continue;
+      }
+
+    // The extremum only has to be searched for again when its slice left
+    //   the slab; otherwise the entering slices are compared to it. Ties
+    //   keep the lowest slice, as a scan by increasing slices does.
+    double & m = mValue[i];
+    unsigned short & z = mDepth[i];
+    if( rebuild || ( forward ? z < first : z > last ) )
+      {
+      m = empty;
+      z = ( unsigned short )first;
+      for( int l=first; l<=last; ++l )
+        {
+        const double v = ( double )ray[l * strideL];
+        if( isMax ? v > m : v < m )
+          {
+          m = v;
+          z = ( unsigned short )l;
+          }
+        }
+      }
+    else if( forward )
+      {
+      for( int l=previousLast+1; l<=last; ++l )
+        {
+        const double v = ( double )ray[l * strideL];
+        if( isMax ? v > m : v < m )
+          {
+          m = v;
+          z = ( unsigned short )l;
+          }
+        }
+      }
+    else
+      {
+      for( int l=previousFirst-1; l>=first; --l )
+        {
+        const double v = ( double )ray[l * strideL];
+        if( v != empty && ( isMax ? v >= m : v <= m ) )
+          {
+          m = v;
+          z = ( unsigned short )l;
+          }
+        }
+      }
+    if( m == empty )
+      {
+      z = ( unsigned short )first;
+      }
+    }
+}
+
+
+template class SlabProjector<unsigned char>;
+template class SlabProjector<short>;
+template class SlabProjector<unsigned short>;
+template class SlabProjector<float>;
+template class SlabProjector<double>;
@@ -0,0 +1,127 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __SlabProjector_h
+#define __SlabProjector_h
+
+// ImageViewer includes
+#include "QtGlSliceView.h"
+
+// ITK includes
+#include "itkMultiThreaderBase.h"
+
+// STD includes
+#include <vector>
+
+/**
+* SlabProjector : maximum, minimum or mean of the slices of a slab
+* centered on the current slice, for the window rows and columns shown.
+*
+* When the slab moves along the slice axis by less than its thickness,
+* the projection slides instead of being computed again: the mean adds
+* the slices entering the slab and subtracts those leaving it, and the
+* maximum and minimum compare the entering slices to the current
+* extremum, searching the slab again only for the pixels whose extremum
+* left it. Changing the orientation, the window range, the thickness or
+* the mode, or jumping beyond the slab, rebuilds the projection.
+*
+* The results match a scan of the slab by increasing slices: NaN voxels
+* are ignored by the maximum and minimum, ties keep the lowest slice, and
+* mean pixels whose slab holds a non-finite voxel are summed again from
+* the image. The sliding sum of non-integer data may differ from summing
+* the slab in order by rounding.
+**/
+template <class TPixel>
+class SlabProjector
+{
+public:
+  typedef TPixel PixelType;
+
+  SlabProjector();
+
+  /*! Specify the x-fastest pixel buffer and its size */
+  void setInput( const PixelType * buffer, const unsigned long dimSize[3] );
+
+  /*! Drop the projection, e.g., after the pixels changed in place */
+  void clear();
+
+  /*! First and last slices of the slab of thickness slices around slice,
+  *   clipped to [0, depth-1] */
+  static void slabRange( int slice, int thickness, int depth, int & first,
+    int & last );
+
+  /*! Project the slab of thickness slices around slice, in mode
+  *   IMG_SLAB_MAX, IMG_SLAB_MIN or IMG_SLAB_MEAN, over the window columns
+  *   startJ to endJ and rows startK to endK of the axis order */
+  void update( const int order[3], int slice, int thickness,
+    ImageModeType mode, int startJ, int endJ, int startK, int endK,
+    itk::MultiThreaderBase * threader );
+
+  /*! True if the projection holds columns startJ to endJ of row k of
+  *   this slab */
+  bool isProjected( const int order[3], int slice, int thickness,
+    ImageModeType mode, int k, int startJ, int endJ ) const;
+
+  /*! Projected values of columns startJ.. of window row k */
+  const double * value( int k, int startJ ) const
+    {
+    return &( mValue[( k - mStartK ) * mWidth + startJ - mStartJ] );
+    }
+
+  /*! Slice of the maximum or minimum of columns startJ.. of row k */
+  const unsigned short * depth( int k, int startJ ) const
+    {
+    return &( mDepth[( k - mStartK ) * mWidth + startJ - mStartJ] );
+    }
+
+protected:
+  /*! Rebuild, or slide forward or backward, the pixels of window row k
+  *   from the previous slab [previousFirst, previousLast] */
+  void projectRow( int k, bool rebuild, bool forward, int previousFirst,
+    int previousLast );
+
+  const PixelType *  mBuffer;
+  unsigned long      mDimSize[3];
+  long               mImageStride[3];
+
+  /* the slab projected */
+  bool               mValid;
+  int                mOrder[3];
+  int                mSlice;
+  int                mThickness;
+  ImageModeType      mMode;
+  int                mStartJ;
+  int                mEndJ;
+  int                mStartK;
+  int                mEndK;
+  int                mWidth;
+  int                mFirst;
+  int                mLast;
+
+  std::vector< double >         mValue;
+  std::vector< unsigned short > mDepth;
+
+  /* IMG_SLAB_MEAN: sum of the finite voxels and count of the others */
+  std::vector< double >         mSum;
+  std::vector< int >            mNonFinite;
+};
+
+#endif
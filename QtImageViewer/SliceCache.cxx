@@ -0,0 +1,214 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "SliceCache.h"
+
+// STD includes
+#include <cstring>
+#include <functional>
+
+
+size_t
+SliceCache::KeyHash::
+operator()( const ImageLayerKey & key ) const
+{
+  size_t h = std::hash< const void * >()( key.image );
+  auto combine = [&h]( size_t v )
+    {
+    h ^= v + 0x9e3779b9 + ( h << 6 ) + ( h >> 2 );
+    };
+  combine( key.generation );
+  combine( key.region.order[0] + 3 * key.region.order[1] );
+  combine( key.region.slice );
+  combine( key.region.imageMode );
+  combine( key.region.slabThickness );
+  combine( key.region.level );
+  combine( key.region.startX );
+  combine( key.region.startY );
+  combine( key.region.endX );
+  combine( key.region.endY );
+  combine( std::hash< double >()( key.iwMin ) );
+  combine( std::hash< double >()( key.iwMax ) );
+  combine( key.iwModeMin + 3 * key.iwModeMax );
+  return h;
+}
+
+
+SliceCache::
+SliceCache()
+{
+  mMemoryBudget = 0;
+  mMemoryUsed = 0;
+}
+
+
+size_t
+SliceCache::
+memoryBudget() const
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  return mMemoryBudget;
+}
+
+
+size_t
+SliceCache::
+memoryUsed() const
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  return mMemoryUsed;
+}
+
+
+size_t
+SliceCache::
+numberOfSlices() const
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  return mEntries.size();
+}
+
+
+void
+SliceCache::
+setMemoryBudget( size_t bytes )
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  mMemoryBudget = bytes;
+  this->shrink( mMemoryBudget );
+}
+
+
+bool
+SliceCache::
+fetch( const ImageLayerKey & key, unsigned char * image,
+  unsigned short * zBuffer, size_t numberOfPixels )
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  EntryMapType::iterator it = mIndex.find( key );
+  if( it == mIndex.end() || it->second->image.size() != numberOfPixels )
+    {
+    return false;
+    }
+
+  // Move the entry to the front of the list
+  mEntries.splice( mEntries.begin(), mEntries, it->second );
+  const Entry & entry = mEntries.front();
+  memcpy( image, entry.image.data(), numberOfPixels );
+  if( !entry.zBuffer.empty() )
+    {
+    memcpy( zBuffer, entry.zBuffer.data(),
+      numberOfPixels * sizeof( unsigned short ) );
+    }
+  return true;
+}
+
+
+bool
+SliceCache::
+contains( const ImageLayerKey & key, size_t numberOfPixels ) const
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  EntryMapType::const_iterator it = mIndex.find( key );
+  return it != mIndex.end() && it->second->image.size() == numberOfPixels;
+}
+
+
+void
+SliceCache::
+store( const ImageLayerKey & key, const unsigned char * image,
+  const unsigned short * zBuffer, size_t numberOfPixels )
+{
+  const size_t size = numberOfPixels
+    * ( imageModeHasDepth( key.region.imageMode )
+      ? 1 + sizeof( unsigned short ) : 1 );
+  std::lock_guard< std::mutex > lock( mMutex );
+  if( size > mMemoryBudget )
+    {
+    return;
+    }
+
+  EntryMapType::iterator it = mIndex.find( key );
+  if( it != mIndex.end() )
+    {
+    mMemoryUsed -= it->second->size();
+    mEntries.erase( it->second );
+    mIndex.erase( it );
+    }
+  this->shrink( mMemoryBudget - size );
+
+  mEntries.push_front( Entry() );
+  Entry & entry = mEntries.front();
+  entry.key = key;
+  entry.image.assign( image, image + numberOfPixels );
+  if( imageModeHasDepth( key.region.imageMode ) )
+    {
+    entry.zBuffer.assign( zBuffer, zBuffer + numberOfPixels );
+    }
+  mMemoryUsed += entry.size();
+  mIndex[key] = mEntries.begin();
+}
+
+
+void
+SliceCache::
+removeSlices( const std::vector< unsigned char > & slices )
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  EntryListType::iterator it = mEntries.begin();
+  while( it != mEntries.end() )
+    {
+    const SliceRenderRegion & region = it->key.region;
+    if( region.order[2] == 2 && !slices[region.slice] )
+      {
+      ++it;
+      continue;
+      }
+    mMemoryUsed -= it->size();
+    mIndex.erase( it->key );
+    it = mEntries.erase( it );
+    }
+}
+
+
+void
+SliceCache::
+clear()
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  mEntries.clear();
+  mIndex.clear();
+  mMemoryUsed = 0;
+}
+
+
+void
+SliceCache::
+shrink( size_t budget )
+{
+  while( mMemoryUsed > budget && !mEntries.empty() )
+    {
+    mMemoryUsed -= mEntries.back().size();
+    mIndex.erase( mEntries.back().key );
+    mEntries.pop_back();
+    }
+}
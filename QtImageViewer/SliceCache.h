@@ -0,0 +1,113 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __SliceCache_h
+#define __SliceCache_h
+
+// ImageViewer includes
+#include "QtGlSliceView.h"
+
+// STD includes
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+* SliceCache : least recently used cache of rendered grayscale window
+* buffers.
+*
+* Entries are keyed by the ImageLayerKey they were rendered from, which
+* holds the orientation, slice, window range, image mode and intensity
+* window, so a hit can be copied to the window buffer as is. The depth
+* buffer is kept with the slices of the modes that have one (see
+* imageModeHasDepth()). The least recently used entries are dropped when
+* the cache grows beyond its memory budget.
+*
+* The cache is shared with the SlicePrefetcher worker, so every method
+* locks it.
+**/
+class SliceCache
+{
+public:
+  SliceCache();
+
+  /*! Maximum number of bytes held by the cache. 0 disables it. */
+  void setMemoryBudget( size_t bytes );
+  size_t memoryBudget() const;
+  size_t memoryUsed() const;
+  size_t numberOfSlices() const;
+
+  /*! Copy the slice rendered for key into image and, for the modes with
+  *   a depth buffer, zBuffer. Returns false if it is not cached. */
+  bool fetch( const ImageLayerKey & key, unsigned char * image,
+    unsigned short * zBuffer, size_t numberOfPixels );
+
+  /*! Cache a rendered window buffer of numberOfPixels pixels */
+  void store( const ImageLayerKey & key, const unsigned char * image,
+    const unsigned short * zBuffer, size_t numberOfPixels );
+
+  bool contains( const ImageLayerKey & key, size_t numberOfPixels ) const;
+
+  /*! Drop the slices that cross one of the image slices along z flagged
+  *   in slices: the axial slices flagged, and all the slices of the
+  *   other orientations. */
+  void removeSlices( const std::vector< unsigned char > & slices );
+
+  void clear();
+
+protected:
+  struct Entry
+    {
+    ImageLayerKey                 key;
+    std::vector< unsigned char >  image;
+    std::vector< unsigned short > zBuffer;
+
+    size_t size() const
+      {
+      return image.size() + zBuffer.size() * sizeof( unsigned short );
+      }
+    };
+
+  struct KeyHash
+    {
+    size_t operator()( const ImageLayerKey & key ) const;
+    };
+
+  typedef std::list< Entry > EntryListType;
+  typedef std::unordered_map< ImageLayerKey, EntryListType::iterator,
+    KeyHash > EntryMapType;
+
+  /*! Drop the least recently used entries until the cache fits.
+  *   The caller holds mMutex. */
+  void shrink( size_t budget );
+
+  size_t        mMemoryBudget;
+  size_t        mMemoryUsed;
+
+  /* most recently used first */
+  EntryListType mEntries;
+  EntryMapType  mIndex;
+
+  mutable std::mutex mMutex;
+};
+
+#endif
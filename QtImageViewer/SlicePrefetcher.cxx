@@ -0,0 +1,230 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "SlicePrefetcher.h"
+#include "SliceCache.h"
+
+// STD includes
+#include <algorithm>
+
+
+SlicePrefetcher::
+SlicePrefetcher( SliceCache * cache )
+: mGeneration( 0 )
+{
+  mCache = cache;
+  mNumberOfSlices = 8;
+  mStep = 0;
+  mDimSize = 0;
+  mWinDataSizeX = 0;
+  mNumberOfPixels = 0;
+  mPending = false;
+  mBusy = false;
+  mStop = false;
+  mThread = std::thread( &SlicePrefetcher::run, this );
+}
+
+
+SlicePrefetcher::
+~SlicePrefetcher()
+{
+  ++mGeneration;
+    {
+    std::lock_guard< std::mutex > lock( mMutex );
+    mStop = true;
+    }
+  mCondition.notify_all();
+  mThread.join();
+}
+
+
+void
+SlicePrefetcher::
+setNumberOfSlices( unsigned int numberOfSlices )
+{
+  std::lock_guard< std::mutex > lock( mMutex );
+  mNumberOfSlices = numberOfSlices;
+}
+
+
+void
+SlicePrefetcher::
+prefetch( const ReslicerType & reslicer, const ImageLayerKey & key,
+  int step, int dimSize, int winDataSizeX, size_t numberOfPixels )
+{
+  ++mGeneration;
+    {
+    std::lock_guard< std::mutex > lock( mMutex );
+    if( mNumberOfSlices == 0 || step == 0 )
+      {
+      mPending = false;
+      return;
+      }
+    mReslicer.reset( reslicer.clone() );
+    mKey = key;
+    mStep = step;
+    mDimSize = dimSize;
+    mWinDataSizeX = winDataSizeX;
+    mNumberOfPixels = numberOfPixels;
+    mPending = true;
+    }
+  mCondition.notify_all();
+}
+
+
+void
+SlicePrefetcher::
+cancel()
+{
+  ++mGeneration;
+  std::lock_guard< std::mutex > lock( mMutex );
+  mPending = false;
+}
+
+
+void
+SlicePrefetcher::
+waitForIdle()
+{
+  std::unique_lock< std::mutex > lock( mMutex );
+  mCondition.wait( lock, [this]() { return !mBusy && !mPending; } );
+}
+
+
+void
+SlicePrefetcher::
+run()
+{
+  std::unique_lock< std::mutex > lock( mMutex );
+  while( true )
+    {
+    mBusy = false;
+    mCondition.notify_all();
+    mCondition.wait( lock, [this]() { return mStop || mPending; } );
+    if( mStop )
+      {
+      return;
+      }
+    mPending = false;
+    mBusy = true;
+
+    // Work on a copy of the request, so prefetch() can replace it
+    const unsigned long generation = mGeneration;
+    std::unique_ptr< ReslicerType > reslicer( mReslicer->clone() );
+    const ImageLayerKey baseKey = mKey;
+    const int step = mStep;
+    const int dimSize = mDimSize;
+    const int winDataSizeX = mWinDataSizeX;
+    const size_t numberOfPixels = mNumberOfPixels;
+    const int numberOfSlices = static_cast< int >( mNumberOfSlices );
+    lock.unlock();
+
+    // When the slice axis is the image x axis, neighboring slices share
+    //   cache lines, so they are filled together
+    const int groupSize = ( reslicer->mapsVoxels()
+      && reslicer->sliceStride() == 1 ) ? ReslicerType::MaxSlicesPerPass : 1;
+    std::vector< ImageLayerKey > keys;
+    for( int i=1; i<=numberOfSlices; ++i )
+      {
+      ImageLayerKey key = baseKey;
+      key.region.slice = baseKey.region.slice + i * step;
+      const bool inside = key.region.slice >= 0
+        && key.region.slice < dimSize;
+      if( inside && !mCache->contains( key, numberOfPixels ) )
+        {
+        keys.push_back( key );
+        }
+      if( !keys.empty() && ( !inside || i == numberOfSlices
+        || ( int )keys.size() == groupSize ) )
+        {
+        if( !this->render( *reslicer, keys, winDataSizeX, numberOfPixels,
+            generation ) )
+          {
+          break;
+          }
+        keys.clear();
+        }
+      if( !inside )
+        {
+        break;
+        }
+      }
+
+    lock.lock();
+    }
+}
+
+
+bool
+SlicePrefetcher::
+render( ReslicerType & reslicer, const std::vector< ImageLayerKey > & keys,
+  int winDataSizeX, size_t numberOfPixels, unsigned long generation )
+{
+  const int numberOfSlices = static_cast< int >( keys.size() );
+  int slices[ReslicerType::MaxSlicesPerPass];
+  unsigned char * out[ReslicerType::MaxSlicesPerPass];
+  mImage.resize( numberOfSlices * numberOfPixels );
+  mZBuffer.resize( numberOfPixels );
+  for( int i=0; i<numberOfSlices; ++i )
+    {
+    slices[i] = keys[i].region.slice;
+    }
+  reslicer.setSlice( slices[0] );
+
+  const SliceRenderRegion & region = keys[0].region;
+  const int blockRows = ReslicerType::TileRows;
+  for( int k=region.startY; k <= region.endY; k+=blockRows )
+    {
+    if( mGeneration != generation )
+      {
+      return false;
+      }
+    const int endK = std::min( k + blockRows - 1, region.endY );
+    const int rowOffset = ( k-region.startY )*winDataSizeX;
+    if( numberOfSlices == 1 )
+      {
+      reslicer.resliceRows( k, endK, region.startX, region.endX,
+        &( mImage[rowOffset] ), &( mZBuffer[rowOffset] ), winDataSizeX );
+      continue;
+      }
+    for( int row=k; row <= endK; row++ )
+      {
+      for( int i=0; i<numberOfSlices; ++i )
+        {
+        out[i] = &( mImage[i*numberOfPixels + rowOffset] )
+          + ( row-k )*winDataSizeX;
+        }
+      reslicer.resliceRowSlices( row, region.startX, region.endX, slices,
+        numberOfSlices, out );
+      }
+    }
+  if( mGeneration != generation )
+    {
+    return false;
+    }
+  for( int i=0; i<numberOfSlices; ++i )
+    {
+    mCache->store( keys[i], &( mImage[i*numberOfPixels] ),
+      &( mZBuffer[0] ), numberOfPixels );
+    }
+  return true;
+}
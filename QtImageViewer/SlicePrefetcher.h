@@ -0,0 +1,112 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __SlicePrefetcher_h
+#define __SlicePrefetcher_h
+
+// ImageViewer includes
+#include "QtGlSliceView.h"
+#include "SliceReslicer.h"
+
+// STD includes
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SliceCache;
+
+/**
+* SlicePrefetcher : renders the slices ahead of the scroll direction on a
+* worker thread and stores them in a SliceCache.
+*
+* Each call to prefetch() replaces the pending request: the worker takes
+* a clone of the configured reslicer, then renders the slices
+* slice + step, slice + 2 * step, ... that are not already cached. A
+* request is abandoned, between rows, as soon as it is replaced or
+* cancelled, so stale frames never reach the cache.
+**/
+class SlicePrefetcher
+{
+public:
+  typedef SliceReslicerBase ReslicerType;
+
+  explicit SlicePrefetcher( SliceCache * cache );
+  ~SlicePrefetcher();
+
+  /*! Number of slices rendered ahead. 0 disables the prefetching. */
+  void setNumberOfSlices( unsigned int numberOfSlices );
+  unsigned int numberOfSlices() const
+    {
+    return mNumberOfSlices;
+    }
+
+  /*! Render the slices following key.region.slice by multiples of step.
+  *   reslicer must be configured for key, and dimSize is the size of the
+  *   slice axis. The window buffers have winDataSizeX columns and
+  *   numberOfPixels pixels. */
+  void prefetch( const ReslicerType & reslicer, const ImageLayerKey & key,
+    int step, int dimSize, int winDataSizeX, size_t numberOfPixels );
+
+  /*! Drop the pending request */
+  void cancel();
+
+  /*! Block until the worker no longer reads the image. Call it after
+  *   cancel() and before the image buffer is released. */
+  void waitForIdle();
+
+protected:
+  void run();
+
+  /*! Render the slices of keys, which differ only by their slice, and
+  *   store them in the cache. Returns false if the request was replaced. */
+  bool render( ReslicerType & reslicer,
+    const std::vector< ImageLayerKey > & keys, int winDataSizeX,
+    size_t numberOfPixels, unsigned long generation );
+
+  SliceCache *              mCache;
+  unsigned int              mNumberOfSlices;
+
+  /* the pending request, guarded by mMutex */
+  std::unique_ptr< ReslicerType > mReslicer;
+  ImageLayerKey             mKey;
+  int                       mStep;
+  int                       mDimSize;
+  int                       mWinDataSizeX;
+  size_t                    mNumberOfPixels;
+  bool                      mPending;
+  bool                      mBusy;
+  bool                      mStop;
+
+  std::atomic< unsigned long > mGeneration;
+
+  /* window buffers of the worker, one image per slice of a group */
+  std::vector< unsigned char >  mImage;
+  std::vector< unsigned short > mZBuffer;
+
+  std::mutex                mMutex;
+  std::condition_variable   mCondition;
+  std::thread               mThread;
+};
+
+#endif
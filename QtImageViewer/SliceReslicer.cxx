@@ -0,0 +1,1063 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "SliceReslicer.h"
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+
+SliceReslicerBase::
+SliceReslicerBase()
+{
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = 0;
+    mImageStride[i] = 0;
+    mOrder[i] = i;
+    mStride[i] = 0;
+    }
+  mSlice = 0;
+  mSlabThickness = 1;
+  mImageMode = IMG_VAL;
+  mIWMin = 0;
+  mIWMax = 1;
+  mIWModeMin = IW_MIN;
+  mIWModeMax = IW_MAX;
+  mModified = true;
+  mUseLookupTable = false;
+}
+
+
+void
+SliceReslicerBase::
+setDimSize( const unsigned long dimSize[3] )
+{
+  mImageStride[0] = 1;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = dimSize[i];
+    if( i > 0 )
+      {
+      mImageStride[i] = mImageStride[i-1] * ( long )dimSize[i-1];
+      }
+    }
+  this->setOrder( mOrder );
+  mModified = true;
+}
+
+
+void
+SliceReslicerBase::
+setSlabThickness( int thickness )
+{
+  thickness = std::max( thickness, 1 );
+  if( mSlabThickness != thickness )
+    {
+    mSlabThickness = thickness;
+    mModified = true;
+    }
+}
+
+
+void
+SliceReslicerBase::
+setOrder( const int order[3] )
+{
+  for( int i=0; i<3; ++i )
+    {
+    if( mOrder[i] != order[i] )
+      {
+      mOrder[i] = order[i];
+      mModified = true;
+      }
+    mStride[i] = mImageStride[mOrder[i]];
+    }
+}
+
+
+void
+SliceReslicerBase::
+setSlice( int slice )
+{
+  mSlice = slice;
+}
+
+
+void
+SliceReslicerBase::
+setImageMode( ImageModeType mode )
+{
+  if( mImageMode != mode )
+    {
+    mImageMode = mode;
+    mModified = true;
+    }
+}
+
+
+void
+SliceReslicerBase::
+setIntensityWindow( double iwMin, double iwMax, IWModeType iwModeMin,
+  IWModeType iwModeMax )
+{
+  if( mIWMin != iwMin || mIWMax != iwMax || mIWModeMin != iwModeMin
+    || mIWModeMax != iwModeMax )
+    {
+    mIWMin = iwMin;
+    mIWMax = iwMax;
+    mIWModeMin = iwModeMin;
+    mIWModeMax = iwModeMax;
+    mModified = true;
+    }
+}
+
+
+template <class TPixel>
+SliceReslicer<TPixel>::
+SliceReslicer()
+{
+  mBuffer = NULL;
+  mBricked = NULL;
+  mMipProjector = NULL;
+  mSlabProjector = NULL;
+  mGradientVolume = NULL;
+  mIntegerInput = false;
+  mInputMin = 0;
+  mInputMax = 0;
+  this->update();
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+setInput( const PixelType * buffer, const unsigned long dimSize[3] )
+{
+  this->setInputBuffer( buffer, dimSize );
+  if( mIntegerInput || buffer == NULL )
+    {
+    return;
+    }
+
+  const long numberOfPixels = mImageStride[2] * ( long )dimSize[2];
+  bool integer = true;
+  double minimum = 0;
+  double maximum = 0;
+  for( long i=0; i<numberOfPixels && integer; ++i )
+    {
+    const double v = buffer[i];
+    if( v != std::floor( v ) )
+      {
+      integer = false;
+      break;
+      }
+    if( i == 0 || v < minimum )
+      {
+      minimum = v;
+      }
+    if( i == 0 || v > maximum )
+      {
+      maximum = v;
+      }
+    if( maximum - minimum >= MaxLookupTableSize )
+      {
+      integer = false;
+      }
+    }
+  this->setInputRange( integer, minimum, maximum );
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+setInputBuffer( const PixelType * buffer, const unsigned long dimSize[3] )
+{
+  mBuffer = buffer;
+  this->setDimSize( dimSize );
+
+  // A table over the whole range of a small integer type needs no scan,
+  //   which would read every page of a memory-mapped image
+  const double typeMin = std::numeric_limits< PixelType >::lowest();
+  const double typeMax = std::numeric_limits< PixelType >::max();
+  mIntegerInput = ( buffer != NULL )
+    && std::numeric_limits< PixelType >::is_integer
+    && typeMax - typeMin < MaxLookupTableSize;
+  mInputMin = mIntegerInput ? ( long )typeMin : 0;
+  mInputMax = mIntegerInput ? ( long )typeMax : 0;
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+setInputRange( bool integer, double minimum, double maximum )
+{
+  // The table of a small integer type already covers every value
+  const double typeMin = std::numeric_limits< PixelType >::lowest();
+  const double typeMax = std::numeric_limits< PixelType >::max();
+  if( std::numeric_limits< PixelType >::is_integer
+    && typeMax - typeMin < MaxLookupTableSize )
+    {
+    return;
+    }
+  mIntegerInput = integer && mBuffer != NULL
+    && minimum >= -2147483648.0 && maximum <= 2147483647.0
+    && maximum - minimum < MaxLookupTableSize;
+  mInputMin = mIntegerInput ? ( long )minimum : 0;
+  mInputMax = mIntegerInput ? ( long )maximum : 0;
+  mModified = true;
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+setBrickedInput( const BrickedVolume< PixelType > * volume )
+{
+  if( mBricked != volume )
+    {
+    mBricked = volume;
+    mModified = true;
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+setMipProjector( const MipProjector< PixelType > * projector )
+{
+  if( mMipProjector != projector )
+    {
+    mMipProjector = projector;
+    mModified = true;
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+setSlabProjector( const SlabProjector< PixelType > * projector )
+{
+  if( mSlabProjector != projector )
+    {
+    mSlabProjector = projector;
+    mModified = true;
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+setGradientVolume( const GradientVolume< PixelType > * volume )
+{
+  if( mGradientVolume != volume )
+    {
+    mGradientVolume = volume;
+    mModified = true;
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+update()
+{
+  if( !mModified )
+    {
+    return;
+    }
+  mModified = false;
+  mWindowLevel.setIntensityWindow( mIWMin, mIWMax, mIWModeMin, mIWModeMax );
+  mWindowLevel.setInvert( mImageMode == IMG_INV );
+  mGradientLevel.setIntensityWindow( 0, mIWMax - mIWMin, mIWModeMin,
+    mIWModeMax );
+  this->selectRowFunction();
+  if( mUseLookupTable )
+    {
+    this->updateLookupTable();
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+updateLookupTable()
+{
+  const double iwMin = mIWMin;
+  const double iwMax = mIWMax;
+  const double range = iwMax - iwMin;
+  const double logRange = log( range + 0.00000001 );
+
+  // IMG_BLEND is indexed by the sum of the previous, twice the current
+  //   and the next voxel, which the row kernel divides by 4
+  const long scale = ( mImageMode == IMG_BLEND ) ? 4 : 1;
+  mLookupTable.resize( scale * ( mInputMax - mInputMin ) + 1 );
+  for( long i=scale*mInputMin; i<=scale*mInputMax; ++i )
+    {
+    // Must match the IMG_VAL, IMG_INV, IMG_LOG and IMG_BLEND row kernels
+    //   exactly
+    const double v = ( mImageMode == IMG_BLEND ) ? ( double )i / 4
+      : ( double )( PixelType )i;
+    double tf;
+    switch( mImageMode )
+      {
+      default:
+      case IMG_VAL:
+      case IMG_BLEND:
+        tf = ( v - iwMin ) / range * 255;
+        break;
+      case IMG_INV:
+        tf = ( iwMax - v ) / range * 255;
+        break;
+      case IMG_LOG:
+        tf = log( v - iwMin + 0.00000001 ) / logRange * 255;
+        break;
+      }
+    mLookupTable[i - scale * mInputMin] = WindowLevelKernel::windowLevel(
+      tf, mIWModeMin, mIWModeMax );
+    }
+}
+
+
+template <class TPixel>
+template <ImageModeType TMode>
+void
+SliceReslicer<TPixel>::
+addRowFunctions( RowFunctionType & contiguous,
+  RowFunctionType & strided ) const
+{
+  contiguous = &SliceReslicer::template resliceRowTemplate<TMode, true>;
+  strided = &SliceReslicer::template resliceRowTemplate<TMode, false>;
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+selectRowFunction()
+{
+  RowFunctionType contiguous;
+  RowFunctionType strided;
+  switch( mImageMode )
+    {
+    default:
+    case IMG_VAL:
+      this->addRowFunctions<IMG_VAL>( contiguous, strided );
+      break;
+    case IMG_INV:
+      this->addRowFunctions<IMG_INV>( contiguous, strided );
+      break;
+    case IMG_LOG:
+      this->addRowFunctions<IMG_LOG>( contiguous, strided );
+      break;
+    case IMG_DX:
+      this->addRowFunctions<IMG_DX>( contiguous, strided );
+      break;
+    case IMG_DY:
+      this->addRowFunctions<IMG_DY>( contiguous, strided );
+      break;
+    case IMG_DZ:
+      this->addRowFunctions<IMG_DZ>( contiguous, strided );
+      break;
+    case IMG_BLEND:
+      this->addRowFunctions<IMG_BLEND>( contiguous, strided );
+      break;
+    case IMG_MIP:
+      this->addRowFunctions<IMG_MIP>( contiguous, strided );
+      break;
+    case IMG_SLAB_MAX:
+      this->addRowFunctions<IMG_SLAB_MAX>( contiguous, strided );
+      break;
+    case IMG_SLAB_MIN:
+      this->addRowFunctions<IMG_SLAB_MIN>( contiguous, strided );
+      break;
+    case IMG_SLAB_MEAN:
+      this->addRowFunctions<IMG_SLAB_MEAN>( contiguous, strided );
+      break;
+    case IMG_GRAD:
+      this->addRowFunctions<IMG_GRAD>( contiguous, strided );
+      break;
+    }
+  mUseLookupTable = mIntegerInput && ( mImageMode == IMG_VAL
+    || mImageMode == IMG_INV || mImageMode == IMG_LOG
+    || mImageMode == IMG_BLEND );
+  if( mUseLookupTable && mImageMode == IMG_BLEND )
+    {
+    contiguous =
+      &SliceReslicer::template resliceRowBlendLookupTemplate<true>;
+    strided = &SliceReslicer::template resliceRowBlendLookupTemplate<false>;
+    }
+  else if( mUseLookupTable )
+    {
+    contiguous = &SliceReslicer::template resliceRowLookupTemplate<true>;
+    strided = &SliceReslicer::template resliceRowLookupTemplate<false>;
+    }
+  mRowFunction = ( mStride[0] == 1 ) ? contiguous : strided;
+
+  if( mBricked != NULL )
+    {
+    switch( mImageMode )
+      {
+      default:
+      case IMG_VAL:
+      case IMG_INV:
+      case IMG_LOG:
+        mRowFunction =
+          &SliceReslicer::template resliceRowBrickedTemplate<IMG_VAL>;
+        break;
+      case IMG_BLEND:
+        mRowFunction =
+          &SliceReslicer::template resliceRowBrickedTemplate<IMG_BLEND>;
+        break;
+      case IMG_MIP:
+        mRowFunction =
+          &SliceReslicer::template resliceRowBrickedTemplate<IMG_MIP>;
+        break;
+      case IMG_DX:
+      case IMG_DY:
+      case IMG_DZ:
+      case IMG_GRAD:
+      case IMG_SLAB_MAX:
+      case IMG_SLAB_MIN:
+      case IMG_SLAB_MEAN:
+        break;
+      }
+    }
+  if( mMipProjector != NULL && mImageMode == IMG_MIP )
+    {
+    mRowFunction = &SliceReslicer::resliceRowProjectedMip;
+    }
+  mDirectRowFunction = mRowFunction;
+  if( mSlabProjector != NULL && imageModeIsSlab( mImageMode ) )
+    {
+    mRowFunction = &SliceReslicer::resliceRowProjectedSlab;
+    }
+  if( mGradientVolume != NULL && mImageMode == IMG_GRAD )
+    {
+    mRowFunction = &SliceReslicer::resliceRowGradientVolume;
+    }
+}
+
+
+template <class TPixel>
+template <ImageModeType TMode>
+void
+SliceReslicer<TPixel>::
+resliceRowBrickedTemplate( int k, int startJ, int endJ,
+  unsigned char * out, unsigned short * zBuffer ) const
+{
+  // Same arithmetic as resliceRowTemplate, but voxel offsets are sums of
+  //   per-axis table entries. IMG_VAL stands for all the modes mapped
+  //   voxel by voxel.
+  const PixelType * data = mBricked->buffer();
+  const long * offsetJ = mBricked->axisOffsets( mOrder[0] ) + startJ;
+  const long offsetK = mBricked->axisOffsets( mOrder[1] )[k];
+  const long * offsetL = mBricked->axisOffsets( mOrder[2] );
+  const int count = endJ - startJ + 1;
+
+  double chunk[ChunkSize];
+  double tf;
+  for( int j0=0; j0<count; j0+=ChunkSize )
+    {
+    const int n = std::min( ( int )ChunkSize, count - j0 );
+    const long * offset = offsetJ + j0;
+    switch( TMode )
+      {
+      default:
+      case IMG_VAL:
+        {
+        const PixelType * p = data + offsetK + offsetL[mSlice];
+        for( int j=0; j<n; ++j )
+          {
+          chunk[j] = ( double )p[offset[j]];
+          }
+        this->mapVoxels( chunk, n, out + j0 );
+        break;
+        }
+      case IMG_BLEND:
+        {
+        const int lastL = ( int )mDimSize[mOrder[2]] - 1;
+        const PixelType * prev = data + offsetK
+          + offsetL[std::max( mSlice - 1, 0 )];
+        const PixelType * p = data + offsetK + offsetL[mSlice];
+        const PixelType * next = data + offsetK
+          + offsetL[std::min( mSlice + 1, lastL )];
+        if( mUseLookupTable )
+          {
+          const unsigned char * table = &( mLookupTable[0] );
+          const long tableMin = 4 * mInputMin;
+          for( int j=0; j<n; ++j )
+            {
+            tf = ( double )prev[offset[j]];
+            tf += ( double )p[offset[j]] * 2;
+            tf += ( double )next[offset[j]];
+            out[j0+j] = table[( long )tf - tableMin];
+            }
+          break;
+          }
+        for( int j=0; j<n; ++j )
+          {
+          tf = ( double )prev[offset[j]];
+          tf += ( double )p[offset[j]] * 2;
+          tf += ( double )next[offset[j]];
+          chunk[j] = tf / 4;
+          }
+        mWindowLevel.apply( chunk, n, out + j0 );
+        break;
+        }
+      case IMG_MIP:
+        {
+        // Slice by slice, so each pass reads a row of bricks
+        const int depth = ( int )mDimSize[mOrder[2]];
+        for( int j=0; j<n; ++j )
+          {
+          chunk[j] = mIWMin;
+          zBuffer[j0+j] = 0;
+          }
+        for( int l=0; l<depth; ++l )
+          {
+          const PixelType * p = data + offsetK + offsetL[l];
+          for( int j=0; j<n; ++j )
+            {
+            if( p[offset[j]] > chunk[j] )
+              {
+              chunk[j] = ( double )p[offset[j]];
+              zBuffer[j0+j] = ( unsigned short )l;
+              }
+            }
+          }
+        mWindowLevel.apply( chunk, n, out + j0 );
+        break;
+        }
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+resliceRowProjectedMip( int k, int startJ, int endJ, unsigned char * out,
+  unsigned short * zBuffer ) const
+{
+  const int axis = mOrder[2];
+  if( !mMipProjector->isProjected( axis ) )
+    {
+    this->resliceRowTemplate<IMG_MIP, false>( k, startJ, endJ, out,
+      zBuffer );
+    return;
+    }
+
+  // The scan of resliceRowTemplate starts from iwMin, so rays whose
+  //   maximum does not exceed it give iwMin at depth 0
+  const double * maximum = mMipProjector->maximum( axis );
+  const unsigned short * depth = mMipProjector->depth( axis );
+  const long strideJ = mMipProjector->stride( axis, mOrder[0] );
+  const long offset = startJ * strideJ
+    + k * mMipProjector->stride( axis, mOrder[1] );
+  const double iwMin = mIWMin;
+  const int count = endJ - startJ + 1;
+  double chunk[ChunkSize];
+  for( int j0=0; j0<count; j0+=ChunkSize )
+    {
+    const int n = std::min( ( int )ChunkSize, count - j0 );
+    long i = offset + j0 * strideJ;
+    for( int j=0; j<n; ++j, i+=strideJ )
+      {
+      const bool greater = maximum[i] > iwMin;
+      chunk[j] = greater ? maximum[i] : iwMin;
+      zBuffer[j0+j] = greater ? depth[i] : 0;
+      }
+    mWindowLevel.apply( chunk, n, out + j0 );
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+resliceRowProjectedSlab( int k, int startJ, int endJ, unsigned char * out,
+  unsigned short * zBuffer ) const
+{
+  if( !mSlabProjector->isProjected( mOrder, mSlice, mSlabThickness,
+    mImageMode, k, startJ, endJ ) )
+    {
+    ( this->*mDirectRowFunction )( k, startJ, endJ, out, zBuffer );
+    return;
+    }
+
+  // The projected row is contiguous, so it is window/leveled in place
+  const int count = endJ - startJ + 1;
+  mWindowLevel.apply( mSlabProjector->value( k, startJ ), count, out );
+  if( imageModeHasDepth( mImageMode ) )
+    {
+    std::copy( mSlabProjector->depth( k, startJ ),
+      mSlabProjector->depth( k, startJ ) + count, zBuffer );
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+resliceRowGradientVolume( int k, int startJ, int endJ, unsigned char * out,
+  unsigned short * zBuffer ) const
+{
+  if( !mGradientVolume->isReady() )
+    {
+    ( this->*mDirectRowFunction )( k, startJ, endJ, out, zBuffer );
+    return;
+    }
+
+  const long strideJ = mStride[0];
+  typedef GradientVolume< PixelType > GradientVolumeType;
+  const typename GradientVolumeType::MagnitudeType * p =
+    mGradientVolume->magnitudes() + this->voxelOffset( startJ, k );
+  const double scale = mGradientVolume->scale();
+  const int count = endJ - startJ + 1;
+  double chunk[ChunkSize];
+  for( int j0=0; j0<count; j0+=ChunkSize )
+    {
+    const int n = std::min( ( int )ChunkSize, count - j0 );
+    for( int j=0; j<n; ++j, p+=strideJ )
+      {
+      chunk[j] = GradientVolumeType::value( *p, scale );
+      }
+    mGradientLevel.apply( chunk, n, out + j0 );
+    }
+}
+
+
+template <class TPixel>
+template <bool TContiguous>
+void
+SliceReslicer<TPixel>::
+resliceRowLookupTemplate( int k, int startJ, int endJ, unsigned char * out,
+  unsigned short * itkNotUsed( zBuffer ) ) const
+{
+  const long strideJ = TContiguous ? 1 : mStride[0];
+  const PixelType * p = mBuffer + this->voxelOffset( startJ, k );
+  const int count = endJ - startJ + 1;
+  const unsigned char * table = &( mLookupTable[0] );
+  const long tableMin = mInputMin;
+  for( int j=0; j<count; ++j, p+=strideJ )
+    {
+    out[j] = table[( long )*p - tableMin];
+    }
+}
+
+
+template <class TPixel>
+template <bool TContiguous>
+void
+SliceReslicer<TPixel>::
+resliceRowBlendLookupTemplate( int k, int startJ, int endJ,
+  unsigned char * out, unsigned short * itkNotUsed( zBuffer ) ) const
+{
+  // The sums of the IMG_BLEND row kernel, before its division by 4, are
+  //   exact integers, so they index the table directly
+  const long strideJ = TContiguous ? 1 : mStride[0];
+  const long strideL = mStride[2];
+  const long prevL = ( mSlice - 1 < 0 ) ? -mSlice : -1;
+  const long nextL = ( ( int )mDimSize[mOrder[2]] - 1 < mSlice + 1 )
+    ? ( ( int )mDimSize[mOrder[2]] - 1 - mSlice ) : 1;
+  const long prevOffset = prevL * strideL;
+  const long nextOffset = nextL * strideL;
+  const PixelType * p = mBuffer + this->voxelOffset( startJ, k );
+  const int count = endJ - startJ + 1;
+  const unsigned char * table = &( mLookupTable[0] );
+  const long tableMin = 4 * mInputMin;
+  for( int j=0; j<count; ++j, p+=strideJ )
+    {
+    double tf = ( double )p[prevOffset];
+    tf += ( double )*p * 2;
+    tf += ( double )p[nextOffset];
+    out[j] = table[( long )tf - tableMin];
+    }
+}
+
+
+template <class TPixel>
+template <ImageModeType TMode, bool TContiguous>
+void
+SliceReslicer<TPixel>::
+resliceRowTemplate( int k, int startJ, int endJ, unsigned char * out,
+  unsigned short * zBuffer ) const
+{
+  const long strideJ = TContiguous ? 1 : mStride[0];
+  const long strideL = mStride[2];
+  const PixelType * p = mBuffer + this->voxelOffset( startJ, k );
+  const int count = endJ - startJ + 1;
+
+  const double iwMin = mIWMin;
+  const double range = mIWMax - iwMin;
+
+  // All modes but IMG_LOG gather or combine pixels into chunk and
+  //   window/level it with the vectorized kernel
+  double chunk[ChunkSize];
+  double tf;
+  switch( TMode )
+    {
+    default:
+    case IMG_VAL:
+    case IMG_INV:
+      if( TContiguous && std::is_same< PixelType, double >::value )
+        {
+        mWindowLevel.apply( reinterpret_cast< const double * >( p ), count,
+          out );
+        break;
+        }
+      for( int j0=0; j0<count; j0+=ChunkSize )
+        {
+        const int n = std::min( ( int )ChunkSize, count - j0 );
+        for( int j=0; j<n; ++j, p+=strideJ )
+          {
+          chunk[j] = ( double )*p;
+          }
+        mWindowLevel.apply( chunk, n, out + j0 );
+        }
+      break;
+    case IMG_LOG:
+      {
+      const double logRange = log( range + 0.00000001 );
+      for( int j=0; j<count; ++j, p+=strideJ )
+        {
+        tf = log( ( double )*p - iwMin + 0.00000001 ) / logRange * 255;
+        out[j] = WindowLevelKernel::windowLevel( tf,
+          mIWModeMin, mIWModeMax );
+        }
+      break;
+      }
+    case IMG_DX:
+    case IMG_DY:
+    case IMG_DZ:
+      {
+      // The derivative is taken along an image axis, so its boundary
+      //   lies on whichever window axis that image axis is shown along.
+      const int axis = ( TMode == IMG_DX ) ? 0 : ( TMode == IMG_DY ) ? 1 : 2;
+      const long prev = mImageStride[axis];
+      int firstJ = 0;
+      if( ( mOrder[1] == axis && k <= 0 ) || ( mOrder[2] == axis
+        && mSlice <= 0 ) )
+        {
+        firstJ = count;
+        }
+      else if( mOrder[0] == axis && startJ <= 0 )
+        {
+        firstJ = 1;
+        }
+      firstJ = std::min( firstJ, count );
+      std::fill( out, out + firstJ, WindowLevelKernel::windowLevel( 128,
+        mIWModeMin, mIWModeMax ) );
+      p += firstJ * strideJ;
+      if( TContiguous && std::is_same< PixelType, double >::value )
+        {
+        const double * v = reinterpret_cast< const double * >( p );
+        mWindowLevel.applyDifference( v, v - prev, count - firstJ,
+          out + firstJ );
+        break;
+        }
+      double previous[ChunkSize];
+      for( int j0=firstJ; j0<count; j0+=ChunkSize )
+        {
+        const int n = std::min( ( int )ChunkSize, count - j0 );
+        for( int j=0; j<n; ++j, p+=strideJ )
+          {
+          chunk[j] = ( double )*p;
+          previous[j] = ( double )*( p - prev );
+          }
+        mWindowLevel.applyDifference( chunk, previous, n, out + j0 );
+        }
+      break;
+      }
+    case IMG_GRAD:
+      {
+      // Backward differences along the three image axes, zero on the
+      //   first index of an axis, as GradientVolume computes and rounds
+      //   them
+      const double scale = mGradientVolume ? mGradientVolume->scale()
+        : GradientMagnitudeTraits< PixelType >::scale();
+      const long strideX = mImageStride[0];
+      const long strideY = mImageStride[1];
+      const long strideZ = mImageStride[2];
+      bool inside[3];
+      inside[mOrder[1]] = ( k > 0 );
+      inside[mOrder[2]] = ( mSlice > 0 );
+      for( int j0=0; j0<count; j0+=ChunkSize )
+        {
+        const int n = std::min( ( int )ChunkSize, count - j0 );
+        for( int j=0; j<n; ++j, p+=strideJ )
+          {
+          inside[mOrder[0]] = ( startJ + j0 + j > 0 );
+          const double v = ( double )*p;
+          chunk[j] = GradientVolume< PixelType >::magnitude(
+            inside[0] ? v - ( double )p[-strideX] : 0,
+            inside[1] ? v - ( double )p[-strideY] : 0,
+            inside[2] ? v - ( double )p[-strideZ] : 0, scale );
+          }
+        mGradientLevel.apply( chunk, n, out + j0 );
+        }
+      break;
+      }
+    case IMG_BLEND:
+      {
+      const long prevL = ( mSlice - 1 < 0 ) ? -mSlice : -1;
+      const long nextL = ( ( int )mDimSize[mOrder[2]] - 1 < mSlice + 1 )
+        ? ( ( int )mDimSize[mOrder[2]] - 1 - mSlice ) : 1;
+      const long prevOffset = prevL * strideL;
+      const long nextOffset = nextL * strideL;
+      for( int j0=0; j0<count; j0+=ChunkSize )
+        {
+        const int n = std::min( ( int )ChunkSize, count - j0 );
+        for( int j=0; j<n; ++j, p+=strideJ )
+          {
+          tf = ( double )p[prevOffset];
+          tf += ( double )*p * 2;
+          tf += ( double )p[nextOffset];
+          chunk[j] = tf / 4;
+          }
+        mWindowLevel.apply( chunk, n, out + j0 );
+        }
+      break;
+      }
+    case IMG_MIP:
+      {
+      const int depth = ( int )mDimSize[mOrder[2]];
+      const PixelType * q = mBuffer + this->voxelOffset( startJ, k, 0 );
+      for( int j0=0; j0<count; j0+=ChunkSize )
+        {
+        const int n = std::min( ( int )ChunkSize, count - j0 );
+        for( int j=0; j<n; ++j, q+=strideJ )
+          {
+          tf = iwMin;
+          unsigned short z = 0;
+          const PixelType * r = q;
+          for( int l=0; l<depth; ++l, r+=strideL )
+            {
+            if( *r > tf )
+              {
+              tf = ( double )*r;
+              z = ( unsigned short )l;
+              }
+            }
+          zBuffer[j0+j] = z;
+          chunk[j] = tf;
+          }
+        mWindowLevel.apply( chunk, n, out + j0 );
+        }
+      break;
+      }
+    case IMG_SLAB_MAX:
+    case IMG_SLAB_MIN:
+      {
+      // Extrema of the slab, ignoring NaN voxels. Empty slabs give -inf,
+      //   or +inf, at the first slice.
+      int first;
+      int last;
+      SlabProjector< PixelType >::slabRange( mSlice, mSlabThickness,
+        ( int )mDimSize[mOrder[2]], first, last );
+      const double start = ( TMode == IMG_SLAB_MAX )
+        ? -std::numeric_limits< double >::infinity()
+        : std::numeric_limits< double >::infinity();
+      const PixelType * q = mBuffer + this->voxelOffset( startJ, k, first );
+      for( int j0=0; j0<count; j0+=ChunkSize )
+        {
+        const int n = std::min( ( int )ChunkSize, count - j0 );
+        for( int j=0; j<n; ++j, q+=strideJ )
+          {
+          tf = start;
+          unsigned short z = ( unsigned short )first;
+          const PixelType * r = q;
+          for( int l=first; l<=last; ++l, r+=strideL )
+            {
+            const double v = ( double )*r;
+            if( ( TMode == IMG_SLAB_MAX ) ? v > tf : v < tf )
+              {
+              tf = v;
+              z = ( unsigned short )l;
+              }
+            }
+          zBuffer[j0+j] = z;
+          chunk[j] = tf;
+          }
+        mWindowLevel.apply( chunk, n, out + j0 );
+        }
+      break;
+      }
+    case IMG_SLAB_MEAN:
+      {
+      int first;
+      int last;
+      SlabProjector< PixelType >::slabRange( mSlice, mSlabThickness,
+        ( int )mDimSize[mOrder[2]], first, last );
+      const PixelType * q = mBuffer + this->voxelOffset( startJ, k, first );
+      for( int j0=0; j0<count; j0+=ChunkSize )
+        {
+        const int n = std::min( ( int )ChunkSize, count - j0 );
+        for( int j=0; j<n; ++j, q+=strideJ )
+          {
+          tf = 0;
+          const PixelType * r = q;
+          for( int l=first; l<=last; ++l, r+=strideL )
+            {
+            tf += ( double )*r;
+            }
+          chunk[j] = tf / ( last - first + 1 );
+          }
+        mWindowLevel.apply( chunk, n, out + j0 );
+        }
+      break;
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+mapVoxels( const double * values, int count, unsigned char * out ) const
+{
+  if( mUseLookupTable )
+    {
+    const unsigned char * table = &( mLookupTable[0] );
+    const long tableMin = mInputMin;
+    for( int j=0; j<count; ++j )
+      {
+      out[j] = table[( long )values[j] - tableMin];
+      }
+    }
+  else if( mImageMode == IMG_LOG )
+    {
+    const double iwMin = mIWMin;
+    const double logRange = log( mIWMax - iwMin + 0.00000001 );
+    for( int j=0; j<count; ++j )
+      {
+      const double tf = log( values[j] - iwMin + 0.00000001 ) / logRange
+        * 255;
+      out[j] = WindowLevelKernel::windowLevel( tf, mIWModeMin, mIWModeMax );
+      }
+    }
+  else
+    {
+    mWindowLevel.apply( values, count, out );
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+resliceRows( int startK, int endK, int startJ, int endJ,
+  unsigned char * out, unsigned short * zBuffer, long outStride ) const
+{
+  if( !this->mapsVoxels() || mStride[1] >= mStride[0]
+    || mBricked != NULL )
+    {
+    for( int k=startK; k<=endK; ++k )
+      {
+      const long rowOffset = ( k - startK ) * outStride;
+      this->resliceRow( k, startJ, endJ, out + rowOffset,
+        zBuffer + rowOffset );
+      }
+    return;
+    }
+
+  // Gather a tile of TileRows x ChunkSize pixels column by column, so
+  //   the inner loop steps along the smaller stride, then map it row by row
+  enum { TileColumns = ChunkSize };
+  double tile[TileRows][TileColumns];
+  const long strideK = mStride[1];
+  const int count = endJ - startJ + 1;
+  for( int k0=startK; k0<=endK; k0+=TileRows )
+    {
+    const int rows = std::min( ( int )TileRows, endK - k0 + 1 );
+    for( int j0=0; j0<count; j0+=TileColumns )
+      {
+      const int columns = std::min( ( int )TileColumns, count - j0 );
+      for( int j=0; j<columns; ++j )
+        {
+        const PixelType * p = mBuffer
+          + this->voxelOffset( startJ + j0 + j, k0 );
+        for( int r=0; r<rows; ++r, p+=strideK )
+          {
+          tile[r][j] = ( double )*p;
+          }
+        }
+      for( int r=0; r<rows; ++r )
+        {
+        this->mapVoxels( tile[r], columns,
+          out + ( k0 - startK + r ) * outStride + j0 );
+        }
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+SliceReslicer<TPixel>::
+resliceRowSlices( int k, int startJ, int endJ, const int * slices,
+  int numberOfSlices, unsigned char * const * out ) const
+{
+  enum { ChunkColumns = ChunkSize };
+  double chunk[MaxSlicesPerPass][ChunkColumns];
+  long sliceOffset[MaxSlicesPerPass];
+  for( int i=0; i<numberOfSlices; ++i )
+    {
+    sliceOffset[i] = slices[i] * mStride[2];
+    }
+  const long strideJ = mStride[0];
+  const int count = endJ - startJ + 1;
+  const PixelType * p = mBuffer + this->voxelOffset( startJ, k, 0 );
+  for( int j0=0; j0<count; j0+=ChunkColumns )
+    {
+    const int n = std::min( ( int )ChunkColumns, count - j0 );
+    for( int j=0; j<n; ++j, p+=strideJ )
+      {
+      for( int i=0; i<numberOfSlices; ++i )
+        {
+        chunk[i][j] = ( double )p[sliceOffset[i]];
+        }
+      }
+    for( int i=0; i<numberOfSlices; ++i )
+      {
+      this->mapVoxels( chunk[i], n, out[i] + j0 );
+      }
+    }
+}
+
+
+template class SliceReslicer<unsigned char>;
+template class SliceReslicer<short>;
+template class SliceReslicer<unsigned short>;
+template class SliceReslicer<float>;
+template class SliceReslicer<double>;
@@ -0,0 +1,328 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __SliceReslicer_h
+#define __SliceReslicer_h
+
+// ImageViewer includes
+#include "QtGlSliceView.h"
+#include "WindowLevelKernel.h"
+#include "BrickedVolume.h"
+#include "MipProjector.h"
+#include "SlabProjector.h"
+#include "GradientVolume.h"
+
+// STD includes
+#include <vector>
+
+/**
+* SliceReslicerBase : the part of a SliceReslicer that does not depend on
+* the pixel type of the volume, through which the slice view and the
+* SlicePrefetcher drive the reslicer of a volume of any type.
+*
+* It holds the view settings and the strides of the window axes, so the
+* voxel offsets used to sample the overlay are still computed inline.
+**/
+class SliceReslicerBase
+{
+public:
+  enum { MaxLookupTableSize = 65536 };
+
+  /*! Number of pixels window/leveled per call of the vectorized kernel */
+  enum { ChunkSize = 256 };
+
+  /*! Number of window rows gathered together by resliceRows() */
+  enum { TileRows = 8 };
+
+  /*! Maximum number of slices filled in one pass by resliceRowSlices() */
+  enum { MaxSlicesPerPass = 8 };
+
+  SliceReslicerBase();
+  virtual ~SliceReslicerBase() {}
+
+  /*! New copy of the reslicer, with its settings and lookup table */
+  virtual SliceReslicerBase * clone() const = 0;
+
+  /*! Number of slices, centered on the slice, of the slab modes */
+  void setSlabThickness( int thickness );
+
+  /*! Specify the image axes of the window x, window y and slice
+  *   directions */
+  void setOrder( const int order[3] );
+
+  /*! Specify the slice being resliced */
+  void setSlice( int slice );
+
+  void setImageMode( ImageModeType mode );
+
+  void setIntensityWindow( double iwMin, double iwMax,
+    IWModeType iwModeMin, IWModeType iwModeMax );
+
+  /*! Select the row kernel and rebuild the lookup table if the settings
+  *   changed. Must be called before resliceRow(). */
+  virtual void update() = 0;
+
+  /*! True if the current mode is computed using the lookup table */
+  bool usesLookupTable() const
+    {
+    return mUseLookupTable;
+    }
+
+  /*! Fill out[0..endJ-startJ] with the window row k. In IMG_MIP,
+  *   IMG_SLAB_MAX and IMG_SLAB_MIN modes the slice of each extremum is
+  *   written to zBuffer. */
+  virtual void resliceRow( int k, int startJ, int endJ, unsigned char * out,
+    unsigned short * zBuffer ) const = 0;
+
+  /*! Fill the window rows startK to endK, writing row k to
+  *   out + ( k - startK ) * outStride, and likewise for zBuffer.
+  *
+  *   When the window y axis has the smaller stride in the image, as in
+  *   sagittal and transposed views, IMG_VAL, IMG_INV and IMG_LOG rows are
+  *   gathered in tiles of TileRows rows, reading along the window y axis,
+  *   so consecutive reads stay within a few pages of the image. */
+  virtual void resliceRows( int startK, int endK, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer,
+    long outStride ) const = 0;
+
+  /*! True if each window pixel only depends on its own voxel (IMG_VAL,
+  *   IMG_INV and IMG_LOG), so several slices can be filled at once */
+  bool mapsVoxels() const
+    {
+    return mImageMode == IMG_VAL || mImageMode == IMG_INV
+      || mImageMode == IMG_LOG;
+    }
+
+  /*! Buffer offset between two consecutive pixels of a window row */
+  long columnStride() const
+    {
+    return mStride[0];
+    }
+
+  /*! Buffer offset between two consecutive slices */
+  long sliceStride() const
+    {
+    return mStride[2];
+    }
+
+  /*! Fill window row k of the slices slices[0..numberOfSlices-1], at most
+  *   MaxSlicesPerPass, writing slice i to out[i]. Requires mapsVoxels().
+  *   When the slice axis is the image x axis, as in sagittal views, the
+  *   slices share the cache lines read, so filling them together costs
+  *   about as much memory traffic as filling one. */
+  virtual void resliceRowSlices( int k, int startJ, int endJ,
+    const int * slices, int numberOfSlices,
+    unsigned char * const * out ) const = 0;
+
+  /*! Buffer offset of the window pixel ( j, k ) at depth l */
+  long voxelOffset( int j, int k, int l ) const
+    {
+    return j * mStride[0] + k * mStride[1] + l * mStride[2];
+    }
+
+  /*! Buffer offset of the window pixel ( j, k ) on the current slice */
+  long voxelOffset( int j, int k ) const
+    {
+    return this->voxelOffset( j, k, mSlice );
+    }
+
+protected:
+  /*! Specify the size of the input, from which the strides follow */
+  void setDimSize( const unsigned long dimSize[3] );
+
+  unsigned long     mDimSize[3];
+  long              mImageStride[3];
+  int               mOrder[3];
+  long              mStride[3];
+  int               mSlice;
+  int               mSlabThickness;
+
+  ImageModeType     mImageMode;
+  double            mIWMin;
+  double            mIWMax;
+  IWModeType        mIWModeMin;
+  IWModeType        mIWModeMax;
+
+  bool              mModified;
+  bool              mUseLookupTable;
+};
+
+
+/**
+* SliceReslicer : extracts the window rows of one slice of a 3D image
+* directly from its x-fastest pixel buffer.
+*
+* The strides of the window x, window y and slice axes are precomputed
+* from the view orientation (cWinOrder, which also encodes the transpose
+* state), and a row kernel specialized for the image mode and for
+* contiguous rows is selected once per frame. Flips are applied when the
+* window buffer is drawn, so they do not change the reslicing.
+*
+* The kernels reproduce the arithmetic of the original per-pixel
+* GetPixel() loop so the window buffer is identical bit-for-bit.
+*
+* When every pixel of the input is an integer within a range of at most
+* MaxLookupTableSize values (e.g., uchar or short data, also once
+* converted to double), the IMG_VAL, IMG_INV and IMG_LOG modes are
+* computed once per value into a lookup table, and reslicing becomes a
+* table lookup. So is
+* IMG_BLEND, whose weighted sums of three integers are then integers
+* within four times the input range.
+* Otherwise the rows of every mode but IMG_LOG are mapped to window
+* values by the SIMD WindowLevelKernel. IMG_GRAD maps the gradient
+* magnitude through the intensity window shifted to start at 0.
+*
+* Optionally, every mode but the derivatives and the slabs reads a
+* BrickedVolume copy of the input instead of the flat buffer, IMG_MIP
+* re-maps the projections cached by a MipProjector instead of scanning
+* the depth, the slab modes re-map the slab kept by a SlabProjector, and
+* IMG_GRAD re-maps the magnitudes of a GradientVolume once it is ready.
+*
+* It is instantiated for the pixel types a SliceVolume can hold.
+**/
+template <class TPixel>
+class SliceReslicer : public SliceReslicerBase
+{
+public:
+  typedef TPixel PixelType;
+
+  SliceReslicer();
+
+  virtual SliceReslicerBase * clone() const
+    {
+    return new SliceReslicer( *this );
+    }
+
+  /*! Specify the x-fastest pixel buffer and its size. The buffer is
+  *   scanned to decide if a lookup table can be used, unless PixelType
+  *   is an integer type of at most MaxLookupTableSize values, whose
+  *   table then covers the whole type. */
+  void setInput( const PixelType * buffer, const unsigned long dimSize[3] );
+
+  /*! Specify the buffer and its size without scanning it, e.g., while it
+  *   is being read. No lookup table is used until setInputRange(),
+  *   unless PixelType is an integer type of at most MaxLookupTableSize
+  *   values. */
+  void setInputBuffer( const PixelType * buffer,
+    const unsigned long dimSize[3] );
+
+  /*! Use a lookup table if every pixel of the input is an integer, and
+  *   minimum to maximum spans less than MaxLookupTableSize values */
+  void setInputRange( bool integer, double minimum, double maximum );
+
+  /*! Read the voxels from a bricked copy of the input buffer, or from
+  *   the input buffer if volume is NULL. The derivative modes always read
+  *   the input buffer. */
+  void setBrickedInput( const BrickedVolume< PixelType > * volume );
+
+  /*! Take IMG_MIP rows from the projections of projector when it holds
+  *   the one along the slice axis, or scan the depth if projector is
+  *   NULL or does not. */
+  void setMipProjector( const MipProjector< PixelType > * projector );
+
+  /*! Take IMG_SLAB_MAX, IMG_SLAB_MIN and IMG_SLAB_MEAN rows from
+  *   projector when it holds the current slab, or project the slab of
+  *   each row if projector is NULL or does not. */
+  void setSlabProjector( const SlabProjector< PixelType > * projector );
+
+  /*! Take IMG_GRAD rows from volume once it is ready, or compute the
+  *   gradient magnitude of each row if volume is NULL or is not */
+  void setGradientVolume( const GradientVolume< PixelType > * volume );
+
+  virtual void update();
+
+  virtual void resliceRow( int k, int startJ, int endJ, unsigned char * out,
+    unsigned short * zBuffer ) const
+    {
+    ( this->*mRowFunction )( k, startJ, endJ, out, zBuffer );
+    }
+
+  virtual void resliceRows( int startK, int endK, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer, long outStride ) const;
+
+  virtual void resliceRowSlices( int k, int startJ, int endJ,
+    const int * slices, int numberOfSlices,
+    unsigned char * const * out ) const;
+
+protected:
+  typedef void ( SliceReslicer::*RowFunctionType )( int k, int startJ,
+    int endJ, unsigned char * out, unsigned short * zBuffer ) const;
+
+  /*! Select the row kernel matching the image mode and the strides */
+  void selectRowFunction();
+
+  template <ImageModeType TMode, bool TContiguous>
+  void resliceRowTemplate( int k, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer ) const;
+
+  template <ImageModeType TMode>
+  void addRowFunctions( RowFunctionType & contiguous,
+    RowFunctionType & strided ) const;
+
+  template <ImageModeType TMode>
+  void resliceRowBrickedTemplate( int k, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer ) const;
+
+  void resliceRowProjectedMip( int k, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer ) const;
+
+  void resliceRowProjectedSlab( int k, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer ) const;
+
+  void resliceRowGradientVolume( int k, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer ) const;
+
+  template <bool TContiguous>
+  void resliceRowLookupTemplate( int k, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer ) const;
+
+  template <bool TContiguous>
+  void resliceRowBlendLookupTemplate( int k, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer ) const;
+
+  /*! Map count voxel values to window values, for the modes where
+  *   mapsVoxels() is true */
+  void mapVoxels( const double * values, int count,
+    unsigned char * out ) const;
+
+  /*! Fill the lookup table for the current mode and intensity window */
+  void updateLookupTable();
+
+  const PixelType * mBuffer;
+  const BrickedVolume< PixelType > * mBricked;
+  const MipProjector< PixelType > * mMipProjector;
+  const SlabProjector< PixelType > * mSlabProjector;
+  const GradientVolume< PixelType > * mGradientVolume;
+
+  RowFunctionType   mRowFunction;
+  /* computes the row when the projection or volume does not hold it */
+  RowFunctionType   mDirectRowFunction;
+  WindowLevelKernel mWindowLevel;
+  /* IMG_GRAD: the intensity window shifted to [0, iwMax-iwMin] */
+  WindowLevelKernel mGradientLevel;
+
+  bool              mIntegerInput;
+  long              mInputMin;
+  long              mInputMax;
+  std::vector< unsigned char > mLookupTable;
+};
+
+#endif
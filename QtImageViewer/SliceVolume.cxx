@@ -0,0 +1,648 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "SliceVolume.h"
+
+// ITK includes
+#include "itkCastImageFilter.h"
+
+// STD includes
+#include <algorithm>
+#include <limits>
+
+
+SliceVolumeBase::
+SliceVolumeBase( ImageBaseType * image )
+{
+  mImage = image;
+  const ImageBaseType::SizeType size =
+    image->GetLargestPossibleRegion().GetSize();
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = size[i];
+    }
+}
+
+
+namespace
+{
+
+template <class TPixel>
+SliceVolumeBase::ImageBaseType::Pointer
+newImage( itk::ImageIOBase * imageIO, bool allocate )
+{
+  typedef itk::Image< TPixel, 3 > ImageType;
+  typename ImageType::RegionType region;
+  typename ImageType::SpacingType spacing;
+  typename ImageType::PointType origin;
+  typename ImageType::DirectionType direction;
+  for( unsigned int i=0; i<3; ++i )
+    {
+    region.SetSize( i, imageIO->GetDimensions( i ) );
+    spacing[i] = imageIO->GetSpacing( i );
+    origin[i] = imageIO->GetOrigin( i );
+    const std::vector< double > axis = imageIO->GetDirection( i );
+    for( unsigned int j=0; j<3; ++j )
+      {
+      direction[j][i] = axis[j];
+      }
+    }
+  typename ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->SetSpacing( spacing );
+  image->SetOrigin( origin );
+  image->SetDirection( direction );
+  if( allocate )
+    {
+    image->Allocate( true );
+    }
+  return image.GetPointer();
+}
+
+
+template <class TPixel>
+void
+createStreamedVolume( itk::ImageIOBase * imageIO, size_t memoryBudget,
+  std::unique_ptr< SliceVolumeBase > & volume )
+{
+  volume.reset( new StreamedSliceVolume< TPixel >( imageIO, memoryBudget ) );
+}
+
+
+template <class TPixel>
+bool
+createVolume( SliceVolumeBase::ImageBaseType * image,
+  std::unique_ptr< SliceVolumeBase > & volume )
+{
+  typedef itk::Image< TPixel, 3 > ImageType;
+  ImageType * typedImage = dynamic_cast< ImageType * >( image );
+  if( typedImage != NULL )
+    {
+    volume.reset( new SliceVolume< TPixel >( typedImage ) );
+    }
+  return typedImage != NULL;
+}
+
+}
+
+
+std::unique_ptr< SliceVolumeBase >
+SliceVolumeBase::
+create( ImageBaseType * image )
+{
+  std::unique_ptr< SliceVolumeBase > volume;
+  if( image != NULL )
+    {
+    createVolume< unsigned char >( image, volume )
+      || createVolume< short >( image, volume )
+      || createVolume< unsigned short >( image, volume )
+      || createVolume< float >( image, volume )
+      || createVolume< double >( image, volume );
+    }
+  return volume;
+}
+
+
+SliceVolumeBase::ImageBaseType::Pointer
+SliceVolumeBase::
+createImage( itk::ImageIOBase * imageIO, bool allocate )
+{
+  ImageBaseType::Pointer image;
+  if( imageIO == NULL || imageIO->GetNumberOfDimensions() != 3
+    || imageIO->GetNumberOfComponents() != 1 )
+    {
+    return image;
+    }
+  switch( imageIO->GetComponentType() )
+    {
+    case itk::ImageIOBase::UCHAR:
+      image = newImage< unsigned char >( imageIO, allocate );
+      break;
+    case itk::ImageIOBase::SHORT:
+      image = newImage< short >( imageIO, allocate );
+      break;
+    case itk::ImageIOBase::USHORT:
+      image = newImage< unsigned short >( imageIO, allocate );
+      break;
+    case itk::ImageIOBase::FLOAT:
+      image = newImage< float >( imageIO, allocate );
+      break;
+    case itk::ImageIOBase::DOUBLE:
+      image = newImage< double >( imageIO, allocate );
+      break;
+    default:
+      break;
+    }
+  return image;
+}
+
+
+std::unique_ptr< SliceVolumeBase >
+SliceVolumeBase::
+createStreamed( itk::ImageIOBase * imageIO, size_t memoryBudget )
+{
+  std::unique_ptr< SliceVolumeBase > volume;
+  if( imageIO == NULL || !imageIO->CanStreamRead()
+    || imageIO->GetNumberOfDimensions() != 3
+    || imageIO->GetNumberOfComponents() != 1 )
+    {
+    return volume;
+    }
+  switch( imageIO->GetComponentType() )
+    {
+    case itk::ImageIOBase::UCHAR:
+      createStreamedVolume< unsigned char >( imageIO, memoryBudget, volume );
+      break;
+    case itk::ImageIOBase::SHORT:
+      createStreamedVolume< short >( imageIO, memoryBudget, volume );
+      break;
+    case itk::ImageIOBase::USHORT:
+      createStreamedVolume< unsigned short >( imageIO, memoryBudget,
+        volume );
+      break;
+    case itk::ImageIOBase::FLOAT:
+      createStreamedVolume< float >( imageIO, memoryBudget, volume );
+      break;
+    case itk::ImageIOBase::DOUBLE:
+      createStreamedVolume< double >( imageIO, memoryBudget, volume );
+      break;
+    default:
+      break;
+    }
+  return volume;
+}
+
+
+template <class TPixel>
+SliceVolume<TPixel>::
+SliceVolume( ImageType * image )
+: SliceVolumeBase( image )
+{
+  mTypedImage = image;
+  const PixelType * buffer = image->GetBufferPointer();
+  mReslicer.reset( new SliceReslicer< PixelType >() );
+  mReslicer->setInputBuffer( buffer, mDimSize );
+  mMipProjector.reset( new MipProjector< PixelType >() );
+  mMipProjector->setInput( buffer, mDimSize );
+  mReslicer->setMipProjector( mMipProjector.get() );
+  mSlabProjector.reset( new SlabProjector< PixelType >() );
+  mSlabProjector->setInput( buffer, mDimSize );
+  mReslicer->setSlabProjector( mSlabProjector.get() );
+  mGradientVolume.reset( new GradientVolume< PixelType >() );
+  mGradientVolume->setInput( buffer, mDimSize );
+  mReslicer->setGradientVolume( mGradientVolume.get() );
+  mImagePyramid.reset( new ImagePyramid< PixelType >() );
+  mImagePyramid->setInput( buffer, mDimSize );
+  mLevelReslicers.resize( ImagePyramid< PixelType >::MaxLevel + 1 );
+}
+
+
+template <class TPixel>
+bool
+SliceVolume<TPixel>::
+isStreamed() const
+{
+  return false;
+}
+
+
+template <class TPixel>
+bool
+SliceVolume<TPixel>::
+isMapped() const
+{
+  return !mTypedImage->GetPixelContainer()->GetContainerManageMemory();
+}
+
+
+template <class TPixel>
+void *
+SliceVolume<TPixel>::
+buffer()
+{
+  return mTypedImage->GetBufferPointer();
+}
+
+
+template <class TPixel>
+size_t
+SliceVolume<TPixel>::
+pixelSize() const
+{
+  return sizeof( PixelType );
+}
+
+
+template <class TPixel>
+bool
+SliceVolume<TPixel>::
+isInteger() const
+{
+  return std::numeric_limits< PixelType >::is_integer;
+}
+
+
+template <class TPixel>
+double
+SliceVolume<TPixel>::
+value( const itk::Index< 3 > & index ) const
+{
+  return ( double )mTypedImage->GetPixel( index );
+}
+
+
+template <class TPixel>
+void
+SliceVolume<TPixel>::
+computeStatistics( ImageStatistics & statistics,
+  itk::MultiThreaderBase * threader ) const
+{
+  statistics.clear();
+  statistics.add( mTypedImage->GetBufferPointer(),
+    mDimSize[0] * mDimSize[1] * mDimSize[2], threader );
+}
+
+
+template <class TPixel>
+void
+SliceVolume<TPixel>::
+addSliceStatistics( ImageStatistics & statistics, int slice,
+  itk::MultiThreaderBase * threader ) const
+{
+  const size_t slicePixels = mDimSize[0] * mDimSize[1];
+  statistics.add( mTypedImage->GetBufferPointer() + slice * slicePixels,
+    slicePixels, threader );
+}
+
+
+template <class TPixel>
+void
+SliceVolume<TPixel>::
+setPixelStatistics( const ImageStatistics & statistics )
+{
+  mReslicer->setInputRange( statistics.isInteger(), statistics.minimum(),
+    statistics.maximum() );
+  mGradientVolume->setRange( statistics.minimum(), statistics.maximum() );
+}
+
+
+template <class TPixel>
+SliceVolumeBase::DoubleImageType::Pointer
+SliceVolume<TPixel>::
+doubleImage() const
+{
+  DoubleImageType * image =
+    dynamic_cast< DoubleImageType * >( mImage.GetPointer() );
+  if( image != NULL )
+    {
+    return image;
+    }
+  typedef itk::CastImageFilter< ImageType, DoubleImageType > CastType;
+  typename CastType::Pointer cast = CastType::New();
+  cast->SetInput( mTypedImage );
+  cast->Update();
+  return cast->GetOutput();
+}
+
+
+template <class TPixel>
+SliceReslicerBase *
+SliceVolume<TPixel>::
+reslicer()
+{
+  return mReslicer.get();
+}
+
+
+template <class TPixel>
+SliceReslicerBase *
+SliceVolume<TPixel>::
+levelReslicer( int level, itk::MultiThreaderBase * threader )
+{
+  if( level == 0 )
+    {
+    return mReslicer.get();
+    }
+  if( !mLevelReslicers[level] )
+    {
+    mImagePyramid->update( level, threader );
+    mLevelReslicers[level].reset( new SliceReslicer< PixelType >() );
+    mLevelReslicers[level]->setInput( mImagePyramid->buffer( level ),
+      mImagePyramid->dimSize( level ) );
+    }
+  return mLevelReslicers[level].get();
+}
+
+
+template <class TPixel>
+int
+SliceVolume<TPixel>::
+maxPyramidLevel() const
+{
+  return mImagePyramid->maxLevel();
+}
+
+
+template <class TPixel>
+void
+SliceVolume<TPixel>::
+updateMip( int axis, itk::MultiThreaderBase * threader )
+{
+  mMipProjector->update( axis, threader );
+}
+
+
+template <class TPixel>
+void
+SliceVolume<TPixel>::
+updateSlab( const int order[3], int slice, int thickness,
+  ImageModeType mode, int startJ, int endJ, int startK, int endK,
+  itk::MultiThreaderBase * threader )
+{
+  mSlabProjector->update( order, slice, thickness, mode, startJ, endJ,
+    startK, endK, threader );
+}
+
+
+template <class TPixel>
+void
+SliceVolume<TPixel>::
+requestGradient()
+{
+  mGradientVolume->requestUpdate();
+}
+
+
+template <class TPixel>
+void
+SliceVolume<TPixel>::
+setBrickSize( unsigned int brickSize )
+{
+  mReslicer->setBrickedInput( NULL );
+  mBrickedVolume.reset();
+  if( brickSize > 0 )
+    {
+    mBrickedVolume.reset( new BrickedVolume< PixelType >() );
+    mBrickedVolume->build( mTypedImage->GetBufferPointer(), mDimSize,
+      brickSize );
+    mReslicer->setBrickedInput( mBrickedVolume.get() );
+    }
+}
+
+
+template <class TPixel>
+size_t
+SliceVolume<TPixel>::
+brickedMemorySize() const
+{
+  return mBrickedVolume ? mBrickedVolume->memorySize() : 0;
+}
+
+
+template <class TPixel>
+void
+SliceVolume<TPixel>::
+clear()
+{
+  mMipProjector->clear();
+  mSlabProjector->clear();
+  mGradientVolume->clear();
+  mImagePyramid->clear();
+  for( size_t level=0; level < mLevelReslicers.size(); level++ )
+    {
+    mLevelReslicers[level].reset();
+    }
+}
+
+
+template class SliceVolume<unsigned char>;
+template class SliceVolume<short>;
+template class SliceVolume<unsigned short>;
+template class SliceVolume<float>;
+template class SliceVolume<double>;
+
+
+template <class TPixel>
+StreamedSliceVolume<TPixel>::
+StreamedSliceVolume( itk::ImageIOBase * imageIO, size_t memoryBudget )
+: SliceVolumeBase( createImage( imageIO, false ) )
+{
+  mChunkedVolume.reset( new ChunkedVolume< PixelType >( imageIO ) );
+  mChunkedVolume->setMemoryBudget( memoryBudget );
+  mReslicer.reset( new StreamedReslicer< PixelType >(
+    mChunkedVolume.get() ) );
+}
+
+
+template <class TPixel>
+bool
+StreamedSliceVolume<TPixel>::
+isStreamed() const
+{
+  return true;
+}
+
+
+template <class TPixel>
+bool
+StreamedSliceVolume<TPixel>::
+isMapped() const
+{
+  return false;
+}
+
+
+template <class TPixel>
+void *
+StreamedSliceVolume<TPixel>::
+buffer()
+{
+  return NULL;
+}
+
+
+template <class TPixel>
+size_t
+StreamedSliceVolume<TPixel>::
+pixelSize() const
+{
+  return sizeof( PixelType );
+}
+
+
+template <class TPixel>
+bool
+StreamedSliceVolume<TPixel>::
+isInteger() const
+{
+  return std::numeric_limits< PixelType >::is_integer;
+}
+
+
+template <class TPixel>
+double
+StreamedSliceVolume<TPixel>::
+value( const itk::Index< 3 > & index ) const
+{
+  const long voxel[3] = { ( long )index[0], ( long )index[1],
+    ( long )index[2] };
+  return ( double )mChunkedVolume->value( voxel );
+}
+
+
+template <class TPixel>
+void
+StreamedSliceVolume<TPixel>::
+computeStatistics( ImageStatistics & statistics,
+  itk::MultiThreaderBase * threader ) const
+{
+  const long numberOfSlices = std::min( ( long )SampledSlices,
+    ( long )mDimSize[2] );
+  statistics.clear();
+  for( long i=0; i<numberOfSlices; ++i )
+    {
+    this->addSliceStatistics( statistics,
+      ( ( 2 * i + 1 ) * ( long )mDimSize[2] ) / ( 2 * numberOfSlices ),
+      threader );
+    }
+}
+
+
+template <class TPixel>
+void
+StreamedSliceVolume<TPixel>::
+addSliceStatistics( ImageStatistics & statistics, int slice,
+  itk::MultiThreaderBase * threader ) const
+{
+  const long start[3] = { 0, 0, slice };
+  const unsigned long size[3] = { mDimSize[0], mDimSize[1], 1 };
+  std::vector< PixelType > pixels( mDimSize[0] * mDimSize[1] );
+  mChunkedVolume->readRegion( start, size, pixels.data() );
+  statistics.add( pixels.data(), pixels.size(), threader );
+}
+
+
+template <class TPixel>
+void
+StreamedSliceVolume<TPixel>::
+setPixelStatistics( const ImageStatistics & )
+{
+  // The slab reslicers scan their slabs
+}
+
+
+template <class TPixel>
+SliceVolumeBase::DoubleImageType::Pointer
+StreamedSliceVolume<TPixel>::
+doubleImage() const
+{
+  return NULL;
+}
+
+
+template <class TPixel>
+SliceReslicerBase *
+StreamedSliceVolume<TPixel>::
+reslicer()
+{
+  return mReslicer.get();
+}
+
+
+template <class TPixel>
+SliceReslicerBase *
+StreamedSliceVolume<TPixel>::
+levelReslicer( int itkNotUsed( level ),
+  itk::MultiThreaderBase * itkNotUsed( threader ) )
+{
+  return mReslicer.get();
+}
+
+
+template <class TPixel>
+int
+StreamedSliceVolume<TPixel>::
+maxPyramidLevel() const
+{
+  return 0;
+}
+
+
+template <class TPixel>
+void
+StreamedSliceVolume<TPixel>::
+updateMip( int itkNotUsed( axis ),
+  itk::MultiThreaderBase * itkNotUsed( threader ) )
+{
+}
+
+
+template <class TPixel>
+void
+StreamedSliceVolume<TPixel>::
+updateSlab( const int itkNotUsed( order )[3], int itkNotUsed( slice ),
+  int itkNotUsed( thickness ), ImageModeType itkNotUsed( mode ),
+  int itkNotUsed( startJ ), int itkNotUsed( endJ ),
+  int itkNotUsed( startK ), int itkNotUsed( endK ),
+  itk::MultiThreaderBase * itkNotUsed( threader ) )
+{
+}
+
+
+template <class TPixel>
+void
+StreamedSliceVolume<TPixel>::
+requestGradient()
+{
+}
+
+
+template <class TPixel>
+void
+StreamedSliceVolume<TPixel>::
+setBrickSize( unsigned int itkNotUsed( brickSize ) )
+{
+}
+
+
+template <class TPixel>
+size_t
+StreamedSliceVolume<TPixel>::
+brickedMemorySize() const
+{
+  return 0;
+}
+
+
+template <class TPixel>
+void
+StreamedSliceVolume<TPixel>::
+clear()
+{
+}
+
+
+template class StreamedSliceVolume<unsigned char>;
+template class StreamedSliceVolume<short>;
+template class StreamedSliceVolume<unsigned short>;
+template class StreamedSliceVolume<float>;
+template class StreamedSliceVolume<double>;
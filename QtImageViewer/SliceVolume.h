@@ -0,0 +1,293 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __SliceVolume_h
+#define __SliceVolume_h
+
+// ImageViewer includes
+#include "SliceReslicer.h"
+#include "BrickedVolume.h"
+#include "MipProjector.h"
+#include "SlabProjector.h"
+#include "GradientVolume.h"
+#include "ImagePyramid.h"
+#include "ImageStatistics.h"
+#include "ChunkedVolume.h"
+#include "StreamedReslicer.h"
+
+// ITK includes
+#include "itkImage.h"
+#include "itkImageIOBase.h"
+#include "itkMultiThreaderBase.h"
+
+// STD includes
+#include <memory>
+#include <vector>
+
+/**
+* SliceVolumeBase : a 3D image kept in its own pixel type, with the
+* reslicers, projections, gradient magnitudes, bricks and pyramid levels
+* rendered from it.
+*
+* The slice view renders every image through this interface, so an image
+* read as unsigned char, short, unsigned short or float is not converted
+* to double, and each slice reads only the bytes of its own pixels.
+* create() returns the SliceVolume of the pixel type of an image, and
+* createStreamed() a StreamedSliceVolume reading a file on demand.
+**/
+class SliceVolumeBase
+{
+public:
+  typedef itk::ImageBase< 3 >      ImageBaseType;
+  typedef itk::Image< double, 3 >  DoubleImageType;
+
+  virtual ~SliceVolumeBase() {}
+
+  /*! New volume of image, or NULL if its pixel type is not one of the
+  *   types above */
+  static std::unique_ptr< SliceVolumeBase > create(
+    ImageBaseType * image );
+
+  /*! New image of the type and geometry of the file of imageIO, which
+  *   has read the image information, with its pixels allocated and set
+  *   to 0 if allocate is true. NULL if the file is not a 3D image of one
+  *   of the types above. */
+  static ImageBaseType::Pointer createImage( itk::ImageIOBase * imageIO,
+    bool allocate );
+
+  /*! New StreamedSliceVolume of the file of imageIO, which has read the
+  *   image information, keeping at most memoryBudget bytes of it. NULL
+  *   if imageIO cannot stream reads, or the image is not a 3D image of
+  *   one of the types above. */
+  static std::unique_ptr< SliceVolumeBase > createStreamed(
+    itk::ImageIOBase * imageIO, size_t memoryBudget );
+
+  /*! The image, e.g., for its geometry */
+  ImageBaseType * image() const
+    {
+    return mImage.GetPointer();
+    }
+
+  const unsigned long * dimSize() const
+    {
+    return mDimSize;
+    }
+
+  /*! True if the pixels are read from the file on demand, so image()
+  *   has no pixel buffer */
+  virtual bool isStreamed() const = 0;
+
+  /*! True if the pixel buffer is not owned by image(), e.g., is a
+  *   mapping of the file, whose pages are read as they are touched */
+  virtual bool isMapped() const = 0;
+
+  /*! The pixel buffer of image(), NULL if the volume is streamed */
+  virtual void * buffer() = 0;
+
+  /*! Number of bytes of a pixel */
+  virtual size_t pixelSize() const = 0;
+
+  /*! True if the pixels are integers */
+  virtual bool isInteger() const = 0;
+
+  /*! Number of bytes of the pixel buffer */
+  size_t bufferSize() const
+    {
+    return mDimSize[0] * mDimSize[1] * mDimSize[2] * this->pixelSize();
+    }
+
+  /*! Value of the pixel at index, which must be inside the image */
+  virtual double value( const itk::Index< 3 > & index ) const = 0;
+
+  /*! Replace statistics by those of the pixels, computed on threader */
+  virtual void computeStatistics( ImageStatistics & statistics,
+    itk::MultiThreaderBase * threader ) const = 0;
+
+  /*! Add the pixels of axial slice slice to statistics */
+  virtual void addSliceStatistics( ImageStatistics & statistics,
+    int slice, itk::MultiThreaderBase * threader ) const = 0;
+
+  /*! Read the pixels through lookup tables if statistics, those of
+  *   every pixel, show they allow it. Until then, only the pixels of the
+  *   small integer types are, so the pixels need not be scanned, or
+  *   even be read, when the volume is created. */
+  virtual void setPixelStatistics( const ImageStatistics & statistics ) = 0;
+
+  /*! The image itself if it is double, or a new copy converted to
+  *   double. NULL if the volume is streamed. */
+  virtual DoubleImageType::Pointer doubleImage() const = 0;
+
+  /*! Reslicer of the image. It takes IMG_MIP, the slab modes and
+  *   IMG_GRAD from the projections and magnitudes of the volume. */
+  virtual SliceReslicerBase * reslicer() = 0;
+
+  /*! Reslicer of pyramid level level, building the level if needed, or
+  *   reslicer() if level is 0 */
+  virtual SliceReslicerBase * levelReslicer( int level,
+    itk::MultiThreaderBase * threader ) = 0;
+
+  /*! Highest pyramid level that holds more than one voxel */
+  virtual int maxPyramidLevel() const = 0;
+
+  /*! Project the image along axis, unless it already is */
+  virtual void updateMip( int axis, itk::MultiThreaderBase * threader ) = 0;
+
+  /*! Project or slide the slab of thickness slices around slice, see
+  *   SlabProjector::update() */
+  virtual void updateSlab( const int order[3], int slice, int thickness,
+    ImageModeType mode, int startJ, int endJ, int startK, int endK,
+    itk::MultiThreaderBase * threader ) = 0;
+
+  /*! Start computing the gradient magnitudes in the background */
+  virtual void requestGradient() = 0;
+
+  /*! Read the voxels of reslicer() from a copy of the image in bricks of
+  *   brickSize^3 voxels, or from the image if brickSize is 0 */
+  virtual void setBrickSize( unsigned int brickSize ) = 0;
+
+  /*! Bytes used by the bricked copy, 0 if there is none */
+  virtual size_t brickedMemorySize() const = 0;
+
+  /*! Drop the projections, magnitudes and pyramid levels, e.g., after
+  *   the pixels changed in place */
+  virtual void clear() = 0;
+
+protected:
+  SliceVolumeBase( ImageBaseType * image );
+
+  ImageBaseType::Pointer mImage;
+  unsigned long          mDimSize[3];
+};
+
+
+/**
+* SliceVolume : the SliceVolumeBase of an itk::Image< TPixel, 3 >.
+**/
+template <class TPixel>
+class SliceVolume : public SliceVolumeBase
+{
+public:
+  typedef TPixel                     PixelType;
+  typedef itk::Image< PixelType, 3 > ImageType;
+
+  SliceVolume( ImageType * image );
+
+  virtual bool isStreamed() const;
+  virtual bool isMapped() const;
+  virtual void * buffer();
+  virtual size_t pixelSize() const;
+  virtual bool isInteger() const;
+  virtual double value( const itk::Index< 3 > & index ) const;
+  virtual void computeStatistics( ImageStatistics & statistics,
+    itk::MultiThreaderBase * threader ) const;
+  virtual void addSliceStatistics( ImageStatistics & statistics,
+    int slice, itk::MultiThreaderBase * threader ) const;
+  virtual void setPixelStatistics( const ImageStatistics & statistics );
+  virtual DoubleImageType::Pointer doubleImage() const;
+
+  virtual SliceReslicerBase * reslicer();
+  virtual SliceReslicerBase * levelReslicer( int level,
+    itk::MultiThreaderBase * threader );
+  virtual int maxPyramidLevel() const;
+
+  virtual void updateMip( int axis, itk::MultiThreaderBase * threader );
+  virtual void updateSlab( const int order[3], int slice, int thickness,
+    ImageModeType mode, int startJ, int endJ, int startK, int endK,
+    itk::MultiThreaderBase * threader );
+  virtual void requestGradient();
+
+  virtual void setBrickSize( unsigned int brickSize );
+  virtual size_t brickedMemorySize() const;
+
+  virtual void clear();
+
+protected:
+  typename ImageType::Pointer mTypedImage;
+
+  std::unique_ptr< SliceReslicer< PixelType > >  mReslicer;
+  std::unique_ptr< MipProjector< PixelType > >   mMipProjector;
+  std::unique_ptr< SlabProjector< PixelType > >  mSlabProjector;
+  std::unique_ptr< GradientVolume< PixelType > > mGradientVolume;
+  std::unique_ptr< BrickedVolume< PixelType > >  mBrickedVolume;
+  std::unique_ptr< ImagePyramid< PixelType > >   mImagePyramid;
+  /* reslicers of the pyramid levels built, by level */
+  std::vector< std::unique_ptr< SliceReslicer< PixelType > > >
+    mLevelReslicers;
+};
+
+
+/**
+* StreamedSliceVolume : the SliceVolumeBase of a 3D image read from its
+* file on demand through a ChunkedVolume, for images that do not fit in
+* memory.
+*
+* Only the chunks cached by the volume and the slabs of the reslicers are
+* in memory. There are no pyramid levels, bricks, gradient volume or
+* projections of the whole depth, which would read the whole file, so
+* IMG_MIP projects the slab thickness (see StreamedReslicer), and the
+* statistics are those of SampledSlices axial slices.
+**/
+template <class TPixel>
+class StreamedSliceVolume : public SliceVolumeBase
+{
+public:
+  typedef TPixel                     PixelType;
+  typedef itk::Image< PixelType, 3 > ImageType;
+
+  enum { SampledSlices = 16 };
+
+  StreamedSliceVolume( itk::ImageIOBase * imageIO, size_t memoryBudget );
+
+  virtual bool isStreamed() const;
+  virtual bool isMapped() const;
+  virtual void * buffer();
+  virtual size_t pixelSize() const;
+  virtual bool isInteger() const;
+  virtual double value( const itk::Index< 3 > & index ) const;
+  virtual void computeStatistics( ImageStatistics & statistics,
+    itk::MultiThreaderBase * threader ) const;
+  virtual void addSliceStatistics( ImageStatistics & statistics,
+    int slice, itk::MultiThreaderBase * threader ) const;
+  virtual void setPixelStatistics( const ImageStatistics & statistics );
+  virtual DoubleImageType::Pointer doubleImage() const;
+
+  virtual SliceReslicerBase * reslicer();
+  virtual SliceReslicerBase * levelReslicer( int level,
+    itk::MultiThreaderBase * threader );
+  virtual int maxPyramidLevel() const;
+
+  virtual void updateMip( int axis, itk::MultiThreaderBase * threader );
+  virtual void updateSlab( const int order[3], int slice, int thickness,
+    ImageModeType mode, int startJ, int endJ, int startK, int endK,
+    itk::MultiThreaderBase * threader );
+  virtual void requestGradient();
+
+  virtual void setBrickSize( unsigned int brickSize );
+  virtual size_t brickedMemorySize() const;
+
+  virtual void clear();
+
+protected:
+  std::unique_ptr< ChunkedVolume< PixelType > >    mChunkedVolume;
+  std::unique_ptr< StreamedReslicer< PixelType > > mReslicer;
+};
+
+#endif
@@ -0,0 +1,266 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "SparseLabelVolume.h"
+
+// ITK includes
+#include "itkImageFileWriter.h"
+#include "itkImageIOFactory.h"
+#include "itkImageSource.h"
+
+// STD includes
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+
+namespace
+{
+
+typedef itk::Image< SparseLabelVolume::LabelType, 3 > LabelImageType;
+
+/**
+* SparseLabelSource : produces the requested slices of a
+* SparseLabelVolume, so a streaming writer holds one slab at a time.
+**/
+class SparseLabelSource : public itk::ImageSource< LabelImageType >
+{
+public:
+  typedef SparseLabelSource                  Self;
+  typedef itk::ImageSource< LabelImageType > Superclass;
+  typedef itk::SmartPointer< Self >          Pointer;
+
+  itkNewMacro( Self );
+
+  void setLabels( const SparseLabelVolume * labels,
+    const SparseLabelVolume::ImageBaseType * image )
+    {
+    mLabels = labels;
+    mImage = image;
+    this->Modified();
+    }
+
+protected:
+  SparseLabelSource()
+    {
+    mLabels = NULL;
+    mImage = NULL;
+    }
+
+  virtual void GenerateOutputInformation()
+    {
+    this->GetOutput()->CopyInformation( mImage );
+    }
+
+  virtual void GenerateData()
+    {
+    LabelImageType * output = this->GetOutput();
+    const LabelImageType::RegionType region = output->GetRequestedRegion();
+    output->SetBufferedRegion( region );
+    output->Allocate();
+    const unsigned long * dimSize = mLabels->dimSize();
+    const long start[3] = { region.GetIndex()[0], region.GetIndex()[1],
+      region.GetIndex()[2] };
+    const long size[3] = { ( long )region.GetSize()[0],
+      ( long )region.GetSize()[1], ( long )region.GetSize()[2] };
+    SparseLabelVolume::LabelType * out = output->GetBufferPointer();
+    // The writer streams whole slices
+    if( start[0] == 0 && start[1] == 0 && size[0] == ( long )dimSize[0]
+      && size[1] == ( long )dimSize[1] )
+      {
+      mLabels->readSlices( start[2], start[2] + size[2] - 1, out );
+      return;
+      }
+    for( long z=start[2]; z < start[2]+size[2]; ++z )
+      {
+      for( long y=start[1]; y < start[1]+size[1]; ++y )
+        {
+        for( long x=start[0]; x < start[0]+size[0]; ++x )
+          {
+          *out++ = mLabels->value( x, y, z );
+          }
+        }
+      }
+    }
+
+  const SparseLabelVolume *                 mLabels;
+  const SparseLabelVolume::ImageBaseType *  mImage;
+};
+
+std::string
+suffix( const std::string & fileName )
+{
+  const size_t dot = fileName.find_last_of( '.' );
+  if( dot == std::string::npos )
+    {
+    return std::string();
+    }
+  std::string res = fileName.substr( dot + 1 );
+  std::transform( res.begin(), res.end(), res.begin(), ::tolower );
+  return res;
+}
+
+}
+
+
+SparseLabelVolume::
+SparseLabelVolume( const unsigned long dimSize[3] )
+{
+  size_t numberOfBricks = 1;
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = dimSize[i];
+    mNumberOfBricks[i] = ( dimSize[i] + BrickSize - 1 ) / BrickSize;
+    numberOfBricks *= mNumberOfBricks[i];
+    }
+  mBricks.resize( numberOfBricks );
+}
+
+
+SparseLabelVolume::
+SparseLabelVolume( const SparseLabelVolume & other )
+{
+  for( int i=0; i<3; ++i )
+    {
+    mDimSize[i] = other.mDimSize[i];
+    mNumberOfBricks[i] = other.mNumberOfBricks[i];
+    }
+  const size_t brickVoxels = BrickSize * BrickSize * BrickSize;
+  mBricks.resize( other.mBricks.size() );
+  for( size_t i=0; i < mBricks.size(); ++i )
+    {
+    if( other.mBricks[i] )
+      {
+      mBricks[i].reset( new LabelType[brickVoxels] );
+      memcpy( mBricks[i].get(), other.mBricks[i].get(), brickVoxels );
+      }
+    }
+}
+
+
+void
+SparseLabelVolume::
+setValue( long x, long y, long z, LabelType label )
+{
+  std::unique_ptr< LabelType[] > & brick =
+    mBricks[this->brickIndex( x, y, z )];
+  if( !brick )
+    {
+    if( label == 0 )
+      {
+      return;
+      }
+    const size_t brickVoxels = BrickSize * BrickSize * BrickSize;
+    brick.reset( new LabelType[brickVoxels] );
+    memset( brick.get(), 0, brickVoxels );
+    }
+  brick[this->voxelIndex( x, y, z )] = label;
+}
+
+
+size_t
+SparseLabelVolume::
+memorySize() const
+{
+  const size_t numberOfBricks = std::count_if( mBricks.begin(),
+    mBricks.end(), []( const std::unique_ptr< LabelType[] > & brick )
+      {
+      return brick != nullptr;
+      } );
+  return numberOfBricks * BrickSize * BrickSize * BrickSize;
+}
+
+
+void
+SparseLabelVolume::
+readSlices( long firstSlice, long lastSlice, LabelType * out ) const
+{
+  const long sizeX = mDimSize[0];
+  const long sizeY = mDimSize[1];
+  memset( out, 0, sizeX * sizeY * ( lastSlice - firstSlice + 1 ) );
+  // Only the allocated bricks are copied, by rows
+  for( long z=firstSlice; z <= lastSlice; ++z )
+    {
+    for( long brickY=0; brickY < ( long )mNumberOfBricks[1]; ++brickY )
+      {
+      for( long brickX=0; brickX < ( long )mNumberOfBricks[0]; ++brickX )
+        {
+        const long x0 = brickX * BrickSize;
+        const long y0 = brickY * BrickSize;
+        const LabelType * brick =
+          mBricks[this->brickIndex( x0, y0, z )].get();
+        if( brick == NULL )
+          {
+          continue;
+          }
+        const long width = std::min( ( long )BrickSize, sizeX - x0 );
+        const long endY = std::min( y0 + BrickSize, sizeY );
+        for( long y=y0; y < endY; ++y )
+          {
+          memcpy( out + ( ( z - firstSlice ) * sizeY + y ) * sizeX + x0,
+            brick + this->voxelIndex( x0, y, z ), width );
+          }
+        }
+      }
+    }
+}
+
+
+void
+SparseLabelVolume::
+write( const std::string & fileName, const ImageBaseType * image ) const
+{
+  // Other writers, and compressed MetaImage, would request the whole
+  //   volume from the source at once
+  const std::string type = suffix( fileName );
+  itk::ImageIOBase::Pointer imageIO;
+  if( type == "mha" || type == "mhd" )
+    {
+    imageIO = itk::ImageIOFactory::CreateImageIO( fileName.c_str(),
+      itk::ImageIOFactory::WriteMode );
+    }
+  if( imageIO.IsNull() )
+    {
+    throw itk::ExceptionObject( __FILE__, __LINE__,
+      "Large overlays can only be written to uncompressed MetaImage "
+      "(.mha or .mhd) files" );
+    }
+  imageIO->SetFileName( fileName );
+  imageIO->SetUseCompression( false );
+  if( !imageIO->CanStreamWrite() )
+    {
+    throw itk::ExceptionObject( __FILE__, __LINE__,
+      "The writer of the overlay file cannot write it slab by slab" );
+    }
+
+  SparseLabelSource::Pointer source = SparseLabelSource::New();
+  source->setLabels( this, image );
+  typedef itk::ImageFileWriter< LabelImageType > WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( fileName );
+  writer->SetImageIO( imageIO );
+  writer->SetInput( source->GetOutput() );
+  writer->SetUseCompression( false );
+  writer->SetNumberOfStreamDivisions(
+    ( mDimSize[2] + BrickSize - 1 ) / BrickSize );
+  writer->Update();
+}
@@ -0,0 +1,102 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __SparseLabelVolume_h
+#define __SparseLabelVolume_h
+
+// ITK includes
+#include "itkImage.h"
+
+// STD includes
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+* SparseLabelVolume : the overlay labels of a streamed image, stored in
+* bricks of BrickSize^3 voxels that are only allocated once a voxel of
+* theirs is labeled, so painting a volume larger than the memory costs
+* the bricks painted.
+*
+* Copies share nothing, so a copy taken before a paint stroke is the undo
+* state of the stroke, at the cost of the bricks allocated.
+**/
+class SparseLabelVolume
+{
+public:
+  typedef unsigned char        LabelType;
+  typedef itk::ImageBase< 3 >  ImageBaseType;
+
+  enum { BrickSize = 64 };
+
+  SparseLabelVolume( const unsigned long dimSize[3] );
+  SparseLabelVolume( const SparseLabelVolume & other );
+
+  const unsigned long * dimSize() const
+    {
+    return mDimSize;
+    }
+
+  /*! Label of the voxel at index, 0 if its brick is not allocated */
+  LabelType value( long x, long y, long z ) const
+    {
+    const LabelType * brick = mBricks[this->brickIndex( x, y, z )].get();
+    return brick == NULL ? 0
+      : brick[this->voxelIndex( x, y, z )];
+    }
+
+  /*! Label the voxel at index, allocating its brick unless label is 0 */
+  void setValue( long x, long y, long z, LabelType label );
+
+  /*! Bytes used by the allocated bricks */
+  size_t memorySize() const;
+
+  /*! Copy the labels of the slices firstSlice to lastSlice, x fastest,
+  *   to out */
+  void readSlices( long firstSlice, long lastSlice, LabelType * out ) const;
+
+  /*! Write the labels to fileName, uncompressed, with the geometry of
+  *   image, in slabs of BrickSize slices so the whole volume is never
+  *   held in memory. Only MetaImage files (.mha or .mhd) are written
+  *   that way; throws itk::ExceptionObject for other files, or if it
+  *   cannot be written. */
+  void write( const std::string & fileName,
+    const ImageBaseType * image ) const;
+
+protected:
+  size_t brickIndex( long x, long y, long z ) const
+    {
+    return ( ( z / BrickSize ) * mNumberOfBricks[1] + y / BrickSize )
+      * mNumberOfBricks[0] + x / BrickSize;
+    }
+
+  static size_t voxelIndex( long x, long y, long z )
+    {
+    return ( ( z % BrickSize ) * BrickSize + y % BrickSize ) * BrickSize
+      + x % BrickSize;
+    }
+
+  unsigned long mDimSize[3];
+  unsigned long mNumberOfBricks[3];
+  std::vector< std::unique_ptr< LabelType[] > > mBricks;
+};
+
+#endif
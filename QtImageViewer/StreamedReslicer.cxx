@@ -0,0 +1,213 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "StreamedReslicer.h"
+
+// STD includes
+#include <algorithm>
+
+
+template <class TPixel>
+StreamedReslicer<TPixel>::
+StreamedReslicer( ChunkedVolume< PixelType > * volume )
+{
+  mVolume = volume;
+  this->setDimSize( volume->dimSize() );
+  mSlabAxis = -1;
+  mSlabStart = 0;
+  mSlabEnd = -1;
+  mSlabSlice = -1;
+}
+
+
+template <class TPixel>
+StreamedReslicer<TPixel>::
+StreamedReslicer( const StreamedReslicer & other )
+: SliceReslicerBase( other )
+{
+  // The copy loads its own slab
+  mVolume = other.mVolume;
+  mSlabAxis = -1;
+  mSlabStart = 0;
+  mSlabEnd = -1;
+  mSlabSlice = -1;
+}
+
+
+template <class TPixel>
+void
+StreamedReslicer<TPixel>::
+update()
+{
+  std::lock_guard< std::mutex > lock( mSlabMutex );
+  this->applySettings();
+  mSlabReslicer.update();
+  mUseLookupTable = mSlabReslicer.usesLookupTable();
+  mModified = false;
+}
+
+
+template <class TPixel>
+void
+StreamedReslicer<TPixel>::
+applySettings() const
+{
+  mSlabReslicer.setOrder( mOrder );
+  mSlabReslicer.setImageMode( mImageMode );
+  mSlabReslicer.setSlabThickness( mSlabThickness );
+  mSlabReslicer.setIntensityWindow( mIWMin, mIWMax, mIWModeMin,
+    mIWModeMax );
+}
+
+
+template <class TPixel>
+int
+StreamedReslicer<TPixel>::
+loadSlab( int firstSlice, int lastSlice, int slice ) const
+{
+  std::lock_guard< std::mutex > lock( mSlabMutex );
+  int before = 0;
+  int after = 0;
+  switch( mImageMode )
+    {
+    case IMG_DX:
+    case IMG_DY:
+    case IMG_DZ:
+    case IMG_BLEND:
+    case IMG_GRAD:
+      before = 1;
+      after = 1;
+      break;
+    case IMG_MIP:
+    case IMG_SLAB_MAX:
+    case IMG_SLAB_MIN:
+    case IMG_SLAB_MEAN:
+      before = ( mSlabThickness - 1 ) / 2;
+      after = mSlabThickness / 2;
+      break;
+    default:
+      break;
+    }
+  const int axis = mOrder[2];
+  const int start = std::max( firstSlice - before, 0 );
+  const int end = std::min( lastSlice + after, ( int )mDimSize[axis] - 1 );
+
+  // A clone has not been updated, so the settings are passed here too.
+  //   IMG_MIP projects the whole slab, so it must be exactly the one of
+  //   its slice.
+  this->applySettings();
+  if( axis != mSlabAxis || start < mSlabStart || end > mSlabEnd
+    || ( mImageMode == IMG_MIP && ( start != mSlabStart
+      || end != mSlabEnd ) ) )
+    {
+    unsigned long size[3] = { mDimSize[0], mDimSize[1], mDimSize[2] };
+    long index[3] = { 0, 0, 0 };
+    size[axis] = end - start + 1;
+    index[axis] = start;
+    mSlab.resize( size[0] * size[1] * size[2] );
+    mVolume->readRegion( index, size, mSlab.data() );
+    mSlabReslicer.setInput( mSlab.data(), size );
+    mSlabAxis = axis;
+    mSlabStart = start;
+    mSlabEnd = end;
+    mSlabSlice = -1;
+    }
+  // The other render threads are reading the slab reslicer, so it is
+  //   only written when the slice changes
+  if( slice != mSlabSlice )
+    {
+    mSlabSlice = slice;
+    mSlabReslicer.setSlice( slice - mSlabStart );
+    }
+  mSlabReslicer.update();
+  return mSlabStart;
+}
+
+
+template <class TPixel>
+void
+StreamedReslicer<TPixel>::
+resliceRow( int k, int startJ, int endJ, unsigned char * out,
+  unsigned short * zBuffer ) const
+{
+  const int slabStart = this->loadSlab( mSlice, mSlice, mSlice );
+  mSlabReslicer.resliceRow( k, startJ, endJ, out, zBuffer );
+  // The depth buffer holds slices of the slab
+  if( imageModeHasDepth( mImageMode ) )
+    {
+    for( int j=0; j <= endJ-startJ; ++j )
+      {
+      zBuffer[j] += slabStart;
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+StreamedReslicer<TPixel>::
+resliceRows( int startK, int endK, int startJ, int endJ,
+  unsigned char * out, unsigned short * zBuffer, long outStride ) const
+{
+  const int slabStart = this->loadSlab( mSlice, mSlice, mSlice );
+  mSlabReslicer.resliceRows( startK, endK, startJ, endJ, out, zBuffer,
+    outStride );
+  if( imageModeHasDepth( mImageMode ) )
+    {
+    for( int k=startK; k <= endK; ++k )
+      {
+      unsigned short * z = zBuffer + ( k - startK ) * outStride;
+      for( int j=0; j <= endJ-startJ; ++j )
+        {
+        z[j] += slabStart;
+        }
+      }
+    }
+}
+
+
+template <class TPixel>
+void
+StreamedReslicer<TPixel>::
+resliceRowSlices( int k, int startJ, int endJ, const int * slices,
+  int numberOfSlices, unsigned char * const * out ) const
+{
+  const int firstSlice = *std::min_element( slices,
+    slices + numberOfSlices );
+  const int lastSlice = *std::max_element( slices,
+    slices + numberOfSlices );
+  const int slabStart = this->loadSlab( firstSlice, lastSlice, slices[0] );
+  int slabSlices[MaxSlicesPerPass];
+  for( int i=0; i<numberOfSlices; ++i )
+    {
+    slabSlices[i] = slices[i] - slabStart;
+    }
+  mSlabReslicer.resliceRowSlices( k, startJ, endJ, slabSlices,
+    numberOfSlices, out );
+}
+
+
+template class StreamedReslicer<unsigned char>;
+template class StreamedReslicer<short>;
+template class StreamedReslicer<unsigned short>;
+template class StreamedReslicer<float>;
+template class StreamedReslicer<double>;
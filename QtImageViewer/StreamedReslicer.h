@@ -0,0 +1,98 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __StreamedReslicer_h
+#define __StreamedReslicer_h
+
+// ImageViewer includes
+#include "SliceReslicer.h"
+#include "ChunkedVolume.h"
+
+// STD includes
+#include <mutex>
+#include <vector>
+
+/**
+* StreamedReslicer : reslices a ChunkedVolume, which is not held in
+* memory, by copying the slab of slices around the requested ones into a
+* buffer and reslicing the slab with a SliceReslicer.
+*
+* The slab holds the slices the image mode reads around a slice: one on
+* each side for the derivatives, IMG_BLEND and IMG_GRAD, and the slab
+* thickness for the slab modes. IMG_MIP projects the slab thickness only,
+* since projecting the whole depth would read the whole file.
+*
+* The slab is loaded by the reslicing calls themselves, whose slice is
+* set without update(), so the first render thread to need it loads it
+* while the others wait. Clones, e.g., the one of the SlicePrefetcher,
+* load their own slabs from the shared volume.
+**/
+template <class TPixel>
+class StreamedReslicer : public SliceReslicerBase
+{
+public:
+  typedef TPixel PixelType;
+
+  StreamedReslicer( ChunkedVolume< PixelType > * volume );
+  StreamedReslicer( const StreamedReslicer & other );
+
+  virtual SliceReslicerBase * clone() const
+    {
+    return new StreamedReslicer( *this );
+    }
+
+  virtual void update();
+
+  virtual void resliceRow( int k, int startJ, int endJ, unsigned char * out,
+    unsigned short * zBuffer ) const;
+
+  virtual void resliceRows( int startK, int endK, int startJ, int endJ,
+    unsigned char * out, unsigned short * zBuffer, long outStride ) const;
+
+  virtual void resliceRowSlices( int k, int startJ, int endJ,
+    const int * slices, int numberOfSlices,
+    unsigned char * const * out ) const;
+
+protected:
+  /*! Pass the view settings to the slab reslicer. The caller holds
+  *   mSlabMutex. */
+  void applySettings() const;
+
+  /*! Make the slab hold slices firstSlice to lastSlice and the slices the
+  *   mode reads around them, and point the slab reslicer to slice.
+  *   Returns the first slice of the slab. */
+  int loadSlab( int firstSlice, int lastSlice, int slice ) const;
+
+  ChunkedVolume< PixelType > *        mVolume;
+
+  /* the slab and its reslicer change as the slices are resliced */
+  mutable std::mutex                  mSlabMutex;
+  mutable std::vector< PixelType >    mSlab;
+  mutable SliceReslicer< PixelType >  mSlabReslicer;
+  /* slices of the slab along mSlabAxis, none if mSlabEnd < mSlabStart */
+  mutable int                         mSlabAxis;
+  mutable int                         mSlabStart;
+  mutable int                         mSlabEnd;
+  /* slice the slab reslicer is set to */
+  mutable int                         mSlabSlice;
+};
+
+#endif
@@ -0,0 +1,407 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "VolumeLoader.h"
+
+// ITK includes
+#include "itkImageIORegion.h"
+#include "itk_zlib.h"
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+
+VolumeLoader::
+VolumeLoader( itk::ImageIOBase * imageIO, void * buffer )
+{
+  mImageIO = imageIO;
+  mBuffer = static_cast< char * >( buffer );
+  mSliceBytes = mImageIO->GetDimensions( 0 ) * mImageIO->GetDimensions( 1 )
+    * mImageIO->GetComponentSize() * mImageIO->GetNumberOfComponents();
+  mNumberOfSlices = ( int )mImageIO->GetDimensions( 2 );
+  mLoaded.reset( new std::atomic< unsigned char >[mNumberOfSlices] );
+  for( int slice=0; slice<mNumberOfSlices; ++slice )
+    {
+    mLoaded[slice] = 0;
+    }
+  mNumberOfLoadedSlices = 0;
+  mRunning = false;
+  mCancelled = false;
+  mStream = NULL;
+  mStreamSize = 0;
+  mSkip = 0;
+}
+
+
+VolumeLoader::
+~VolumeLoader()
+{
+  this->cancel();
+  if( mThread.joinable() )
+    {
+    mThread.join();
+    }
+  if( mStream != NULL )
+    {
+    mFile.unmap( mStream );
+    }
+}
+
+
+bool
+VolumeLoader::
+setCompressedData( const QString & fileName, qint64 offset,
+  qint64 streamSize, qint64 skip )
+{
+  mFile.setFileName( fileName );
+  if( offset < 0 || skip < 0 || !mFile.open( QIODevice::ReadOnly ) )
+    {
+    return false;
+    }
+  if( streamSize < 0 )
+    {
+    streamSize = mFile.size() - offset;
+    }
+  if( streamSize <= 0 || offset + streamSize > mFile.size() )
+    {
+    return false;
+    }
+  mStream = mFile.map( offset, streamSize );
+  if( mStream == NULL )
+    {
+    return false;
+    }
+  mStreamSize = ( size_t )streamSize;
+  mSkip = ( size_t )skip;
+
+  // Chunks are inflated in place, so only when they hold just the pixels
+  if( mSkip == 0 && mChunkedGzip.setStream(
+    reinterpret_cast< const char * >( mStream ), mStreamSize,
+    mSliceBytes * mNumberOfSlices ) )
+    {
+    mChunkInflated.assign( mChunkedGzip.numberOfChunks(), 0 );
+    mThreader = itk::MultiThreaderBase::New();
+    }
+  return true;
+}
+
+
+bool
+VolumeLoader::
+start( int firstSlice )
+{
+  if( !mChunkInflated.empty() && firstSlice >= 0
+    && firstSlice < mNumberOfSlices )
+    {
+    const size_t chunkSize = mChunkedGzip.chunkSize();
+    const size_t firstChunk = firstSlice * mSliceBytes / chunkSize;
+    const size_t lastChunk = ( ( firstSlice + 1 ) * mSliceBytes - 1 )
+      / chunkSize;
+    if( !mChunkedGzip.inflateChunks( firstChunk, lastChunk, mBuffer,
+      mThreader ) )
+      {
+      std::cerr << "Corrupt compressed image" << std::endl;
+      return false;
+      }
+    this->markInflatedChunks( firstChunk, lastChunk );
+    }
+  else if( mStream == NULL && mImageIO->CanStreamRead() && firstSlice >= 0
+    && firstSlice < mNumberOfSlices
+    && !this->readSlices( firstSlice, firstSlice ) )
+    {
+    return false;
+    }
+  mRunning = true;
+  mThread = std::thread( &VolumeLoader::run, this );
+  return true;
+}
+
+
+void
+VolumeLoader::
+cancel()
+{
+  mCancelled = true;
+}
+
+
+void
+VolumeLoader::
+loadedSlices( std::vector< unsigned char > & loaded ) const
+{
+  loaded.resize( mNumberOfSlices );
+  for( int slice=0; slice<mNumberOfSlices; ++slice )
+    {
+    loaded[slice] = mLoaded[slice].load( std::memory_order_acquire );
+    }
+}
+
+
+bool
+VolumeLoader::
+readSlices( int firstSlice, int lastSlice )
+{
+  const bool streamed = mImageIO->CanStreamRead();
+  if( !streamed )
+    {
+    firstSlice = 0;
+    lastSlice = mNumberOfSlices - 1;
+    }
+  itk::ImageIORegion region( 3 );
+  for( unsigned int i=0; i<2; ++i )
+    {
+    region.SetIndex( i, 0 );
+    region.SetSize( i, mImageIO->GetDimensions( i ) );
+    }
+  region.SetIndex( 2, firstSlice );
+  region.SetSize( 2, lastSlice - firstSlice + 1 );
+  try
+    {
+    mImageIO->SetUseStreamedReading( streamed );
+    mImageIO->SetIORegion( region );
+    mImageIO->Read( mBuffer + firstSlice * mSliceBytes );
+    }
+  catch( itk::ExceptionObject & e )
+    {
+    std::cerr << "Exception when reading image" << std::endl;
+    std::cerr << e << std::endl;
+    return false;
+    }
+  for( int slice=firstSlice; slice<=lastSlice; ++slice )
+    {
+    this->markLoaded( slice );
+    }
+  return true;
+}
+
+
+bool
+VolumeLoader::
+inflateChunks()
+{
+  // A batch keeps every thread busy, and is the step of the progress
+  const size_t numberOfChunks = mChunkedGzip.numberOfChunks();
+  const size_t chunksPerBatch = std::max(
+    ( size_t )mThreader->GetNumberOfWorkUnits(), ( size_t )1 );
+  size_t chunk = 0;
+  while( chunk < numberOfChunks && !mCancelled )
+    {
+    if( mChunkInflated[chunk] )
+      {
+      ++chunk;
+      continue;
+      }
+    size_t lastChunk = chunk;
+    while( lastChunk + 1 < numberOfChunks
+      && lastChunk + 1 - chunk < chunksPerBatch
+      && !mChunkInflated[lastChunk + 1] )
+      {
+      ++lastChunk;
+      }
+    if( !mChunkedGzip.inflateChunks( chunk, lastChunk, mBuffer,
+      mThreader ) )
+      {
+      std::cerr << "Corrupt compressed image" << std::endl;
+      return false;
+      }
+    this->markInflatedChunks( chunk, lastChunk );
+    chunk = lastChunk + 1;
+    }
+  if( !mCancelled && !mChunkedGzip.checksumMatches() )
+    {
+    std::cerr << "Compressed image checksum mismatch" << std::endl;
+    return false;
+    }
+  return true;
+}
+
+
+void
+VolumeLoader::
+markInflatedChunks( size_t firstChunk, size_t lastChunk )
+{
+  const size_t chunkSize = mChunkedGzip.chunkSize();
+  for( size_t chunk=firstChunk; chunk<=lastChunk; ++chunk )
+    {
+    mChunkInflated[chunk] = 1;
+    }
+  // A slice may span chunks inflated in other batches
+  const int firstSlice = ( int )( firstChunk * chunkSize / mSliceBytes );
+  const int lastSlice = ( int )std::min(
+    ( ( lastChunk + 1 ) * chunkSize - 1 ) / mSliceBytes,
+    ( size_t )mNumberOfSlices - 1 );
+  for( int slice=firstSlice; slice<=lastSlice; ++slice )
+    {
+    const size_t sliceLastChunk = ( ( slice + 1 ) * mSliceBytes - 1 )
+      / chunkSize;
+    bool inflated = !mLoaded[slice];
+    for( size_t chunk=slice * mSliceBytes / chunkSize;
+      inflated && chunk<=sliceLastChunk; ++chunk )
+      {
+      inflated = ( mChunkInflated[chunk] != 0 );
+      }
+    if( inflated )
+      {
+      this->markLoaded( slice );
+      }
+    }
+}
+
+
+bool
+VolumeLoader::
+inflateStream()
+{
+  // The window bits detect a zlib or a gzip header
+  z_stream inflater;
+  memset( &inflater, 0, sizeof( inflater ) );
+  if( inflateInit2( &inflater, MAX_WBITS + 32 ) != Z_OK )
+    {
+    return false;
+    }
+  const size_t blockSize = 1 << 20;
+  const size_t maximumOutput = 1 << 30;
+  const size_t dataSize = mSliceBytes * mNumberOfSlices;
+  std::vector< Bytef > skipped( std::min( mSkip, blockSize ) );
+  size_t numberOfSkipped = 0;
+  size_t numberOfInflated = 0;
+  size_t consumed = 0;
+  int slice = 0;
+  bool inflated = true;
+  while( numberOfInflated < dataSize && !mCancelled )
+    {
+    // The input is given a block at a time, for the progress
+    if( inflater.avail_in == 0 )
+      {
+      if( consumed == mStreamSize )
+        {
+        inflated = false;
+        break;
+        }
+      inflater.next_in = mStream + consumed;
+      inflater.avail_in = ( uInt )std::min( blockSize,
+        mStreamSize - consumed );
+      consumed += inflater.avail_in;
+      }
+    const bool skipping = ( numberOfSkipped < mSkip );
+    if( skipping )
+      {
+      inflater.next_out = skipped.data();
+      inflater.avail_out = ( uInt )std::min( skipped.size(),
+        mSkip - numberOfSkipped );
+      }
+    else
+      {
+      inflater.next_out = reinterpret_cast< Bytef * >( mBuffer )
+        + numberOfInflated;
+      inflater.avail_out = ( uInt )std::min( maximumOutput,
+        dataSize - numberOfInflated );
+      }
+    const uInt availableOutput = inflater.avail_out;
+    int status = ::inflate( &inflater, Z_NO_FLUSH );
+    ( skipping ? numberOfSkipped : numberOfInflated ) +=
+      availableOutput - inflater.avail_out;
+    for( ; slice < mNumberOfSlices
+      && ( slice + 1 ) * mSliceBytes <= numberOfInflated; ++slice )
+      {
+      this->markLoaded( slice );
+      }
+    // Concatenated gzip members continue the pixels
+    if( status == Z_STREAM_END && numberOfInflated < dataSize )
+      {
+      status = inflateReset( &inflater );
+      }
+    if( status != Z_OK && status != Z_BUF_ERROR
+      && status != Z_STREAM_END )
+      {
+      inflated = false;
+      break;
+      }
+    }
+  inflateEnd( &inflater );
+  if( !inflated )
+    {
+    std::cerr << "Corrupt compressed image" << std::endl;
+    }
+  return inflated;
+}
+
+
+void
+VolumeLoader::
+markLoaded( int slice )
+{
+  mLoaded[slice].store( 1, std::memory_order_release );
+  ++mNumberOfLoadedSlices;
+}
+
+
+void
+VolumeLoader::
+run()
+{
+  if( mStream != NULL )
+    {
+    if( !mChunkInflated.empty() )
+      {
+      this->inflateChunks();
+      }
+    else
+      {
+      this->inflateStream();
+      }
+    mRunning = false;
+    return;
+    }
+  if( !mImageIO->CanStreamRead() )
+    {
+    this->readSlices( 0, mNumberOfSlices - 1 );
+    mRunning = false;
+    return;
+    }
+  const int slicesPerRead = std::max( ( mNumberOfSlices + NumberOfReads - 1 )
+    / NumberOfReads, 1 );
+  int slice = 0;
+  while( slice < mNumberOfSlices && !mCancelled )
+    {
+    if( mLoaded[slice] )
+      {
+      ++slice;
+      continue;
+      }
+    // The run of slices not loaded, which ends before the first slice
+    int lastSlice = slice;
+    while( lastSlice + 1 < mNumberOfSlices
+      && lastSlice + 1 - slice < slicesPerRead && !mLoaded[lastSlice + 1] )
+      {
+      ++lastSlice;
+      }
+    if( !this->readSlices( slice, lastSlice ) )
+      {
+      break;
+      }
+    slice = lastSlice + 1;
+    }
+  mRunning = false;
+}
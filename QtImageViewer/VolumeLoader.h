@@ -0,0 +1,159 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __VolumeLoader_h
+#define __VolumeLoader_h
+
+// ImageViewer includes
+#include "ChunkedGzip.h"
+
+// Qt includes
+#include <QFile>
+#include <QString>
+
+// ITK includes
+#include "itkImageIOBase.h"
+#include "itkMultiThreaderBase.h"
+
+// STD includes
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+* VolumeLoader : fills the pixel buffer of a 3D image from its file on a
+* background thread, axial slice by axial slice, so the image can be
+* viewed while it loads.
+*
+* start() reads one slice, the one to show first, before it returns; the
+* thread then reads the other slices in file order, in NumberOfReads
+* streamed region reads, so a compressed file that is inflated from its
+* start for every region is inflated NumberOfReads times at most. A file
+* whose ImageIO cannot stream reads is read whole by the thread, and its
+* slices are all loaded at once.
+*
+* The compressed pixels set by setCompressedData() are inflated by the
+* loader instead: a ChunkedGzip stream inflates the chunks of the first
+* slice in start(), then the others in parallel on the thread, and any
+* other zlib or gzip stream is inflated by the thread from its start,
+* each slice being loaded once its pixels are inflated.
+*
+* A slice is marked loaded after its pixels are written, so the pixels of
+* the slices loadedSlices() reports can be read from any thread.
+**/
+class VolumeLoader
+{
+public:
+  enum { NumberOfReads = 32 };
+
+  /*! imageIO must have read the information of a 3D image, whose pixels,
+  *   in the component type of the file, are written to buffer */
+  VolumeLoader( itk::ImageIOBase * imageIO, void * buffer );
+
+  /*! Cancels the loading and waits for the thread */
+  ~VolumeLoader();
+
+  /*! Inflate the pixels from the zlib or gzip stream of streamSize bytes,
+  *   or up to the end of the file if it is negative, at offset in
+  *   fileName, whose skip first inflated bytes are not pixels, rather
+  *   than read them with the ImageIO. Call it before start(). False if
+  *   the stream cannot be mapped. */
+  bool setCompressedData( const QString & fileName, qint64 offset,
+    qint64 streamSize, qint64 skip );
+
+  /*! Read slice firstSlice, unless the file cannot be read by region,
+  *   then read the others on the thread. False if firstSlice could not
+  *   be read. */
+  bool start( int firstSlice );
+
+  /*! Stop the thread after the read in progress. The slices not read
+  *   stay unloaded. */
+  void cancel();
+
+  /*! True until the thread has read every slice, or stopped on a read
+  *   error or cancel() */
+  bool isRunning() const
+    {
+    return mRunning;
+    }
+
+  /*! True once every slice is loaded */
+  bool isComplete() const
+    {
+    return mNumberOfLoadedSlices == mNumberOfSlices;
+    }
+
+  int numberOfSlices() const
+    {
+    return mNumberOfSlices;
+    }
+
+  int numberOfLoadedSlices() const
+    {
+    return mNumberOfLoadedSlices;
+    }
+
+  /*! Set loaded[slice] to 1 if slice is loaded, 0 otherwise */
+  void loadedSlices( std::vector< unsigned char > & loaded ) const;
+
+protected:
+  /*! Read slices firstSlice to lastSlice, or the whole image if the file
+  *   cannot be read by region, and mark them loaded */
+  bool readSlices( int firstSlice, int lastSlice );
+
+  /*! Inflate the chunks not inflated yet, a batch at a time, and mark
+  *   the slices they complete loaded */
+  bool inflateChunks();
+
+  /*! Mark the slices completed by chunks firstChunk to lastChunk loaded */
+  void markInflatedChunks( size_t firstChunk, size_t lastChunk );
+
+  /*! Inflate the stream from its start, marking the slices loaded */
+  bool inflateStream();
+
+  void markLoaded( int slice );
+
+  /*! Read the slices not loaded yet, in file order */
+  void run();
+
+  itk::ImageIOBase::Pointer                     mImageIO;
+  char *                                        mBuffer;
+  size_t                                        mSliceBytes;
+  int                                           mNumberOfSlices;
+  std::unique_ptr< std::atomic< unsigned char >[] > mLoaded;
+  std::atomic< int >                            mNumberOfLoadedSlices;
+  std::atomic< bool >                           mRunning;
+  std::atomic< bool >                           mCancelled;
+  std::thread                                   mThread;
+
+  /* the compressed pixels, mapped from mFile, if they are inflated */
+  QFile                                         mFile;
+  uchar *                                       mStream;
+  size_t                                        mStreamSize;
+  size_t                                        mSkip;
+  /* set to the stream if it is chunked and holds only the pixels */
+  ChunkedGzip                                   mChunkedGzip;
+  std::vector< unsigned char >                  mChunkInflated;
+  itk::MultiThreaderBase::Pointer               mThreader;
+};
+
+#endif
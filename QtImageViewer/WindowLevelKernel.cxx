@@ -0,0 +1,376 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+// ImageViewer includes
+#include "WindowLevelKernel.h"
+
+#if defined( __x86_64__ ) || defined( _M_X64 ) \
+  || ( defined( __i386__ ) && defined( __SSE2__ ) )
+#define WINDOWLEVEL_X86
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#define WINDOWLEVEL_TARGET_AVX2
+#else
+#define WINDOWLEVEL_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#endif
+#endif
+
+namespace
+{
+
+/* How a kernel turns its inputs into the window value before the IW
+   modes are applied */
+enum TransformType { TF_VALUE, TF_INVERT, TF_DIFFERENCE };
+
+template <int TTransform>
+void
+windowLevelScalar( const WindowLevelKernel & kernel, const double * in,
+  const double * previous, int count, unsigned char * out )
+{
+  const double iwMin = kernel.iwMin();
+  const double iwMax = kernel.iwMax();
+  const double range = iwMax - iwMin;
+  const IWModeType iwModeMin = kernel.iwModeMin();
+  const IWModeType iwModeMax = kernel.iwModeMax();
+  for( int j=0; j<count; ++j )
+    {
+    double tf;
+    if( TTransform == TF_DIFFERENCE )
+      {
+      tf = ( in[j] - iwMin ) / range * 255;
+      tf -= ( previous[j] - iwMin ) / range * 255;
+      tf += 128;
+      }
+    else
+      {
+      tf = ( TTransform == TF_INVERT ? ( iwMax - in[j] ) : ( in[j] - iwMin ) )
+        / range * 255;
+      }
+    out[j] = WindowLevelKernel::windowLevel( tf, iwModeMin, iwModeMax );
+    }
+}
+
+
+void
+windowLevelScalarRow( const WindowLevelKernel & kernel, const double * in,
+  const double * previous, int count, unsigned char * out )
+{
+  if( previous != NULL )
+    {
+    windowLevelScalar<TF_DIFFERENCE>( kernel, in, previous, count, out );
+    }
+  else if( kernel.invert() )
+    {
+    windowLevelScalar<TF_INVERT>( kernel, in, previous, count, out );
+    }
+  else
+    {
+    windowLevelScalar<TF_VALUE>( kernel, in, previous, count, out );
+    }
+}
+
+
+#if defined( WINDOWLEVEL_X86 )
+
+template <int TTransform>
+void
+windowLevelSSE2( const WindowLevelKernel & kernel, const double * in,
+  const double * previous, int count, unsigned char * out )
+{
+  const __m128d iwMin = _mm_set1_pd( kernel.iwMin() );
+  const __m128d iwMax = _mm_set1_pd( kernel.iwMax() );
+  const __m128d range = _mm_set1_pd( kernel.iwMax() - kernel.iwMin() );
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d v128 = _mm_set1_pd( 128 );
+  const __m128d v255 = _mm_set1_pd( 255 );
+  const __m128d v512 = _mm_set1_pd( 512 );
+  const __m128d sign = _mm_set1_pd( -0.0 );
+  const __m128i byteMask = _mm_set1_epi32( 0xFF );
+
+  // Replacement values for tf > 255 and tf < 0. IW_FLIP selects the
+  //   flipped value through an all-ones mask, IW_MIN and IW_MAX select
+  //   a constant.
+  const __m128d hiFlipMask = ( kernel.iwModeMax() == IW_FLIP )
+    ? _mm_cmpeq_pd( zero, zero ) : zero;
+  const __m128d hiConstant = ( kernel.iwModeMax() == IW_MIN ) ? zero : v255;
+  const __m128d loFlipMask = ( kernel.iwModeMin() == IW_FLIP )
+    ? _mm_cmpeq_pd( zero, zero ) : zero;
+  const __m128d loConstant = ( kernel.iwModeMin() == IW_MAX ) ? v255 : zero;
+
+  int j = 0;
+  for( ; j+8<=count; j+=8 )
+    {
+    __m128i values[4];
+    for( int i=0; i<4; ++i )
+      {
+      const __m128d v = _mm_loadu_pd( in + j + 2*i );
+      __m128d tf = ( TTransform == TF_INVERT ) ? _mm_sub_pd( iwMax, v )
+        : _mm_sub_pd( v, iwMin );
+      tf = _mm_mul_pd( _mm_div_pd( tf, range ), v255 );
+      if( TTransform == TF_DIFFERENCE )
+        {
+        const __m128d u = _mm_sub_pd( _mm_loadu_pd( previous + j + 2*i ),
+          iwMin );
+        tf = _mm_sub_pd( tf, _mm_mul_pd( _mm_div_pd( u, range ), v255 ) );
+        tf = _mm_add_pd( tf, v128 );
+        }
+
+      const __m128d hiMask = _mm_cmpgt_pd( tf, v255 );
+      const __m128d hiFlip = _mm_max_pd( _mm_sub_pd( v512, tf ), zero );
+      const __m128d hi = _mm_or_pd( _mm_and_pd( hiFlipMask, hiFlip ),
+        _mm_andnot_pd( hiFlipMask, hiConstant ) );
+
+      const __m128d loMask = _mm_cmplt_pd( tf, zero );
+      const __m128d loFlip = _mm_min_pd( _mm_xor_pd( tf, sign ), v255 );
+      const __m128d lo = _mm_or_pd( _mm_and_pd( loFlipMask, loFlip ),
+        _mm_andnot_pd( loFlipMask, loConstant ) );
+
+      tf = _mm_or_pd( _mm_and_pd( loMask, lo ),
+        _mm_andnot_pd( loMask, tf ) );
+      tf = _mm_or_pd( _mm_and_pd( hiMask, hi ),
+        _mm_andnot_pd( hiMask, tf ) );
+      values[i] = _mm_cvttpd_epi32( tf );
+      }
+
+    // Keep the low byte of each int, as the scalar uchar cast does
+    const __m128i low = _mm_and_si128(
+      _mm_unpacklo_epi64( values[0], values[1] ), byteMask );
+    const __m128i high = _mm_and_si128(
+      _mm_unpacklo_epi64( values[2], values[3] ), byteMask );
+    const __m128i packed = _mm_packs_epi32( low, high );
+    _mm_storel_epi64( reinterpret_cast< __m128i * >( out + j ),
+      _mm_packus_epi16( packed, packed ) );
+    }
+  windowLevelScalar<TTransform>( kernel, in + j,
+    ( TTransform == TF_DIFFERENCE ) ? previous + j : NULL, count - j,
+    out + j );
+}
+
+
+void
+windowLevelSSE2Row( const WindowLevelKernel & kernel, const double * in,
+  const double * previous, int count, unsigned char * out )
+{
+  if( previous != NULL )
+    {
+    windowLevelSSE2<TF_DIFFERENCE>( kernel, in, previous, count, out );
+    }
+  else if( kernel.invert() )
+    {
+    windowLevelSSE2<TF_INVERT>( kernel, in, previous, count, out );
+    }
+  else
+    {
+    windowLevelSSE2<TF_VALUE>( kernel, in, previous, count, out );
+    }
+}
+
+
+template <int TTransform>
+WINDOWLEVEL_TARGET_AVX2
+void
+windowLevelAVX2( const WindowLevelKernel & kernel, const double * in,
+  const double * previous, int count, unsigned char * out )
+{
+  const __m256d iwMin = _mm256_set1_pd( kernel.iwMin() );
+  const __m256d iwMax = _mm256_set1_pd( kernel.iwMax() );
+  const __m256d range = _mm256_set1_pd( kernel.iwMax() - kernel.iwMin() );
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d v128 = _mm256_set1_pd( 128 );
+  const __m256d v255 = _mm256_set1_pd( 255 );
+  const __m256d v512 = _mm256_set1_pd( 512 );
+  const __m256d sign = _mm256_set1_pd( -0.0 );
+  const __m128i byteMask = _mm_set1_epi32( 0xFF );
+
+  const __m256d hiFlipMask = ( kernel.iwModeMax() == IW_FLIP )
+    ? _mm256_cmp_pd( zero, zero, _CMP_EQ_OQ ) : zero;
+  const __m256d hiConstant = ( kernel.iwModeMax() == IW_MIN ) ? zero : v255;
+  const __m256d loFlipMask = ( kernel.iwModeMin() == IW_FLIP )
+    ? _mm256_cmp_pd( zero, zero, _CMP_EQ_OQ ) : zero;
+  const __m256d loConstant = ( kernel.iwModeMin() == IW_MAX ) ? v255 : zero;
+
+  int j = 0;
+  for( ; j+16<=count; j+=16 )
+    {
+    __m128i values[4];
+    for( int i=0; i<4; ++i )
+      {
+      const __m256d v = _mm256_loadu_pd( in + j + 4*i );
+      __m256d tf = ( TTransform == TF_INVERT ) ? _mm256_sub_pd( iwMax, v )
+        : _mm256_sub_pd( v, iwMin );
+      tf = _mm256_mul_pd( _mm256_div_pd( tf, range ), v255 );
+      if( TTransform == TF_DIFFERENCE )
+        {
+        const __m256d u = _mm256_sub_pd(
+          _mm256_loadu_pd( previous + j + 4*i ), iwMin );
+        tf = _mm256_sub_pd( tf,
+          _mm256_mul_pd( _mm256_div_pd( u, range ), v255 ) );
+        tf = _mm256_add_pd( tf, v128 );
+        }
+
+      const __m256d hiMask = _mm256_cmp_pd( tf, v255, _CMP_GT_OQ );
+      const __m256d hi = _mm256_blendv_pd( hiConstant,
+        _mm256_max_pd( _mm256_sub_pd( v512, tf ), zero ), hiFlipMask );
+
+      const __m256d loMask = _mm256_cmp_pd( tf, zero, _CMP_LT_OQ );
+      const __m256d lo = _mm256_blendv_pd( loConstant,
+        _mm256_min_pd( _mm256_xor_pd( tf, sign ), v255 ), loFlipMask );
+
+      tf = _mm256_blendv_pd( tf, lo, loMask );
+      tf = _mm256_blendv_pd( tf, hi, hiMask );
+      values[i] = _mm_and_si128( _mm256_cvttpd_epi32( tf ), byteMask );
+      }
+
+    const __m128i low = _mm_packs_epi32( values[0], values[1] );
+    const __m128i high = _mm_packs_epi32( values[2], values[3] );
+    _mm_storeu_si128( reinterpret_cast< __m128i * >( out + j ),
+      _mm_packus_epi16( low, high ) );
+    }
+  windowLevelScalar<TTransform>( kernel, in + j,
+    ( TTransform == TF_DIFFERENCE ) ? previous + j : NULL, count - j,
+    out + j );
+}
+
+
+WINDOWLEVEL_TARGET_AVX2
+void
+windowLevelAVX2Row( const WindowLevelKernel & kernel, const double * in,
+  const double * previous, int count, unsigned char * out )
+{
+  if( previous != NULL )
+    {
+    windowLevelAVX2<TF_DIFFERENCE>( kernel, in, previous, count, out );
+    }
+  else if( kernel.invert() )
+    {
+    windowLevelAVX2<TF_INVERT>( kernel, in, previous, count, out );
+    }
+  else
+    {
+    windowLevelAVX2<TF_VALUE>( kernel, in, previous, count, out );
+    }
+}
+
+#endif
+
+} // end namespace
+
+
+WindowLevelKernel::
+WindowLevelKernel()
+{
+  mIWMin = 0;
+  mIWMax = 1;
+  mIWModeMin = IW_MIN;
+  mIWModeMax = IW_MAX;
+  mInvert = false;
+  this->setISA( hostISA() );
+}
+
+
+WindowLevelISAType
+WindowLevelKernel::
+hostISA()
+{
+#if defined( WINDOWLEVEL_X86 )
+  static const WindowLevelISAType isa = []()
+    {
+    bool avx2 = false;
+#if defined( _MSC_VER )
+    int info[4];
+    __cpuid( info, 0 );
+    if( info[0] >= 7 )
+      {
+      __cpuid( info, 1 );
+      const bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+      const bool avx = ( info[2] & ( 1 << 28 ) ) != 0;
+      __cpuidex( info, 7, 0 );
+      avx2 = osxsave && avx && ( info[1] & ( 1 << 5 ) ) != 0
+        && ( _xgetbv( 0 ) & 6 ) == 6;
+      }
+#else
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+    return avx2 ? WL_AVX2 : WL_SSE2;
+    }();
+  return isa;
+#else
+  return WL_SCALAR;
+#endif
+}
+
+
+const char *
+WindowLevelKernel::
+isaName( WindowLevelISAType isa )
+{
+  switch( isa )
+    {
+    default:
+    case WL_SCALAR:
+      return "Scalar";
+    case WL_SSE2:
+      return "SSE2";
+    case WL_AVX2:
+      return "AVX2";
+    }
+}
+
+
+void
+WindowLevelKernel::
+setISA( WindowLevelISAType isa )
+{
+  if( isa > hostISA() )
+    {
+    isa = hostISA();
+    }
+  mISA = isa;
+  switch( mISA )
+    {
+    default:
+    case WL_SCALAR:
+      mFunction = &windowLevelScalarRow;
+      break;
+#if defined( WINDOWLEVEL_X86 )
+    case WL_SSE2:
+      mFunction = &windowLevelSSE2Row;
+      break;
+    case WL_AVX2:
+      mFunction = &windowLevelAVX2Row;
+      break;
+#endif
+    }
+}
+
+
+void
+WindowLevelKernel::
+setIntensityWindow( double iwMin, double iwMax, IWModeType iwModeMin,
+  IWModeType iwModeMax )
+{
+  mIWMin = iwMin;
+  mIWMax = iwMax;
+  mIWModeMin = iwModeMin;
+  mIWModeMax = iwModeMax;
+}
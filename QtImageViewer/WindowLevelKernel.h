@@ -0,0 +1,178 @@
+/*=========================================================================
+
+Library:   TubeTK
+
+Copyright Kitware Inc.
+
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+=========================================================================*/
+#ifndef __WindowLevelKernel_h
+#define __WindowLevelKernel_h
+
+// ImageViewer includes
+#include "QtGlSliceView.h"
+
+/*! Instruction sets of the window/level kernel */
+typedef enum {WL_SCALAR, WL_SSE2, WL_AVX2} WindowLevelISAType;
+
+/**
+* WindowLevelKernel : maps a row of doubles to uchar window values.
+*
+* Computes ( v-iwMin )/( iwMax-iwMin )*255, or ( iwMax-v )/( iwMax-iwMin )
+* *255 when inverted, and applies the IW_MIN, IW_MAX or IW_FLIP policy to
+* values outside [0, 255] as windowLevel() does for a single value.
+* applyDifference() maps the difference of two such values, offset by
+* 128, as the derivative image modes do.
+* The SSE2 and AVX2 variants use the same operations in the same order,
+* so all variants produce identical output.
+*
+* The fastest instruction set supported by the host is selected at
+* runtime; non-x86 builds only have the scalar variant.
+**/
+class WindowLevelKernel
+{
+public:
+  WindowLevelKernel();
+
+  /*! Fastest instruction set supported by this host */
+  static WindowLevelISAType hostISA();
+
+  static const char * isaName( WindowLevelISAType isa );
+
+  /*! Select an instruction set. Falls back to hostISA() if the host does
+  *   not support it. */
+  void setISA( WindowLevelISAType isa );
+
+  WindowLevelISAType isa() const
+    {
+    return mISA;
+    }
+
+  void setIntensityWindow( double iwMin, double iwMax,
+    IWModeType iwModeMin, IWModeType iwModeMax );
+
+  /*! Use ( iwMax-v ) instead of ( v-iwMin ), as in IMG_INV */
+  void setInvert( bool invert )
+    {
+    mInvert = invert;
+    }
+
+  /*! Map an intensity to the window value, applying the IW modes */
+  static unsigned char windowLevel( double tf, IWModeType iwModeMin,
+    IWModeType iwModeMax )
+    {
+    if( tf > 255 )
+      {
+      switch( iwModeMax )
+        {
+        case IW_MIN:
+          tf = 0;
+          break;
+        default:
+        case IW_MAX:
+          tf = 255;
+          break;
+        case IW_FLIP:
+          tf = 512-tf;
+          if( tf<0 )
+            {
+            tf = 0;
+            }
+          break;
+        }
+      }
+    else
+      {
+      if( tf < 0 )
+        {
+        switch( iwModeMin )
+          {
+          default:
+          case IW_MIN:
+            tf = 0;
+            break;
+          case IW_MAX:
+            tf = 255;
+            break;
+          case IW_FLIP:
+            tf = -tf;
+            if( tf>255 )
+              {
+              tf = 255;
+              }
+            break;
+          }
+        }
+      }
+    return ( unsigned char )tf;
+    }
+
+  /*! Map count values of in to out */
+  void apply( const double * in, int count, unsigned char * out ) const
+    {
+    mFunction( *this, in, NULL, count, out );
+    }
+
+  /*! Map the window value of in minus that of previous, plus 128, for
+  *   count values. Ignores the inversion. */
+  void applyDifference( const double * in, const double * previous,
+    int count, unsigned char * out ) const
+    {
+    mFunction( *this, in, previous, count, out );
+    }
+
+  double iwMin() const
+    {
+    return mIWMin;
+    }
+
+  double iwMax() const
+    {
+    return mIWMax;
+    }
+
+  IWModeType iwModeMin() const
+    {
+    return mIWModeMin;
+    }
+
+  IWModeType iwModeMax() const
+    {
+    return mIWModeMax;
+    }
+
+  bool invert() const
+    {
+    return mInvert;
+    }
+
+protected:
+  /* previous is NULL for apply() */
+  typedef void ( *FunctionType )( const WindowLevelKernel & kernel,
+    const double * in, const double * previous, int count,
+    unsigned char * out );
+
+  WindowLevelISAType mISA;
+  FunctionType       mFunction;
+
+  double             mIWMin;
+  double             mIWMax;
+  IWModeType         mIWModeMin;
+  IWModeType         mIWModeMax;
+  bool               mInvert;
+};
+
+#endif